@@ -8,6 +8,13 @@
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include "parallel.hpp"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -39,16 +46,24 @@ class Spatial {
 public:
     std::vector<SpatialObject> objects;
     double x_min, x_max, y_min, y_max;
+    double cos_lat = 1.0; // 加载时的经度缩放系数 cos(平均纬度)，append 沿用
+    std::unordered_map<int, size_t> keyword_counts; // 关键字 -> 对象数 (load/append/remove/getSubset 维护，直接修改 objects 后由 touch 重新统计；为空表示未统计)
+    double resolution = 0.0; // > 0: 坐标已对齐到该边长 (km) 的定点整数网格 (见 snap)，扫描线按整数网格精确计算
 
     Spatial() : x_min(0), x_max(0), y_min(0), y_max(0) {}
 
     /**
      * @brief 从 CSV 文件加载数据集
+     * 解析为串行；解析时顺带累加纬度与关键字计数，之后经度缩放、网格对齐与边界
+     * 在一次并行遍历中完成 (每个线程一段)，再按 x 做并行基数排序 (稳定，x 相同的
+     * 对象保持文件顺序)。
      * @param filePath CSV 文件的绝对路径
      * @param hasHeader 是否包含表头，默认为 true
+     * @param gridResolution > 0 时投影后将坐标对齐到该边长 (km) 的定点网格，如 1e-5 (1 cm)
+     * @param threads 预处理线程数，0 表示每个硬件线程一个
      * @return 是否加载成功
      */
-    bool load(const std::string& filePath, bool hasHeader = true) {
+    bool load(const std::string& filePath, bool hasHeader = true, double gridResolution = 0.0, int threads = 0) {
         std::ifstream file(filePath);
         if (!file.is_open()) {
             std::cerr << "Error: Could not open file " << filePath << std::endl;
@@ -56,56 +71,305 @@ public:
         }
 
         objects.clear();
+        keyword_counts.clear();
+        fingerprint_valid_ = false;
         std::string line;
 
         if (hasHeader && std::getline(file, line)) {}
 
+        const double R = 6371.0; 
+        double sumLat = 0;
         while (std::getline(file, line)) {
-            if (line.empty()) continue;
-            std::stringstream ss(line);
-            std::string vId, vCatId, latStr, lonStr;
-
-            if (std::getline(ss, vId, ',') &&
-                std::getline(ss, vCatId, ',') &&
-                std::getline(ss, latStr, ',') &&
-                std::getline(ss, lonStr, ',')) {
-                try {
-                    int id = std::stoi(vId);
-                    double lat = std::stod(latStr);
-                    double lon = std::stod(lonStr);
-                    int kw = std::stoi(vCatId); 
-                    objects.emplace_back(id, kw, lat, lon);
-                } catch (...) {}
+            int id, kw;
+            double lat, lon;
+            if (parseLine(line, id, kw, lat, lon)) {
+                objects.emplace_back(id, kw, lat, lon);
+                sumLat += objects.back().y / R;
+                keyword_counts[kw]++;
             }
         }
         file.close();
 
         if (!objects.empty()) {
-            const double R = 6371.0; 
-            double sumLat = 0;
-            for (const auto& o : objects) sumLat += o.y / R; 
             double avgLat = sumLat / objects.size();
             double cosLat = std::cos(avgLat);
-            
-            for (auto& o : objects) o.x *= cosLat;
+            cos_lat = cosLat;
+            resolution = gridResolution > 0.0 ? gridResolution : 0.0;
+
+            // 投影 + 对齐 + 边界，一次遍历
+            size_t n = objects.size();
+            size_t blocks = std::min<size_t>((size_t)fspm_plus::resolve_threads(threads), (n + 65535) / 65536);
+            std::vector<double> bounds(blocks * 4);
+            fspm_plus::parallel_for(blocks, (int)blocks, [&](size_t k) {
+                size_t begin = n * k / blocks, end = n * (k + 1) / blocks;
+                double* bd = &bounds[k * 4];
+                // 以 ±inf 起始：首个对象对齐后才知道其坐标
+                bd[0] = bd[2] = std::numeric_limits<double>::infinity();
+                bd[1] = bd[3] = -std::numeric_limits<double>::infinity();
+                for (size_t i = begin; i < end; ++i) {
+                    SpatialObject& o = objects[i];
+                    o.x *= cosLat;
+                    if (resolution > 0.0) snapObject(o, resolution);
+                    bd[0] = std::min(bd[0], o.x);
+                    bd[1] = std::max(bd[1], o.x);
+                    bd[2] = std::min(bd[2], o.y);
+                    bd[3] = std::max(bd[3], o.y);
+                }
+            });
+            x_min = bounds[0];
+            x_max = bounds[1];
+            y_min = bounds[2];
+            y_max = bounds[3];
+            for (size_t k = 1; k < blocks; ++k) {
+                x_min = std::min(x_min, bounds[k * 4]);
+                x_max = std::max(x_max, bounds[k * 4 + 1]);
+                y_min = std::min(y_min, bounds[k * 4 + 2]);
+                y_max = std::max(y_max, bounds[k * 4 + 3]);
+            }
+
+            fspm_plus::radix_sort(objects, [](const SpatialObject& o) { return sortKey(o.x); }, threads);
+        }
+        std::cout << "Successfully loaded " << objects.size() << " objects." << std::endl;
+        return true;
+    }
+
+    /**
+     * @brief double 到 uint64 的保序映射 (IEEE 754：正数置符号位，负数按位取反)，用于基数排序
+     */
+    static uint64_t sortKey(double v) {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return (bits >> 63) ? ~bits : bits | (1ULL << 63);
+    }
 
-            x_min = x_max = objects[0].x;
+    /**
+     * @brief 追加对象 (由 SpatialObject(id, kw, lat, lon) 构造，尚未做经度缩放)
+     * 新对象按加载时的 cos_lat 投影 (不重新计算平均纬度，已有坐标保持不变)，
+     * 排序后线性归并进按 x 排序的 objects，并扩展边界。
+     * 对象下标会移动，GridIndex 等按下标引用数据的索引需要重建。
+     * @return 投影后的新对象 (x 升序)
+     */
+    std::vector<SpatialObject> append(std::vector<SpatialObject> added) {
+        if (added.empty()) return added;
+        fingerprint_valid_ = false;
+        for (auto& o : added) {
+            o.x *= cos_lat;
+            if (resolution > 0.0) snapObject(o, resolution);
+        }
+        auto by_x = [](const SpatialObject& o1, const SpatialObject& o2) { return o1.x < o2.x; };
+        std::sort(added.begin(), added.end(), by_x);
+        if (objects.empty()) {
+            x_min = x_max = added[0].x;
+            y_min = y_max = added[0].y;
+        }
+        for (const auto& o : added) {
+            x_min = std::min(x_min, o.x);
+            x_max = std::max(x_max, o.x);
+            y_min = std::min(y_min, o.y);
+            y_max = std::max(y_max, o.y);
+        }
+        if (!keyword_counts.empty() || objects.empty()) {
+            for (const auto& o : added) keyword_counts[o.keyword]++;
+        }
+        size_t old_size = objects.size();
+        objects.insert(objects.end(), added.begin(), added.end());
+        std::inplace_merge(objects.begin(), objects.begin() + old_size, objects.end(), by_x);
+        return added;
+    }
+
+    /**
+     * @brief 删除 id 在 ids 中的对象 (一次线性扫描，保持 x 有序) 并重新计算边界
+     * 与 append 一样会移动对象下标。
+     * @return 被删除的对象 (x 升序)
+     */
+    std::vector<SpatialObject> remove(std::vector<int> ids) {
+        std::vector<SpatialObject> removed;
+        if (ids.empty() || objects.empty()) return removed;
+        std::sort(ids.begin(), ids.end());
+        fingerprint_valid_ = false;
+        size_t kept = 0;
+        for (size_t i = 0; i < objects.size(); ++i) {
+            if (std::binary_search(ids.begin(), ids.end(), objects[i].id)) removed.push_back(objects[i]);
+            else objects[kept++] = objects[i];
+        }
+        objects.resize(kept);
+        if (!keyword_counts.empty()) {
+            for (const auto& o : removed) {
+                auto it = keyword_counts.find(o.keyword);
+                if (it != keyword_counts.end() && --it->second == 0) keyword_counts.erase(it);
+            }
+        }
+        if (!objects.empty()) {
+            x_min = objects.front().x;
+            x_max = objects.back().x;
             y_min = y_max = objects[0].y;
             for (const auto& o : objects) {
-                x_min = std::min(x_min, o.x);
-                x_max = std::max(x_max, o.x);
                 y_min = std::min(y_min, o.y);
                 y_max = std::max(y_max, o.y);
             }
+        }
+        return removed;
+    }
 
-            std::sort(objects.begin(), objects.end(), [](const SpatialObject& o1, const SpatialObject& o2) {
-                return o1.x < o2.x;
-            });
+    /**
+     * @brief 将坐标对齐到边长为 res (km) 的定点网格：x = round(x / res) * res，y 同理
+     * 同一整数坐标总是得到同一个 double，扫描线事件 (含 a、b 的网格化) 因而可精确比较。
+     * 对齐后重新计算边界；x 顺序可能在相距不足 res 的对象间变化，因此重新排序。
+     */
+    void snap(double res) {
+        if (res <= 0.0) return;
+        resolution = res;
+        if (objects.empty()) return;
+        fingerprint_valid_ = false;
+        for (auto& o : objects) snapObject(o, res);
+        std::stable_sort(objects.begin(), objects.end(), [](const SpatialObject& o1, const SpatialObject& o2) {
+            return o1.x < o2.x;
+        });
+        x_min = objects.front().x;
+        x_max = objects.back().x;
+        y_min = y_max = objects[0].y;
+        for (const auto& o : objects) {
+            y_min = std::min(y_min, o.y);
+            y_max = std::max(y_max, o.y);
         }
-        std::cout << "Successfully loaded " << objects.size() << " objects." << std::endl;
+    }
+
+    static void snapObject(SpatialObject& o, double res) {
+        o.x = (double)std::llround(o.x / res) * res;
+        o.y = (double)std::llround(o.y / res) * res;
+    }
+
+    /**
+     * @brief 重新统计每个关键字的对象数 (直接修改 objects 后调用)
+     */
+    void countKeywords() {
+        keyword_counts.clear();
+        for (const auto& o : objects) keyword_counts[o.keyword]++;
+    }
+
+    /**
+     * @brief 关键字 kw 的对象数；未统计时 (keyword_counts 为空) 现场扫描
+     */
+    size_t keywordCount(int kw) const {
+        if (keyword_counts.empty() && !objects.empty()) {
+            size_t n = 0;
+            for (const auto& o : objects) n += o.keyword == kw;
+            return n;
+        }
+        auto it = keyword_counts.find(kw);
+        return it == keyword_counts.end() ? 0 : it->second;
+    }
+
+    /**
+     * @brief 解析 CSV 的一行 (id, 类别 ID, 纬度, 经度, ...)
+     * @return 格式正确时返回 true
+     */
+    static bool parseLine(const std::string& line, int& id, int& kw, double& lat, double& lon) {
+        if (line.empty()) return false;
+        std::stringstream ss(line);
+        std::string vId, vCatId, latStr, lonStr;
+
+        if (std::getline(ss, vId, ',') &&
+            std::getline(ss, vCatId, ',') &&
+            std::getline(ss, latStr, ',') &&
+            std::getline(ss, lonStr, ',')) {
+            try {
+                id = std::stoi(vId);
+                lat = std::stod(latStr);
+                lon = std::stod(lonStr);
+                kw = std::stoi(vCatId);
+                return true;
+            } catch (...) {}
+        }
+        return false;
+    }
+
+    /**
+     * @brief 解析带时间的 CSV 行 (id, 类别 ID, 纬度, 经度, 时间, ...)
+     * @return 格式正确且时间可解析 (见 parseTime) 时返回 true
+     */
+    static bool parseLine(const std::string& line, int& id, int& kw, double& lat, double& lon, double& time) {
+        if (!parseLine(line, id, kw, lat, lon)) return false;
+        size_t pos = 0;
+        for (int k = 0; k < 4; ++k) {
+            pos = line.find(',', pos);
+            if (pos == std::string::npos) return false;
+            pos++;
+        }
+        return parseTime(line.substr(pos, line.find(',', pos) - pos), time);
+    }
+
+    /**
+     * @brief 解析时间戳，返回 Unix 秒 (UTC)
+     * 支持纯数字 (Unix 秒)、ISO 8601 "2010-10-19T23:55:27Z" (Gowalla)
+     * 和 "Tue Apr 03 18:00:09 +0000 2012" (Foursquare NYC/TKY)
+     */
+    static bool parseTime(const std::string& text, double& time) {
+        std::string s = text;
+        while (!s.empty() && (s.back() == '\r' || s.back() == ' ' || s.back() == '"')) s.pop_back();
+        while (!s.empty() && (s.front() == ' ' || s.front() == '"')) s.erase(s.begin());
+        if (s.empty()) return false;
+
+        char* end = nullptr;
+        double v = std::strtod(s.c_str(), &end);
+        if (end && *end == '\0') {
+            time = v;
+            return true;
+        }
+
+        // 公历日期到 1970-01-01 起的天数 (Howard Hinnant 的 days_from_civil)
+        auto days_from_civil = [](long long y, unsigned m, unsigned d) {
+            y -= m <= 2;
+            long long era = (y >= 0 ? y : y - 399) / 400;
+            unsigned yoe = (unsigned)(y - era * 400);
+            unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+            unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+            return era * 146097 + (long long)doe - 719468;
+        };
+        int Y, M, D, h, m, sec;
+        char mon[4] = { 0 };
+        int offset = 0;
+        if (std::sscanf(s.c_str(), "%d-%d-%dT%d:%d:%d", &Y, &M, &D, &h, &m, &sec) == 6 ||
+            std::sscanf(s.c_str(), "%d-%d-%d %d:%d:%d", &Y, &M, &D, &h, &m, &sec) == 6) {
+            // 只接受 UTC (Z 或无时区)
+        } else if (std::sscanf(s.c_str(), "%*3s %3s %d %d:%d:%d %d %d", mon, &D, &h, &m, &sec, &offset, &Y) == 7) {
+            static const char* months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+            const char* p = std::strstr(months, mon);
+            if (!p || (p - months) % 3 != 0) return false;
+            M = (int)(p - months) / 3 + 1;
+        } else {
+            return false;
+        }
+        if (M < 1 || M > 12 || D < 1 || D > 31) return false;
+        // +hhmm 时区偏移换算为 UTC
+        int off_sec = (offset / 100) * 3600 + (offset % 100) * 60;
+        time = (double)days_from_civil(Y, (unsigned)M, (unsigned)D) * 86400.0 + h * 3600.0 + m * 60.0 + sec - off_sec;
         return true;
     }
 
+    /**
+     * @brief 数据集内容指纹 (FNV-1a 哈希 id、关键字与坐标的二进制表示)
+     * 相同内容、相同顺序的数据集指纹相同，用作候选集/结果缓存的键。
+     * 首次调用时计算并缓存，load/append/remove/snap 使其失效；直接修改 objects 后
+     * 须调用 touch() (同时重新统计 keyword_counts)。与 SupportSet 一样，同一对象不可被多个线程同时首次读取。
+     */
+    uint64_t fingerprint() const {
+        if (!fingerprint_valid_) {
+            fingerprint_ = computeFingerprint();
+            fingerprint_valid_ = true;
+        }
+        return fingerprint_;
+    }
+
+    /**
+     * @brief 直接修改 objects 后调用：丢弃缓存的指纹；keyword_counts 已统计时重新统计，
+     * 否则 keywordCount (锚点候选引擎据此选最稀有关键字) 会读到过期计数
+     */
+    void touch() {
+        fingerprint_valid_ = false;
+        if (!keyword_counts.empty()) countKeywords();
+    }
+
     /**
      * @brief 获取子集 (用于测试或特定区域挖掘)
      */
@@ -114,6 +378,9 @@ public:
         if (objects.empty()) return sub;
         size_t n = std::min(limit, objects.size());
         sub.objects.assign(objects.begin(), objects.begin() + n);
+        sub.cos_lat = cos_lat;
+        sub.resolution = resolution;
+        sub.countKeywords();
         
         sub.x_min = sub.x_max = sub.objects[0].x;
         sub.y_min = sub.y_max = sub.objects[0].y;
@@ -125,8 +392,69 @@ public:
         }
         return sub;
     }
+
+private:
+    uint64_t computeFingerprint() const {
+        uint64_t h = 1469598103934665603ULL;
+        auto mix = [&h](const void* data, size_t len) {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < len; ++i) {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+        };
+        uint64_t n = objects.size();
+        mix(&n, sizeof(n));
+        for (const auto& o : objects) {
+            mix(&o.id, sizeof(o.id));
+            mix(&o.keyword, sizeof(o.keyword));
+            mix(&o.x, sizeof(o.x));
+            mix(&o.y, sizeof(o.y));
+        }
+        return h;
+    }
+
+    mutable uint64_t fingerprint_ = 0;
+    mutable bool fingerprint_valid_ = false;
+};
+
+/**
+ * @brief 一次签到：地点 (id, 类别, 经纬度) 与时间 (Unix 秒)
+ * 同一地点可出现多次，流式挖掘时地点在窗口内有签到即视为存在
+ */
+struct CheckIn {
+    int id;
+    int keyword;
+    double lat, lon;
+    double time;
 };
 
+/**
+ * @brief 从 CSV 加载签到序列 (id, 类别 ID, 纬度, 经度, 时间)，按时间稳定排序
+ * @return 是否加载成功
+ */
+inline bool loadCheckIns(const std::string& filePath, std::vector<CheckIn>& out, bool hasHeader = true) {
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << filePath << std::endl;
+        return false;
+    }
+    out.clear();
+    std::string line;
+    if (hasHeader && std::getline(file, line)) {}
+    size_t skipped = 0;
+    while (std::getline(file, line)) {
+        CheckIn c;
+        if (Spatial::parseLine(line, c.id, c.keyword, c.lat, c.lon, c.time)) out.push_back(c);
+        else if (!line.empty()) skipped++;
+    }
+    std::stable_sort(out.begin(), out.end(), [](const CheckIn& p, const CheckIn& q) { return p.time < q.time; });
+    std::cout << "Successfully loaded " << out.size() << " check-ins";
+    if (skipped) std::cout << " (" << skipped << " lines without a valid time skipped)";
+    std::cout << "." << std::endl;
+    return true;
+}
+
 /**
  * @brief 计算两个空间对象之间的欧几里得距离
  * @return 距离 (单位: km)
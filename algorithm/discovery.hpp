@@ -0,0 +1,300 @@
+#ifndef DISCOVERY_HPP
+#define DISCOVERY_HPP
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+#include "options.hpp"
+#include "parallel.hpp"
+#include "fspm+.hpp"
+
+namespace fspm_plus {
+
+    /**
+     * @brief A keyword multiset that has at least one frequent pattern at the requested size
+     */
+    struct DiscoveredSketch {
+        RectangularSketch S;
+        int bound = 0;        // co-occurrence upper bound used for pruning
+        size_t patterns = 0;  // frequent patterns found by verification
+        int best_support = 0; // highest pattern support
+    };
+
+    // Keyword multiset as sorted (keyword, count) pairs
+    using KeywordBag = std::vector<std::pair<int, int>>;
+
+    inline bool bag_contains(const KeywordBag& outer, const KeywordBag& inner) {
+        size_t j = 0;
+        for (const auto& item : inner) {
+            while (j < outer.size() && outer[j].first < item.first) j++;
+            if (j == outer.size() || outer[j].first != item.first || outer[j].second < item.second) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Prefix trie of one Apriori level: every multiset is a path of (keyword, count)
+     * items in keyword order, ending at a leaf that holds its index in the level.
+     */
+    class LevelTrie {
+    public:
+        explicit LevelTrie(const std::vector<KeywordBag>& level) : nodes_(1) {
+            for (size_t i = 0; i < level.size(); ++i) {
+                size_t node = 0;
+                for (const auto& item : level[i]) {
+                    auto& children = nodes_[node].children;
+                    auto it = std::lower_bound(children.begin(), children.end(), item,
+                                               [](const Child& c, const std::pair<int, int>& v) { return c.first < v; });
+                    if (it == children.end() || it->first != item) {
+                        size_t created = nodes_.size();
+                        it = children.insert(it, { item, created });
+                        nodes_.emplace_back();
+                    }
+                    node = it->second;
+                }
+                nodes_[node].leaf = (long long)i;
+            }
+        }
+
+        // f(index, slot) for every multiset of the level within N that holds keyword kw,
+        // slot being the position of kw in it. Only prefixes present in the level are walked.
+        template <typename Fn>
+        void visit(const KeywordBag& N, int kw, Fn f) const { walk(0, 0, 0, -1, N, kw, f); }
+
+    private:
+        using Child = std::pair<std::pair<int, int>, size_t>;
+        struct Node {
+            std::vector<Child> children; // by (keyword, count)
+            long long leaf = -1;
+        };
+
+        template <typename Fn>
+        void walk(size_t node, size_t from, int depth, int slot, const KeywordBag& N, int kw, Fn& f) const {
+            const Node& n = nodes_[node];
+            if (n.leaf >= 0) {
+                if (slot >= 0) f((size_t)n.leaf, (size_t)slot);
+                return;
+            }
+            size_t j = from;
+            for (const auto& c : n.children) {
+                while (j < N.size() && N[j].first < c.first.first) j++;
+                if (j == N.size()) return;
+                if (N[j].first != c.first.first || N[j].second < c.first.second) continue;
+                walk(c.second, j + 1, depth + 1, c.first.first == kw ? depth : slot, N, kw, f);
+            }
+        }
+
+        std::vector<Node> nodes_;
+    };
+
+    /**
+     * @brief Automatic sketch discovery for one window size a x b.
+     *
+     * 1. One shared sweep over the x-sorted objects whose keyword occurs >= min_freq
+     *    times. Every object o yields a transaction (o.keyword, N_o), where N_o is the
+     *    keyword multiset of the 2a x 2b box centred on o: any a x b window containing o
+     *    lies inside it. Counts are capped at max_items, and identical transactions are
+     *    aggregated.
+     * 2. Apriori over keyword multisets (up to max_items objects), counting all
+     *    candidates of a level in one pass over the transactions: each transaction
+     *    walks a prefix trie of the level (LevelTrie) along its own N_o. For a multiset K,
+     *      bound(K) = min_{kw in K} |{o : o.keyword = kw, K within N_o}|
+     *    is an upper bound on the support of any pattern of K (a slot of keyword kw can
+     *    only hold objects with a window satisfying K around them), and it is
+     *    anti-monotone, so multisets with bound < min_freq are pruned with all their supersets.
+     * 3. Surviving multisets with >= min_items objects are verified exactly: their
+     *    candidates come from one batch sweep (generate_candidates_batch) and are grouped
+     *    with tree_optimized_fspm.
+     *
+     * Only the objects inside opt.query_box (served by opt.index if set) and in the
+     * sample take part, in the counting as in the verification.
+     *
+     * @param vocabulary Keywords to consider (empty: all)
+     * @return Sketches with at least one frequent pattern, by best support descending
+     */
+    inline std::vector<DiscoveredSketch> discover_sketches(const Spatial& D, const Rectangular& size, double epsilon, int min_freq,
+                                                           int max_items = 3, int min_items = 2,
+                                                           const std::vector<int>& vocabulary = {},
+                                                           const MiningOptions& opt = MiningOptions()) {
+        int threads = resolve_threads(opt.num_threads);
+
+        // Objects of the mined area: inside opt.query_box (served by opt.index if set) and
+        // in the sample, x ascending
+        std::vector<const SpatialObject*> area;
+        if (opt.query_box && opt.index && &opt.index->data() == &D) {
+            area = opt.index->query(*opt.query_box);
+        } else {
+            area.reserve(D.objects.size());
+            for (const auto& o : D.objects) {
+                if (opt.in_box(o.x, o.y)) area.push_back(&o);
+            }
+        }
+        if (opt.sample_rate < 1.0) {
+            area.erase(std::remove_if(area.begin(), area.end(), [&](const SpatialObject* o) { return !opt.in_sample(*o); }), area.end());
+        }
+
+        // Level 1 from plain object counts
+        std::unordered_map<int, int> allowed;
+        for (int kw : vocabulary) allowed[kw] = 1;
+        std::unordered_map<int, int> object_count;
+        for (const SpatialObject* o : area) {
+            if (vocabulary.empty() || allowed.count(o->keyword)) object_count[o->keyword]++;
+        }
+        std::unordered_map<int, int> vocab;
+        for (const auto& kv : object_count) {
+            if (kv.second >= min_freq) vocab[kv.first] = 1;
+        }
+
+        // 1. Shared sweep: neighbourhood multiset of every object (x-sorted, so the
+        //    2a-wide x range is a contiguous run)
+        std::vector<const SpatialObject*> objs;
+        for (const SpatialObject* o : area) {
+            if (vocab.count(o->keyword)) objs.push_back(o);
+        }
+        std::vector<KeywordBag> neighbourhood(objs.size());
+        parallel_for(objs.size(), threads, [&](size_t i) {
+            const SpatialObject& o = *objs[i];
+            auto lo = std::lower_bound(objs.begin(), objs.end(), o.x - size.a, [](const SpatialObject* p, double v) { return p->x < v; });
+            std::unordered_map<int, int> counts;
+            for (auto it = lo; it != objs.end() && (*it)->x <= o.x + size.a; ++it) {
+                if (std::abs((*it)->y - o.y) > size.b) continue;
+                int& c = counts[(*it)->keyword];
+                if (c < max_items) c++;
+            }
+            KeywordBag bag(counts.begin(), counts.end());
+            std::sort(bag.begin(), bag.end());
+            neighbourhood[i] = std::move(bag);
+        });
+        std::map<std::pair<int, KeywordBag>, long long> bag_weight; // (keyword, N_o) -> objects
+        for (size_t i = 0; i < objs.size(); ++i) bag_weight[{ objs[i]->keyword, std::move(neighbourhood[i]) }]++;
+        std::vector<std::pair<std::pair<int, KeywordBag>, long long>> transactions(bag_weight.begin(), bag_weight.end());
+        if (opt.verbose) {
+            std::cout << "[Discovery] " << objs.size() << " objects, " << transactions.size()
+                      << " distinct neighbourhood transactions." << std::endl;
+        }
+
+        // 2. Apriori with shared counting per level: blocks of transactions walk the
+        //    level trie in parallel, each adding into its own accumulators
+        auto count_level = [&](const std::vector<KeywordBag>& level) {
+            std::vector<size_t> first(level.size() + 1, 0); // acc offset of each multiset
+            for (size_t i = 0; i < level.size(); ++i) first[i + 1] = first[i] + level[i].size();
+            LevelTrie trie(level);
+            size_t blocks = std::max<size_t>(std::min<size_t>((size_t)threads, transactions.size()), 1);
+            std::vector<std::vector<long long>> acc(blocks);
+            parallel_for(blocks, threads, [&](size_t k) {
+                std::vector<long long>& sum = acc[k];
+                sum.assign(first.back(), 0);
+                for (size_t t = transactions.size() * k / blocks; t < transactions.size() * (k + 1) / blocks; ++t) {
+                    const auto& tr = transactions[t];
+                    trie.visit(tr.first.second, tr.first.first, [&](size_t i, size_t slot) { sum[first[i] + slot] += tr.second; });
+                }
+            });
+            std::vector<int> bounds(level.size());
+            for (size_t i = 0; i < level.size(); ++i) {
+                long long b = std::numeric_limits<long long>::max();
+                for (size_t slot = first[i]; slot < first[i + 1]; ++slot) {
+                    long long total = 0;
+                    for (const auto& sum : acc) total += sum[slot];
+                    b = std::min(b, total);
+                }
+                bounds[i] = (int)std::min<long long>(b, 1 << 30);
+            }
+            return bounds;
+        };
+
+        std::vector<int> items;
+        for (const auto& kv : vocab) items.push_back(kv.first);
+        std::sort(items.begin(), items.end());
+
+        std::map<KeywordBag, int> frequent; // all surviving multisets with their bound
+        std::vector<KeywordBag> level;
+        for (int kw : items) level.push_back({ { kw, 1 } });
+        for (int n = 1; n <= max_items && !level.empty(); ++n) {
+            std::vector<int> bounds = count_level(level);
+
+            std::vector<KeywordBag> survivors;
+            for (size_t i = 0; i < level.size(); ++i) {
+                if (bounds[i] < min_freq) continue;
+                frequent[level[i]] = bounds[i];
+                survivors.push_back(level[i]);
+            }
+            if (opt.verbose) {
+                std::cout << "[Discovery] Level " << n << ": " << survivors.size() << "/" << level.size()
+                          << " multisets pass the co-occurrence bound." << std::endl;
+            }
+
+            // Next level: extend by a keyword >= the largest one, keep only if every
+            // sub-multiset with one object removed survived
+            std::vector<KeywordBag> next;
+            for (const auto& K : survivors) {
+                for (int kw : items) {
+                    if (kw < K.back().first) continue;
+                    KeywordBag ext = K;
+                    if (ext.back().first == kw) ext.back().second++;
+                    else ext.push_back({ kw, 1 });
+                    bool ok = true;
+                    for (size_t i = 0; i < ext.size() && ok; ++i) {
+                        KeywordBag sub = ext;
+                        if (--sub[i].second == 0) sub.erase(sub.begin() + i);
+                        ok = frequent.count(sub) > 0;
+                    }
+                    if (ok) next.push_back(ext);
+                }
+            }
+            level.swap(next);
+        }
+
+        // 3. Exact verification of the surviving multisets with enough objects
+        std::vector<RectangularSketch> sketches;
+        std::vector<int> sketch_bound;
+        for (const auto& kv : frequent) {
+            int objects = 0;
+            for (const auto& item : kv.first) objects += item.second;
+            if (objects < min_items) continue;
+            RectangularSketch S(size.a, size.b);
+            for (const auto& item : kv.first) S.K[item.first] = item.second;
+            sketches.push_back(S);
+            sketch_bound.push_back(kv.second);
+        }
+
+        std::vector<std::vector<Instance>> C = generate_candidates_batch(D, sketches, opt);
+        std::vector<DiscoveredSketch> found(sketches.size());
+        std::vector<char> keep(sketches.size(), 0);
+        MiningOptions inner = opt;
+        inner.verbose = false;
+        inner.output_path.clear();
+        inner.num_threads = 1;
+        parallel_for(sketches.size(), threads, [&](size_t i) {
+            MiningReport report;
+            MiningOptions local = inner;
+            local.report = &report;
+            auto R = tree_optimized_fspm(std::move(C[i]), sketches[i], epsilon, min_freq, local);
+            if (R.empty()) return;
+            found[i].S = sketches[i];
+            found[i].bound = sketch_bound[i];
+            found[i].patterns = R.size();
+            found[i].best_support = report.supports.empty() ? 0 : report.supports.front();
+            keep[i] = 1;
+        });
+
+        std::vector<DiscoveredSketch> result;
+        for (size_t i = 0; i < found.size(); ++i) {
+            if (keep[i]) result.push_back(found[i]);
+        }
+        std::stable_sort(result.begin(), result.end(), [](const DiscoveredSketch& x, const DiscoveredSketch& y) {
+            return x.best_support > y.best_support;
+        });
+        if (opt.verbose) {
+            std::cout << "[Discovery] " << result.size() << "/" << sketches.size() << " verified sketches have frequent patterns." << std::endl;
+        }
+        return result;
+    }
+}
+
+#endif // DISCOVERY_HPP
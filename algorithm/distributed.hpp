@@ -0,0 +1,388 @@
+#ifndef DISTRIBUTED_HPP
+#define DISTRIBUTED_HPP
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <filesystem>
+#include <cstdint>
+#include <cerrno>
+#include <limits>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+#include "options.hpp"
+#include "fspm+.hpp"
+#include "tiled.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FSPM_DISTRIBUTED 1
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+namespace fspm_plus {
+
+    /**
+     * @brief Knobs of the coordinator/worker mode (see distributed_mining)
+     */
+    struct DistributedOptions {
+        int workers = 4;                      // worker processes
+        int tiles = 16;                       // target tile count, handed out dynamically; more tiles balance skew
+        std::string work_dir = "fspm_dist";   // scratch directory shared with the workers (*.spill)
+        bool keep_files = false;
+    };
+
+#ifdef FSPM_DISTRIBUTED
+
+    /*
+     * Coordinator <-> worker protocol, native byte order, one request in flight per worker:
+     *   job:   u8 'T', u32 tile, f64 core[4] (x_min, y_min, x_max, y_max), f64 covered, f64 resolution,
+     *          u64 n, n x SpatialObject
+     *   quit:  u8 'Q' (or end of stream)
+     *   reply: u64 candidates, f64 needed, sent after the tile's results are flushed to the
+     *          spill; needed > covered: nothing was spilled, resend the tile covering needed
+     *          (see mine_tile)
+     * Results travel through TileSpill files in the shared work directory, with the tile
+     * as writer id; only job descriptions and acknowledgements go over the stream.
+     */
+    namespace wire {
+        inline bool write_all(int fd, const void* data, size_t size) {
+            const char* p = static_cast<const char*>(data);
+            while (size > 0) {
+                ssize_t n = ::write(fd, p, size);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                p += n;
+                size -= (size_t)n;
+            }
+            return true;
+        }
+
+        inline bool read_all(int fd, void* data, size_t size) {
+            char* p = static_cast<char*>(data);
+            while (size > 0) {
+                ssize_t n = ::read(fd, p, size);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) return false;
+                p += n;
+                size -= (size_t)n;
+            }
+            return true;
+        }
+
+        inline bool send_job(int fd, uint32_t tile, const RectangularRegion& core, double covered, double resolution,
+                             const std::vector<SpatialObject>& objs) {
+            char tag = 'T';
+            double box[6] = { core.x_min, core.y_min, core.x_max, core.y_max, covered, resolution };
+            uint64_t n = objs.size();
+            return write_all(fd, &tag, 1) && write_all(fd, &tile, sizeof(tile)) && write_all(fd, box, sizeof(box)) && write_all(fd, &n, sizeof(n)) &&
+                   write_all(fd, objs.data(), n * sizeof(SpatialObject));
+        }
+    }
+
+    /**
+     * @brief Worker loop: read tile jobs from in_fd, mine each with mine_tile into the spill
+     * of its tile under work_dir, acknowledge on out_fd. Returns when the coordinator
+     * sends quit or closes the stream. The transport is any pair of byte streams (pipes
+     * here, a socket for a remote worker sharing work_dir).
+     */
+    inline void distributed_worker(int in_fd, int out_fd, const RectangularSketch& S, const std::string& work_dir,
+                                   const MiningOptions& opt) {
+        char tag = 0;
+        while (wire::read_all(in_fd, &tag, 1) && tag == 'T') {
+            uint32_t t = 0;
+            double box[6];
+            uint64_t n = 0;
+            if (!wire::read_all(in_fd, &t, sizeof(t)) || !wire::read_all(in_fd, box, sizeof(box)) || !wire::read_all(in_fd, &n, sizeof(n))) break;
+            Spatial tile;
+            tile.objects.resize(n);
+            tile.resolution = box[5];
+            if (!wire::read_all(in_fd, tile.objects.data(), n * sizeof(SpatialObject))) break;
+            TileSpill spill(work_dir, (int)t);
+            uint64_t candidates = 0;
+            double needed = box[4];
+            if (!tile.objects.empty()) {
+                tile.x_min = tile.objects.front().x;
+                tile.x_max = tile.objects.back().x;
+                tile.y_min = tile.y_max = tile.objects[0].y;
+                for (const auto& o : tile.objects) {
+                    tile.y_min = std::min(tile.y_min, o.y);
+                    tile.y_max = std::max(tile.y_max, o.y);
+                }
+                candidates = mine_tile(tile, RectangularRegion(box[0], box[1], box[2], box[3]), box[4], S, spill, opt, needed);
+            }
+            if (!spill.flush()) break; // no acknowledgement: the coordinator mines the tile again
+            if (!wire::write_all(out_fd, &candidates, sizeof(candidates)) || !wire::write_all(out_fd, &needed, sizeof(needed))) break;
+        }
+    }
+
+    /**
+     * @brief Coordinator/worker FSPM+ on one machine.
+     *
+     * The sketch objects of D (inside opt.query_box, if set) are cut into at least dist.tiles tiles (TileLayout: core +
+     * a x b halo, so the tiles together produce exactly the candidates of
+     * generate_candidates; a tile whose runs of equal counts reach past its halo is sent
+     * again with the objects up to where mine_tile asks). The layout depends on D, S and dist.tiles only, never on the
+     * number of workers, which only schedule the tiles. Worker processes are forked and fed tiles over
+     * pipes, largest first, the next tile going to whichever worker answers first. Tile
+     * candidates are spilled with the tile as TileSpill writer and the coordinator
+     * regroups them globally with TileSpill::merge, so the result does not
+     * depend on the number of workers or on which worker mined which tile.
+     *
+     * A worker that dies is dropped and its in-flight tile is mined again by the
+     * coordinator after discarding whatever the worker spilled for it.
+     * opt.cancel stops handing out tiles and the finished ones are still merged. Workers
+     * are forked, so call this from a process without other running threads.
+     */
+    inline std::vector<RectangularPattern> distributed_mining(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq,
+                                                              const DistributedOptions& dist = DistributedOptions(),
+                                                              const MiningOptions& opt = MiningOptions()) {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        fs::create_directories(dist.work_dir, ec);
+        if (ec) {
+            std::cerr << "Error: Could not create work directory " << dist.work_dir << ": " << ec.message() << std::endl;
+            return {};
+        }
+        for (const auto& e : fs::directory_iterator(dist.work_dir, ec)) {
+            if (e.path().extension() == ".spill") fs::remove(e.path(), ec);
+        }
+
+        // Layout over the sketch objects inside opt.query_box (mine_tile sees no box)
+        std::vector<SpatialObject> objs;
+        for (const auto& o : D.objects) {
+            if (S.K.count(o.keyword) && opt.in_box(o.x, o.y)) objs.push_back(o);
+        }
+        if (objs.empty()) {
+            if (opt.verbose) std::cout << "[Distributed] No object matches the sketch keywords in the query box." << std::endl;
+            return {};
+        }
+        TileLayout L;
+        L.a = S.size.a;
+        L.b = S.size.b;
+        L.x_min = objs.front().x;
+        L.x_max = objs.back().x;
+        L.y_min = L.y_max = objs[0].y;
+        for (const auto& o : objs) {
+            L.y_min = std::min(L.y_min, o.y);
+            L.y_max = std::max(L.y_max, o.y);
+        }
+        int workers = std::max(dist.workers, 1);
+        size_t wanted = (size_t)std::max(dist.tiles, 1);
+        for (int k = 1;; k *= 2) {
+            L.kx = L.ky = k;
+            L.tile_w = std::max(L.x_max - L.x_min, 1e-9) / k;
+            L.tile_h = std::max(L.y_max - L.y_min, 1e-9) / k;
+            if (L.count() >= wanted || L.tile_w < 4 * L.a || L.tile_h < 4 * L.b) break;
+        }
+
+        // Shards: core + padded halo of every tile, x-sorted because objs is. One column and
+        // row of slack around col/row, whose rounding the exact halo test settles
+        const double pad = tie_pad(D, L.a, L.b);
+        std::vector<std::vector<SpatialObject>> shard(L.count());
+        for (const auto& o : objs) {
+            int i0 = std::max(L.col(o.x - L.a - pad) - 1, 0), i1 = std::min(L.col(o.x + L.a + pad) + 1, L.kx - 1);
+            int j0 = std::max(L.row(o.y - L.b - pad) - 1, 0), j1 = std::min(L.row(o.y + L.b + pad) + 1, L.ky - 1);
+            for (int i = i0; i <= i1; ++i) {
+                for (int j = j0; j <= j1; ++j) {
+                    RectangularRegion H = L.halo(L.id(i, j), pad);
+                    if (o.x >= H.x_min && o.x <= H.x_max && o.y >= H.y_min && o.y <= H.y_max) shard[L.id(i, j)].push_back(o);
+                }
+            }
+        }
+        // A tile extended right to needed: its halo rows up to needed, or to the end of the data
+        auto extend = [&](size_t t, double needed, double& covered) {
+            RectangularRegion H = L.halo(t, pad);
+            covered = needed >= objs.back().x ? std::numeric_limits<double>::infinity() : needed;
+            std::vector<SpatialObject> out;
+            auto it = std::lower_bound(objs.begin(), objs.end(), H.x_min, [](const SpatialObject& o, double x) { return o.x < x; });
+            for (; it != objs.end() && it->x <= covered; ++it) {
+                if (it->y >= H.y_min && it->y <= H.y_max) out.push_back(*it);
+            }
+            return out;
+        };
+        std::vector<size_t> queue;
+        for (size_t t = 0; t < shard.size(); ++t) {
+            if (!shard[t].empty()) queue.push_back(t);
+        }
+        std::stable_sort(queue.begin(), queue.end(), [&](size_t x, size_t y) { return shard[x].size() > shard[y].size(); });
+        if (opt.verbose) {
+            std::cout << "[Distributed] " << objs.size() << " sketch objects in " << L.kx << "x" << L.ky << " tiles ("
+                      << queue.size() << " non-empty), " << workers << " workers." << std::endl;
+        }
+
+        MiningOptions inner = opt;
+        inner.verbose = false;
+        inner.num_threads = 1;
+
+        // Launch workers
+        struct Worker {
+            pid_t pid = -1;
+            int to = -1, from = -1;
+            long tile = -1; // in flight
+            double covered = 0; // of the tile in flight
+        };
+        std::vector<Worker> pool;
+        std::cout << std::flush;
+        std::cerr << std::flush;
+        for (int w = 0; w < workers; ++w) {
+            int down[2], up[2];
+            if (pipe(down) != 0) break;
+            if (pipe(up) != 0) {
+                close(down[0]);
+                close(down[1]);
+                break;
+            }
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(down[1]);
+                close(up[0]);
+                for (const auto& other : pool) { // pipes of earlier workers
+                    close(other.to);
+                    close(other.from);
+                }
+                distributed_worker(down[0], up[1], S, dist.work_dir, inner);
+                _exit(0);
+            }
+            close(down[0]);
+            close(up[1]);
+            if (pid < 0) {
+                close(down[1]);
+                close(up[0]);
+                break;
+            }
+            pool.push_back({ pid, down[1], up[0], -1, 0 });
+        }
+        if (pool.empty()) std::cerr << "Warning: could not start worker processes, mining in the coordinator" << std::endl;
+
+        // Dispatch
+        void (*old_pipe)(int) = signal(SIGPIPE, SIG_IGN);
+        size_t next = 0, done = 0, candidates = 0;
+        bool stopped = false;
+        auto mine_here = [&](size_t t) {
+            fs::remove(TileSpill::file_of(dist.work_dir, (int)t), ec);
+            TileSpill local(dist.work_dir, (int)t);
+            Spatial tile;
+            tile.objects = shard[t];
+            tile.resolution = D.resolution;
+            double covered = L.halo(t, pad).x_max, needed = covered;
+            while (true) {
+                tile.x_min = tile.objects.front().x;
+                tile.x_max = tile.objects.back().x;
+                tile.y_min = tile.y_max = tile.objects[0].y;
+                for (const auto& o : tile.objects) {
+                    tile.y_min = std::min(tile.y_min, o.y);
+                    tile.y_max = std::max(tile.y_max, o.y);
+                }
+                candidates += mine_tile(tile, L.core(t), covered, S, local, inner, needed);
+                if (needed <= covered) break;
+                tile.objects = extend(t, needed, covered);
+            }
+            done++;
+        };
+        auto dispatch = [&](Worker& wk) {
+            while (!stopped && next < queue.size()) {
+                if (opt.cancelled()) {
+                    stopped = true;
+                    opt.mark_partial("tiles", done, queue.size());
+                    return;
+                }
+                size_t t = queue[next++];
+                double covered = L.halo(t, pad).x_max;
+                if (wire::send_job(wk.to, (uint32_t)t, L.core(t), covered, D.resolution, shard[t])) {
+                    wk.tile = (long)t;
+                    wk.covered = covered;
+                    return;
+                }
+                mine_here(t); // worker gone
+            }
+        };
+        auto drop = [&](Worker& wk) {
+            if (wk.tile >= 0) mine_here((size_t)wk.tile);
+            wk.tile = -1;
+            close(wk.to);
+            close(wk.from);
+            wk.to = wk.from = -1;
+        };
+        for (auto& wk : pool) dispatch(wk);
+        while (true) {
+            std::vector<pollfd> fds;
+            std::vector<Worker*> owner;
+            for (auto& wk : pool) {
+                if (wk.tile >= 0) {
+                    fds.push_back({ wk.from, POLLIN, 0 });
+                    owner.push_back(&wk);
+                }
+            }
+            if (fds.empty()) break;
+            if (poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                for (auto* wk : owner) drop(*wk);
+                break;
+            }
+            for (size_t f = 0; f < fds.size(); ++f) {
+                if (!fds[f].revents) continue;
+                Worker& wk = *owner[f];
+                uint64_t reply = 0;
+                double needed = 0;
+                if (!wire::read_all(wk.from, &reply, sizeof(reply)) || !wire::read_all(wk.from, &needed, sizeof(needed))) {
+                    std::cerr << "Warning: worker " << wk.pid << " failed, mining tile " << wk.tile << " in the coordinator" << std::endl;
+                    drop(wk);
+                    continue;
+                }
+                if (needed > wk.covered) { // the tile fell short: send it again, wider
+                    size_t t = (size_t)wk.tile;
+                    double covered;
+                    std::vector<SpatialObject> wider = extend(t, needed, covered);
+                    if (!wire::send_job(wk.to, (uint32_t)t, L.core(t), covered, D.resolution, wider)) {
+                        drop(wk);
+                        continue;
+                    }
+                    wk.covered = covered;
+                    continue;
+                }
+                candidates += reply;
+                done++;
+                wk.tile = -1;
+                if (opt.verbose) {
+                    std::cout << "\r[Distributed] Mined tile " << done << "/" << queue.size() << " (" << candidates << " candidates)    " << std::flush;
+                }
+                dispatch(wk);
+            }
+        }
+        // Tiles left when every worker is gone
+        while (!stopped && next < queue.size()) {
+            if (opt.cancelled()) {
+                opt.mark_partial("tiles", done, queue.size());
+                break;
+            }
+            mine_here(queue[next++]);
+        }
+        for (auto& wk : pool) {
+            if (wk.to >= 0) {
+                char quit = 'Q';
+                wire::write_all(wk.to, &quit, 1);
+                close(wk.to);
+                close(wk.from);
+            }
+            waitpid(wk.pid, nullptr, 0);
+        }
+        signal(SIGPIPE, old_pipe);
+        if (opt.verbose) std::cout << std::endl;
+
+        std::vector<RectangularPattern> R = TileSpill::merge(dist.work_dir, (int)L.count(), S, epsilon, min_freq, opt);
+        if (!dist.keep_files) {
+            for (const auto& e : fs::directory_iterator(dist.work_dir, ec)) {
+                if (e.path().extension() == ".spill") fs::remove(e.path(), ec);
+            }
+        }
+        return R;
+    }
+
+#endif // FSPM_DISTRIBUTED
+}
+
+#endif // DISTRIBUTED_HPP
@@ -0,0 +1,479 @@
+#ifndef EXTERNAL_HPP
+#define EXTERNAL_HPP
+
+#include <vector>
+#include <string>
+#include <queue>
+#include <memory>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <cmath>
+#include <cstdint>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+#include "support.hpp"
+#include "options.hpp"
+#include "fspm+.hpp"
+
+namespace fspm_plus {
+
+    /**
+     * @brief Knobs of the external-memory candidate path (see external_fspm)
+     */
+    struct ExternalOptions {
+        std::string work_dir = "fspm_runs";  // scratch directory for run files (*.run)
+        size_t run_bytes = 256ull << 20;     // candidate buffer size; a full buffer becomes one sorted run
+        size_t max_fan_in = 64;              // runs open at once; more runs are merged in passes
+        bool keep_files = false;
+    };
+
+    /**
+     * @brief One candidate in canonical form with its sort key.
+     * Objects are in canonical order with absolute coordinates, so duplicates extracted
+     * from different windows have identical keys; (ax, ay) is the window anchor. Runs in
+     * RunOrder::Extraction keep the objects in extraction order instead.
+     * Key: (type key, q = floor(rdv[1] / 2 epsilon), ids, anchor), so the first of a run
+     * of duplicates is the canonical copy dedup_candidates keeps.
+     */
+    struct CandidateRecord {
+        std::vector<SpatialObject> objs;
+        double ax = 0, ay = 0;
+        long long q = 0;
+
+        void set_key(double cell) {
+            q = objs.size() > 1 ? (long long)std::floor((objs[1].y - objs[0].y) / cell) : 0;
+        }
+
+        bool operator<(const CandidateRecord& o) const {
+            if (objs.size() != o.objs.size()) return objs.size() < o.objs.size();
+            for (size_t i = 0; i < objs.size(); ++i) {
+                if (objs[i].keyword != o.objs[i].keyword) return objs[i].keyword < o.objs[i].keyword;
+            }
+            if (q != o.q) return q < o.q;
+            for (size_t i = 0; i < objs.size(); ++i) {
+                if (objs[i].id != o.objs[i].id) return objs[i].id < o.objs[i].id;
+            }
+            if (ax != o.ax) return ax < o.ax;
+            return ay < o.ay;
+        }
+
+        // The order dedup_candidates leaves generate_candidates in (objects as extracted): size, ids, anchor
+        bool extraction_less(const CandidateRecord& o) const {
+            if (objs.size() != o.objs.size()) return objs.size() < o.objs.size();
+            for (size_t i = 0; i < objs.size(); ++i) {
+                if (objs[i].id != o.objs[i].id) return objs[i].id < o.objs[i].id;
+            }
+            if (ax != o.ax) return ax < o.ax;
+            return ay < o.ay;
+        }
+
+        bool same_type(const CandidateRecord& o) const {
+            if (objs.size() != o.objs.size()) return false;
+            for (size_t i = 0; i < objs.size(); ++i) {
+                if (objs[i].keyword != o.objs[i].keyword) return false;
+            }
+            return true;
+        }
+
+        bool same_ids(const CandidateRecord& o) const {
+            if (objs.size() != o.objs.size()) return false;
+            for (size_t i = 0; i < objs.size(); ++i) {
+                if (objs[i].id != o.objs[i].id) return false;
+            }
+            return true;
+        }
+
+        size_t bytes() const { return sizeof(CandidateRecord) + objs.size() * sizeof(SpatialObject); }
+    };
+
+    // Sort order of CandidateRuns
+    enum class RunOrder {
+        Key,        // CandidateRecord::operator< (type key, q, ids), for external_grouping
+        Extraction  // CandidateRecord::extraction_less on objects as extracted, the candidate order of the tree engine
+    };
+
+    /**
+     * @brief Sorted run files of candidate records.
+     * Candidates are buffered up to run_bytes; a full buffer is sorted (RunOrder) and
+     * deduplicated, and is written as a run only if it stays above half of
+     * run_bytes. finish() merges the runs in passes of at most max_fan_in files until
+     * max_fan_in or fewer are left, so the merge-scan never holds more files open.
+     *
+     * Failures (directory, open, write, truncated read) are reported on std::cerr and
+     * make ok() false; merge_scan() then returns false instead of a partial scan.
+     *
+     * Run record, native byte order: u32 n, f64 ax, f64 ay, n x (i32 id, f64 x, f64 y, i32 keyword)
+     */
+    class CandidateRuns {
+    public:
+        CandidateRuns(const std::string& dir, double epsilon, size_t run_bytes = 256ull << 20, size_t max_fan_in = 64,
+                      RunOrder order = RunOrder::Key)
+            : dir_(dir), cell_(std::max(2.0 * epsilon, 1e-9)), run_bytes_(run_bytes), max_fan_in_(std::max<size_t>(max_fan_in, 2)), order_(order) {
+            std::error_code ec;
+            std::filesystem::create_directories(dir_, ec);
+            if (ec) {
+                std::cerr << "Error: Could not create run directory " << dir_ << ": " << ec.message() << std::endl;
+                failed_ = true;
+                return;
+            }
+            for (const auto& e : std::filesystem::directory_iterator(dir_, ec)) {
+                if (e.path().extension() == ".run") std::filesystem::remove(e.path(), ec);
+            }
+        }
+
+        // Add one candidate (relative coordinates, any object order)
+        void add(const Instance& inst) {
+            CandidateRecord rec;
+            rec.ax = inst.x - inst.size.a / 2.0;
+            rec.ay = inst.y - inst.size.b / 2.0;
+            rec.objs = inst.O_P;
+            for (auto& o : rec.objs) {
+                o.x += rec.ax;
+                o.y += rec.ay;
+            }
+            if (order_ == RunOrder::Key) canonical_sort(rec.objs);
+            add(std::move(rec));
+        }
+
+        // Add one record (absolute coordinates; canonical order for RunOrder::Key)
+        void add(CandidateRecord rec) {
+            rec.set_key(cell_);
+            buffered_ += rec.bytes();
+            buffer_.push_back(std::move(rec));
+            added_++;
+            if (buffered_ >= run_bytes_) {
+                compact();
+                if (buffered_ >= run_bytes_ / 2) spill();
+            }
+        }
+
+        // Write the last partial run and merge down to max_fan_in runs
+        void finish() {
+            compact();
+            spill();
+            for (size_t pass = 0; !failed_ && runs_.size() > max_fan_in_; ++pass) {
+                std::vector<std::string> merged;
+                for (size_t first = 0; first < runs_.size() && !failed_; first += max_fan_in_) {
+                    std::vector<std::string> group(runs_.begin() + first, runs_.begin() + std::min(first + max_fan_in_, runs_.size()));
+                    std::string path = run_path("merge_" + std::to_string(pass) + "_" + std::to_string(merged.size()));
+                    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                    if (!out) {
+                        std::cerr << "Error: Could not write run file " << path << std::endl;
+                        failed_ = true;
+                        break;
+                    }
+                    if (!merge_files(group, [&](const CandidateRecord& rec) { write(out, rec); })) failed_ = true;
+                    out.flush();
+                    if (!out) {
+                        std::cerr << "Error: Could not write run file " << path << std::endl;
+                        failed_ = true;
+                    }
+                    std::error_code ec;
+                    for (const auto& done : group) std::filesystem::remove(done, ec);
+                    merged.push_back(path);
+                }
+                runs_ = std::move(merged);
+            }
+        }
+
+        void remove_files() {
+            std::error_code ec;
+            for (const auto& path : runs_) std::filesystem::remove(path, ec);
+            runs_.clear();
+        }
+
+        bool ok() const { return !failed_; }
+        bool less(const CandidateRecord& x, const CandidateRecord& y) const { return order_ == RunOrder::Key ? x < y : x.extraction_less(y); }
+        size_t runs() const { return runs_.size(); }
+        size_t candidates() const { return added_; }
+        double cell() const { return cell_; }
+
+        /**
+         * @brief k-way merge of all runs in run order, calling fn(const CandidateRecord&);
+         * records with the same ids (duplicates from overlapping windows) are passed once,
+         * as the canonical copy. At most max_fan_in runs are open (call finish() first).
+         * @return false if a run could not be opened or read, or an earlier step failed
+         */
+        template <typename Fn>
+        bool merge_scan(Fn fn, size_t* distinct = nullptr) const {
+            if (failed_) {
+                std::cerr << "Error: Candidate runs in " << dir_ << " are incomplete" << std::endl;
+                return false;
+            }
+            if (runs_.size() > max_fan_in_) {
+                std::cerr << "Error: " << runs_.size() << " runs exceed the fan-in of " << max_fan_in_ << " (finish() not called)" << std::endl;
+                return false;
+            }
+            return merge_files(runs_, fn, distinct);
+        }
+
+    private:
+        std::string run_path(const std::string& stem) const {
+            return (std::filesystem::path(dir_) / (stem + ".run")).string();
+        }
+
+        // Sort the buffer and drop duplicate ids, keeping the canonical copy
+        void compact() {
+            std::sort(buffer_.begin(), buffer_.end(), [this](const CandidateRecord& x, const CandidateRecord& y) { return less(x, y); });
+            buffer_.erase(std::unique(buffer_.begin(), buffer_.end(), [](const CandidateRecord& x, const CandidateRecord& y) { return x.same_ids(y); }),
+                          buffer_.end());
+            buffered_ = 0;
+            for (const auto& rec : buffer_) buffered_ += rec.bytes();
+        }
+
+        // Write the (compacted) buffer as one run; on failure the records are dropped and ok() is false
+        void spill() {
+            if (buffer_.empty()) return;
+            std::string path = run_path("run_" + std::to_string(spilled_++));
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (out) {
+                for (const auto& rec : buffer_) write(out, rec);
+                out.flush();
+            }
+            if (!out) {
+                std::cerr << "Error: Could not write run file " << path << std::endl;
+                failed_ = true;
+            } else {
+                runs_.push_back(path);
+            }
+            buffer_.clear();
+            buffered_ = 0;
+        }
+
+        template <typename Fn>
+        bool merge_files(const std::vector<std::string>& paths, Fn&& fn, size_t* distinct = nullptr) const {
+            struct Cursor {
+                std::unique_ptr<std::ifstream> in;
+                CandidateRecord rec;
+                const std::string* path;
+            };
+            std::vector<Cursor> cursors;
+            bool bad = false;
+            auto advance = [&](Cursor& c) {
+                if (read(*c.in, c.rec, bad)) {
+                    c.rec.set_key(cell_);
+                    return true;
+                }
+                if (bad) std::cerr << "Error: Could not read run file " << *c.path << std::endl;
+                return false;
+            };
+            for (const auto& path : paths) {
+                Cursor c{ std::make_unique<std::ifstream>(path, std::ios::binary), {}, &path };
+                if (!c.in->is_open()) {
+                    std::cerr << "Error: Could not open run file " << path << std::endl;
+                    return false;
+                }
+                if (advance(c)) cursors.push_back(std::move(c));
+                if (bad) return false;
+            }
+            auto later = [&](size_t x, size_t y) { return less(cursors[y].rec, cursors[x].rec); };
+            std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+            for (size_t i = 0; i < cursors.size(); ++i) heap.push(i);
+
+            size_t count = 0;
+            CandidateRecord last;
+            bool has_last = false;
+            while (!heap.empty()) {
+                size_t i = heap.top();
+                heap.pop();
+                if (!has_last || !cursors[i].rec.same_ids(last)) {
+                    fn(cursors[i].rec);
+                    last = cursors[i].rec;
+                    has_last = true;
+                    count++;
+                }
+                if (advance(cursors[i])) heap.push(i);
+                if (bad) return false;
+            }
+            if (distinct) *distinct = count;
+            return true;
+        }
+
+        template <typename T>
+        static void put_raw(std::ostream& out, T v) { out.write(reinterpret_cast<const char*>(&v), sizeof(T)); }
+        template <typename T>
+        static bool get_raw(std::istream& in, T& v) { return (bool)in.read(reinterpret_cast<char*>(&v), sizeof(T)); }
+
+        static void write(std::ostream& out, const CandidateRecord& rec) {
+            put_raw<uint32_t>(out, (uint32_t)rec.objs.size());
+            put_raw<double>(out, rec.ax);
+            put_raw<double>(out, rec.ay);
+            for (const auto& o : rec.objs) {
+                put_raw<int32_t>(out, o.id);
+                put_raw<double>(out, o.x);
+                put_raw<double>(out, o.y);
+                put_raw<int32_t>(out, o.keyword);
+            }
+        }
+
+        // false at the end of the run; a truncated or unreadable record also sets bad
+        static bool read(std::istream& in, CandidateRecord& rec, bool& bad) {
+            if (in.peek() == std::char_traits<char>::eof()) {
+                bad = in.bad();
+                return false;
+            }
+            uint32_t n = 0;
+            if (!get_raw(in, n) || !get_raw(in, rec.ax) || !get_raw(in, rec.ay) || n > (1u << 16)) {
+                bad = true;
+                return false;
+            }
+            rec.objs.resize(n);
+            for (auto& o : rec.objs) {
+                int32_t id, kw;
+                if (!get_raw(in, id) || !get_raw(in, o.x) || !get_raw(in, o.y) || !get_raw(in, kw)) {
+                    bad = true;
+                    return false;
+                }
+                o.id = id;
+                o.keyword = kw;
+            }
+            return true;
+        }
+
+        std::string dir_;
+        double cell_;
+        size_t run_bytes_;
+        size_t max_fan_in_;
+        RunOrder order_;
+        size_t buffered_ = 0;
+        size_t added_ = 0;
+        size_t spilled_ = 0;
+        bool failed_ = false;
+        std::vector<CandidateRecord> buffer_;
+        std::vector<std::string> runs_;
+    };
+
+    /**
+     * @brief Stream the candidates of S into sorted runs without materialising C.
+     * Valid regions are still computed in memory (they are far fewer than candidates).
+     * Overlapping windows extract the same instance many times; the copies are dropped
+     * whenever the run buffer fills, before anything is spilled.
+     * @return runs.ok()
+     */
+    inline bool generate_candidates_external(const Spatial& D, const RectangularSketch& S, CandidateRuns& runs,
+                                             const MiningOptions& opt = MiningOptions()) {
+        std::vector<RectangularRegion> V = merge_regions(spatial_pruning(D, S, opt));
+        for (size_t n = 0; n < V.size() && runs.ok(); ++n) {
+            if (opt.cancelled(n)) {
+                opt.mark_partial("extraction", n, V.size());
+                break;
+            }
+            extract_window(D, S, V[n], opt, [&](Instance&& inst) { runs.add(inst); });
+        }
+        runs.finish();
+        return runs.ok();
+    }
+
+    /**
+     * @brief Merge-scan grouping over sorted runs with the tree engine's criterion.
+     * Records arrive by type key, then by q = floor(rdv[1] / 2 epsilon). An instance can
+     * only be within 2 * epsilon of representatives in cells q - 1 and q, so two
+     * generations of clusters (a TreeGrouper each) are kept; when the scan leaves a cell,
+     * the older generation is retired and its frequent clusters are emitted. Memory is
+     * one record per run (at most max_fan_in) plus the clusters of two cells.
+     *
+     * Clusters are formed in key order rather than candidate order, so borderline
+     * clusters can differ from tree_optimized_fspm. Supports are exact. If the runs
+     * failed (CandidateRuns::ok) nothing is reported.
+     */
+    inline std::vector<RectangularPattern> external_grouping(const CandidateRuns& runs, const RectangularSketch& S, double epsilon, int min_freq,
+                                                             const MiningOptions& opt = MiningOptions()) {
+        double a = S.size.a;
+        double b = S.size.b;
+        std::vector<std::pair<RectangularPattern, int>> found;
+        std::unique_ptr<TreeGrouper> prev, cur;
+        std::vector<double> prev_anchor, cur_anchor; // (ax, ay) of every representative
+        long long cur_q = 0;
+        CandidateRecord type_of;
+        bool has_type = false;
+        size_t clusters = 0;
+
+        auto retire = [&](std::unique_ptr<TreeGrouper>& g, std::vector<double>& anchor) {
+            if (!g) return;
+            clusters += g->R.size();
+            for (size_t r = 0; r < g->R.size(); ++r) {
+                int sup = g->F[r].min_support();
+                if (sup < min_freq) continue;
+                RectangularPattern P(a, b);
+                P.O_P = std::move(g->R[r].O_P);
+                for (auto& o : P.O_P) { // back to window-relative coordinates
+                    o.x -= anchor[2 * r];
+                    o.y -= anchor[2 * r + 1];
+                }
+                found.push_back({ std::move(P), sup });
+            }
+            g.reset();
+            anchor.clear();
+        };
+
+        size_t distinct = 0;
+        bool scanned = runs.merge_scan([&](const CandidateRecord& rec) {
+            bool new_type = !has_type || !rec.same_type(type_of);
+            if (new_type || rec.q > cur_q + 1) {
+                retire(prev, prev_anchor);
+                retire(cur, cur_anchor);
+            } else if (rec.q == cur_q + 1) {
+                retire(prev, prev_anchor);
+                prev = std::move(cur);
+                prev_anchor.swap(cur_anchor);
+            }
+            if (new_type) {
+                type_of = rec;
+                has_type = true;
+            }
+            cur_q = rec.q;
+            if (!cur) cur = std::make_unique<TreeGrouper>(a, b, epsilon, opt.support_precision());
+
+            int idx = prev ? prev->find(rec.objs) : -1;
+            if (idx >= 0) {
+                prev->members[idx]++;
+                for (size_t i = 0; i < rec.objs.size(); ++i) prev->F[idx].insert(i, rec.objs[i].id);
+                return;
+            }
+            size_t before = cur->R.size();
+            cur->add(rec.objs);
+            if (cur->R.size() > before) {
+                cur_anchor.push_back(rec.ax);
+                cur_anchor.push_back(rec.ay);
+            }
+        }, &distinct);
+        if (!scanned) {
+            std::cerr << "Error: External grouping aborted, no patterns reported" << std::endl;
+            if (opt.report) opt.report->supports.clear();
+            return {};
+        }
+        retire(prev, prev_anchor);
+        retire(cur, cur_anchor);
+
+        std::stable_sort(found.begin(), found.end(), [](const auto& x, const auto& y) { return x.second > y.second; });
+        if (opt.verbose) {
+            std::cout << "[External] " << runs.candidates() << " candidates (" << distinct << " distinct) in " << runs.runs()
+                      << " runs, " << clusters << " clusters, " << found.size() << " frequent." << std::endl;
+        }
+        std::vector<RectangularPattern> R;
+        if (opt.report) {
+            opt.report->supports.clear();
+            opt.report->support_error = 0.0;
+            opt.report->recounted = 0;
+        }
+        for (auto& pf : found) {
+            R.push_back(std::move(pf.first));
+            if (opt.report) opt.report->supports.push_back(pf.second);
+        }
+        return R;
+    }
+
+    // Full external pipeline: streamed candidate generation, sorted runs, merge-scan grouping
+    inline std::vector<RectangularPattern> external_fspm(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq,
+                                                         const ExternalOptions& ext = ExternalOptions(), const MiningOptions& opt = MiningOptions()) {
+        CandidateRuns runs(ext.work_dir, epsilon, ext.run_bytes, ext.max_fan_in);
+        generate_candidates_external(D, S, runs, opt);
+        std::vector<RectangularPattern> R = external_grouping(runs, S, epsilon, min_freq, opt); // empty if a run failed
+        if (!ext.keep_files) runs.remove_files();
+        return R;
+    }
+}
+
+#endif // EXTERNAL_HPP
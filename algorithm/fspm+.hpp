@@ -6,17 +6,40 @@
 #include <algorithm>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <iostream>
 #include <fstream>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <queue>
+#include <tuple>
+#include <cmath>
+#include <memory>
+#include <list>
+#include <sstream>
+#include <iomanip>
+#include <limits>
 #include "dataset.hpp"
 #include "rectangular.hpp"
 #include "fspm.hpp"
+#include "support.hpp"
+#include "options.hpp"
+#include "parallel.hpp"
+#include "spatial_index.hpp"
 
 namespace fspm_plus {
 
+    // Kind of sweep event; the enum order is the tie-break order at equal (y, x_min)
+    enum class EventType : uint8_t {
+        Bottom, // y + b: R_o enters the sweep (add)
+        Top     // y: R_o leaves the sweep (remove)
+    };
+
     // Event for Sweep Line
     struct SweepEvent {
-        std::string type; // "top" or "bottom"
+        EventType type;
         double y;
         double x_min, x_max;
         const SpatialObject* obj;
@@ -32,7 +55,7 @@ namespace fspm_plus {
             }
             if (type != other.type) {
                 // "bottom" should come before "top"
-                return type == "bottom";
+                return type < other.type;
             }
             return false;
         }
@@ -42,6 +65,7 @@ namespace fspm_plus {
     struct SweepWindow {
         double x_start, x_end;
         std::unordered_map<int, int> current_keywords;
+        double y_open = 0.0; // sweep Y at which this window took its current range and counts
     };
 
     // Equality check for keywords map
@@ -73,291 +97,1509 @@ namespace fspm_plus {
     }
 
     /**
-     * @brief Optimization spatial pruning via Sweep-Line algorithm
-     * 
-     * @param D The spatial database
-     * @param S The target sketch
-     * @return std::vector<RectangularRegion> The valid regions (loci of valid window top-lefts)
+     * @brief Sweep events of R_o = [x, x+a] x [y, y+b] for every object, sorted for the descending sweep
+     * With resolution > 0 (Spatial::resolution: coordinates on that fixed-point grid) the
+     * event coordinates are computed as integers on the grid, a and b included, so equal
+     * edges compare exactly equal. The events are then ordered by radix_sort on a packed
+     * 64-bit key (y descending, x_min, type), falling back to std::sort when the grid
+     * extent needs more than 63 bits.
      */
-    inline std::vector<RectangularRegion> spatial_pruning(const Spatial& D, const RectangularSketch& S) {
-        double a = S.size.a;
-        double b = S.size.b;
+    inline std::vector<SweepEvent> make_sweep_events(const std::vector<const SpatialObject*>& objs, double a, double b,
+                                                     double resolution = 0.0, int threads = 1) {
         std::vector<SweepEvent> E;
-        E.reserve(D.objects.size() * 2);
-
-        for (const auto& obj : D.objects) {
-            // OPTIMIZATION: Only consider objects with keywords in Sketch
-            if (S.K.find(obj.keyword) == S.K.end()) {
-                continue;
+        E.reserve(objs.size() * 2);
+
+        if (resolution > 0.0 && !objs.empty()) {
+            long long A = std::llround(a / resolution), B = std::llround(b / resolution);
+            long long x_lo = std::llround(objs[0]->x / resolution), x_hi = x_lo;
+            long long y_lo = std::llround(objs[0]->y / resolution), y_hi = y_lo;
+            for (const SpatialObject* obj : objs) {
+                long long X = std::llround(obj->x / resolution), Y = std::llround(obj->y / resolution);
+                x_lo = std::min(x_lo, X);
+                x_hi = std::max(x_hi, X);
+                y_lo = std::min(y_lo, Y);
+                y_hi = std::max(y_hi, Y);
+                E.push_back({ EventType::Bottom, (double)(Y + B) * resolution, (double)X * resolution, (double)(X + A) * resolution, obj });
+                E.push_back({ EventType::Top, (double)Y * resolution, (double)X * resolution, (double)(X + A) * resolution, obj });
             }
+            auto bits = [](uint64_t v) {
+                int n = 0;
+                while (v) {
+                    n++;
+                    v >>= 1;
+                }
+                return n;
+            };
+            uint64_t y_top = (uint64_t)(y_hi + B);
+            int x_bits = bits((uint64_t)(x_hi - x_lo));
+            int y_bits = bits((uint64_t)(y_hi + B - y_lo));
+            if (x_bits + y_bits + 1 <= 64) {
+                radix_sort(E, [&](const SweepEvent& e) {
+                    uint64_t X = (uint64_t)(std::llround(e.obj->x / resolution) - x_lo);
+                    uint64_t Y = (uint64_t)(std::llround(e.obj->y / resolution) + (e.type == EventType::Bottom ? B : 0));
+                    return ((y_top - Y) << (x_bits + 1)) | (X << 1) | (uint64_t)e.type;
+                }, threads);
+                return E;
+            }
+            std::sort(E.begin(), E.end());
+            return E;
+        }
 
+        for (const SpatialObject* obj : objs) {
             // R_o = [x, x+a] x [y, y+b]
             // "top" event at y (low Y, remove) -> actually top edge of R_o which is y
             // "bottom" event at y+b (high Y, add) -> bottom edge of R_o which is y+b
             // Descending sweep.
-            SweepEvent top = { "top", obj.y, obj.x, obj.x + a, &obj }; 
-            SweepEvent bottom = { "bottom", obj.y + b, obj.x, obj.x + a, &obj };
+            SweepEvent top = { EventType::Top, obj->y, obj->x, obj->x + a, obj };
+            SweepEvent bottom = { EventType::Bottom, obj->y + b, obj->x, obj->x + a, obj };
             E.push_back(bottom);
             E.push_back(top);
         }
 
         // Sort descending Y
         std::sort(E.begin(), E.end());
+        return E;
+    }
 
-        // Initialize Windows covering the relevant X range
+    /**
+     * @brief Window list of one descending sweep over [x_lo, x_hi].
+     * W holds maximal x-runs of equal keyword counts, sorted and contiguous in x.
+     * Instead of reporting every window at every vertical gap, a window is reported
+     * once, through on_close(w, y_lo, y_hi), when its range or counts change. An
+     * event therefore only costs the windows it overlaps.
+     */
+    class SweepLine {
+    public:
+        SweepLine(double x_lo, double x_hi, double y_top) {
+            W.push_back({ x_lo, x_hi, {}, y_top });
+        }
+
+        template <typename OnClose>
+        void apply(const SweepEvent& e, OnClose on_close) {
+            // Only the run [first, last) overlapping the event changes; merges can
+            // only happen around that run.
+            size_t first = std::upper_bound(W.begin(), W.end(), e.x_min, [](double v, const SweepWindow& w) {
+                return v < w.x_end;
+            }) - W.begin();
+            size_t last = std::lower_bound(W.begin() + first, W.end(), e.x_max, [](const SweepWindow& w, double v) {
+                return w.x_start < v;
+            }) - W.begin();
+            if (first >= last) return;
+
+            size_t lo = first > 0 ? first - 1 : first;
+            size_t hi = last < W.size() ? last + 1 : last;
+            std::vector<SweepWindow> next_W;
+            next_W.reserve(hi - lo + 2);
+            if (lo < first) next_W.push_back(W[lo]);
+
+            for (size_t i = first; i < last; ++i) {
+                const SweepWindow& w = W[i];
+                double overlap_start = std::max(w.x_start, e.x_min);
+                double overlap_end = std::min(w.x_end, e.x_max);
+
+                if (w.x_start < overlap_start) {
+                    next_W.push_back({ w.x_start, overlap_start, w.current_keywords, e.y });
+                }
+
+                SweepWindow overlap_win = { overlap_start, overlap_end, w.current_keywords, e.y };
+                if (e.type == EventType::Bottom) {
+                     overlap_win.current_keywords[e.obj->keyword]++;
+                } else {
+                    if (overlap_win.current_keywords.count(e.obj->keyword)) {
+                        overlap_win.current_keywords[e.obj->keyword]--;
+                         if (overlap_win.current_keywords[e.obj->keyword] <= 0) {
+                             overlap_win.current_keywords.erase(e.obj->keyword);
+                         }
+                    }
+                }
+                next_W.push_back(std::move(overlap_win));
+
+                if (overlap_end < w.x_end) {
+                    next_W.push_back({ overlap_end, w.x_end, w.current_keywords, e.y });
+                }
+            }
+            if (last < hi) next_W.push_back(W[last]);
+            
+            // Merge
+            std::vector<SweepWindow> merged;
+            merged.reserve(next_W.size());
+            merged.push_back(std::move(next_W[0]));
+            for (size_t i = 1; i < next_W.size(); ++i) {
+                if (keywords_equal(next_W[i].current_keywords, merged.back().current_keywords)) {
+                    merged.back().x_end = next_W[i].x_end;
+                    merged.back().y_open = e.y;
+                } else {
+                    merged.push_back(std::move(next_W[i]));
+                }
+            }
+
+            // Close every old window that did not survive unchanged (only the untouched
+            // neighbours at either end can survive)
+            bool keep_lo = lo < first && merged.front().x_end == W[lo].x_end;
+            bool keep_hi = last < hi && merged.back().x_start == W[last].x_start;
+            for (size_t i = lo; i < hi; ++i) {
+                if ((i == lo && keep_lo) || (i == last && keep_hi)) continue;
+                if (W[i].y_open > e.y) on_close(W[i], e.y, W[i].y_open);
+            }
+            if (keep_lo) merged.front().y_open = W[lo].y_open;
+            if (keep_hi) merged.back().y_open = W[last].y_open;
+
+            size_t old_len = hi - lo;
+            if (merged.size() > old_len) {
+                W.insert(W.begin() + hi, merged.size() - old_len, SweepWindow());
+            } else if (merged.size() < old_len) {
+                W.erase(W.begin() + lo + merged.size(), W.begin() + hi);
+            }
+            std::move(merged.begin(), merged.end(), W.begin() + lo);
+        }
+
+        // Close all remaining windows at the end of the sweep
+        template <typename OnClose>
+        void finish(double y_end, OnClose on_close) {
+            for (const auto& w : W) {
+                if (w.y_open > y_end) on_close(w, y_end, w.y_open);
+            }
+        }
+
+        size_t size() const { return W.size(); }
+
+    private:
         std::vector<SweepWindow> W;
-        double min_val = D.objects.empty() ? 0 : D.x_min;
-        double max_val = D.objects.empty() ? 0 : D.x_max + a;
-        W.push_back({ min_val, max_val, {} });
+    };
+
+    /**
+     * @brief Run one sweep over sorted events E and collect the windows satisfying S.K
+     * If opt.cancel expires, windows still open are closed at the current event, so the
+     * regions returned so far are valid (only the rest of the sweep is missing).
+     */
+    inline std::vector<RectangularRegion> sweep_regions(const std::vector<SweepEvent>& E, const RectangularSketch& S,
+                                                        double x_lo, double x_hi, const MiningOptions& opt = MiningOptions()) {
+        // Initialize Windows covering the relevant X range
+        SweepLine line(x_lo, x_hi, E.empty() ? 0 : E[0].y);
 
         std::vector<RectangularRegion> V; // Valid regions
-        double y_pre = E.empty() ? 0 : E[0].y; 
+        auto on_close = [&](const SweepWindow& w, double y_lo, double y_hi) {
+            if (has_subset_keywords(S.K, w.current_keywords)) {
+                V.emplace_back(w.x_start, y_lo, w.x_end, y_hi);
+            }
+        };
 
         int count = 0;
         int total = E.size();
+        for (const auto& e : E) {
+            if (opt.cancelled(count)) {
+                opt.mark_partial("sweep", count, total);
+                line.finish(e.y, on_close);
+                return V;
+            }
+            count++;
+            if (opt.verbose && count % 100 == 0) {
+                 std::cout << "\r[FSPM+] Sweep-Line: " << count << "/" << total << " (W size: " << line.size() << ")    " << std::flush;
+            }
+            line.apply(e, on_close);
+        }
+        if (!E.empty()) line.finish(E.back().y, on_close);
+
+        return V;
+    }
+
+    /**
+     * @brief Coarse upper-bound filter ahead of the sweep (MiningOptions::coarse_prefilter).
+     * Objects are counted per keyword in a x b grid cells. A window is a x b, so it lies
+     * in one 2 x 2 block of cells, and the block holding a window that contains o has
+     * its lower-left cell at o's cell or one column / row below. o is kept iff one of
+     * those four blocks has every keyword of S.K at least the sketch's count times:
+     * otherwise every window containing o is invalid and its events are dropped.
+     * The set of valid windows is unchanged; regions next to dropped objects can be cut
+     * into fewer pieces, so candidates can differ from the unfiltered sweep.
+     */
+    inline void coarse_filter(std::vector<const SpatialObject*>& objs, const RectangularSketch& S) {
+        double a = S.size.a;
+        double b = S.size.b;
+        std::vector<int> need;             // per slot
+        std::unordered_map<int, int> slot; // keyword -> slot
+        for (const auto& [kw, count] : S.K) {
+            slot[kw] = (int)need.size();
+            need.push_back(count);
+        }
+        auto cell_key = [](long long c, long long r) { return ((uint64_t)(uint32_t)c << 32) | (uint32_t)r; };
+        auto col = [&](const SpatialObject* o) { return (long long)std::floor(o->x / a); };
+        auto row = [&](const SpatialObject* o) { return (long long)std::floor(o->y / b); };
+
+        std::unordered_map<uint64_t, std::vector<int>> counts;
+        for (const SpatialObject* o : objs) {
+            auto& c = counts[cell_key(col(o), row(o))];
+            if (c.empty()) c.assign(need.size(), 0);
+            c[slot.at(o->keyword)]++;
+        }
+        std::unordered_map<uint64_t, char> block_ok; // lower-left cell -> block satisfies S.K
+        auto ok = [&](long long c, long long r) {
+            auto it = block_ok.find(cell_key(c, r));
+            if (it != block_ok.end()) return (bool)it->second;
+            std::vector<int> sum(need.size(), 0);
+            for (int dc = 0; dc < 2; ++dc) {
+                for (int dr = 0; dr < 2; ++dr) {
+                    auto cell = counts.find(cell_key(c + dc, r + dr));
+                    if (cell == counts.end()) continue;
+                    for (size_t k = 0; k < need.size(); ++k) sum[k] += cell->second[k];
+                }
+            }
+            bool sat = true;
+            for (size_t k = 0; k < need.size() && sat; ++k) sat = sum[k] >= need[k];
+            block_ok.emplace(cell_key(c, r), sat);
+            return sat;
+        };
+        objs.erase(std::remove_if(objs.begin(), objs.end(), [&](const SpatialObject* o) {
+            long long c = col(o), r = row(o);
+            return !(ok(c, r) || ok(c - 1, r) || ok(c, r - 1) || ok(c - 1, r - 1));
+        }), objs.end());
+    }
+
+    /**
+     * @brief Objects that can take part in an instance of S: keyword in S.K, inside
+     * opt.query_box (served by opt.index if set) and in the sample; x ascending.
+     * With opt.coarse_prefilter, objects rejected by coarse_filter are left out too.
+     * [x_lo, x_hi] receives the x range to sweep (the query box clips the dataset's).
+     * @return false if the query box misses the dataset
+     */
+    inline bool sketch_objects(const Spatial& D, const RectangularSketch& S, const MiningOptions& opt,
+                               std::vector<const SpatialObject*>& objs, double& x_lo, double& x_hi) {
+        objs.clear();
+        x_lo = D.objects.empty() ? 0 : D.x_min;
+        x_hi = D.objects.empty() ? 0 : D.x_max;
+        if (opt.query_box) {
+            const RectangularRegion& box = *opt.query_box;
+            x_lo = std::max(x_lo, box.x_min);
+            x_hi = std::min(x_hi, box.x_max);
+            if (opt.index && &opt.index->data() == &D) {
+                objs = opt.index->query(box, &S.K);
+            } else {
+                auto it = std::lower_bound(D.objects.begin(), D.objects.end(), box.x_min, [](const SpatialObject& o, double val) {
+                    return o.x < val;
+                });
+                for (; it != D.objects.end() && it->x <= box.x_max; ++it) {
+                    if (it->y >= box.y_min && it->y <= box.y_max && S.K.count(it->keyword)) objs.push_back(&*it);
+                }
+            }
+            if (x_hi < x_lo) return false;
+        } else {
+            objs.reserve(D.objects.size());
+            for (const auto& obj : D.objects) {
+                // OPTIMIZATION: Only consider objects with keywords in Sketch
+                if (S.K.find(obj.keyword) != S.K.end()) objs.push_back(&obj);
+            }
+        }
+        if (opt.sample_rate < 1.0) {
+            objs.erase(std::remove_if(objs.begin(), objs.end(), [&](const SpatialObject* o) { return !opt.in_sample(*o); }), objs.end());
+        }
+        if (opt.coarse_prefilter) {
+            size_t before = objs.size();
+            coarse_filter(objs, S);
+            if (opt.verbose) std::cout << "[FSPM+] Coarse grid: " << objs.size() << " of " << before << " sketch objects kept ("
+                                       << 2 * objs.size() << " sweep events)." << std::endl;
+        }
+        return true;
+    }
 
+    /**
+     * @brief Optimization spatial pruning via Sweep-Line algorithm
+     * 
+     * @param D The spatial database
+     * @param S The target sketch
+     * @param opt opt.query_box restricts the sweep to the objects inside it (served by opt.index if set)
+     * @return std::vector<RectangularRegion> The valid regions (loci of valid window top-lefts)
+     */
+    inline std::vector<RectangularRegion> spatial_pruning(const Spatial& D, const RectangularSketch& S,
+                                                          const MiningOptions& opt = MiningOptions()) {
+        std::vector<const SpatialObject*> objs;
+        double min_val, max_val;
+        if (!sketch_objects(D, S, opt, objs, min_val, max_val)) return {};
+
+        return sweep_regions(make_sweep_events(objs, S.size.a, S.size.b, D.resolution, opt.num_threads), S, min_val, max_val + S.size.a, opt);
+    }
+
+    /**
+     * @brief Batch spatial pruning: one sweep over the union of the sketches' keywords.
+     * All sketches must share the same a x b. The events of every object whose keyword
+     * appears in any sketch are generated and sorted once. During the single pass each
+     * event is applied only to the window lists of the sketches containing its keyword,
+     * and each sketch's satisfied predicate is evaluated on its own windows. V[k]
+     * therefore equals spatial_pruning(D, sketches[k], opt).
+     *
+     * @param opt The objects come from sketch_objects over the union of the keywords, so
+     *            opt.query_box (served by opt.index), the sample and the sweep range are
+     *            those of a single-sketch run; opt.coarse_prefilter is not applied
+     * @return One valid-region set per sketch, in input order
+     */
+    inline std::vector<std::vector<RectangularRegion>> spatial_pruning_batch(const Spatial& D, const std::vector<RectangularSketch>& sketches,
+                                                                             const MiningOptions& opt = MiningOptions()) {
+        std::vector<std::vector<RectangularRegion>> V(sketches.size());
+        if (sketches.empty()) return V;
+        double a = sketches[0].size.a;
+        double b = sketches[0].size.b;
+        for (const auto& S : sketches) {
+            if (std::abs(S.size.a - a) > 1e-9 || std::abs(S.size.b - b) > 1e-9) {
+                std::cerr << "Error: spatial_pruning_batch needs sketches of the same size." << std::endl;
+                return V;
+            }
+        }
+
+        // Per keyword: the sketches it belongs to
+        std::unordered_map<int, std::vector<size_t>> sketches_of;
+        for (size_t k = 0; k < sketches.size(); ++k) {
+            for (const auto& pair : sketches[k].K) sketches_of[pair.first].push_back(k);
+        }
+        // The coarse filter needs every keyword of one sketch in a block, so it cannot run
+        // on the union
+        RectangularSketch U(a, b);
+        for (const auto& entry : sketches_of) U.K[entry.first] = 1;
+        MiningOptions select = opt;
+        select.coarse_prefilter = false;
+        select.verbose = false;
+        std::vector<const SpatialObject*> objs;
+        double min_val, max_val;
+        if (!sketch_objects(D, U, select, objs, min_val, max_val)) return V;
+        max_val += a;
+        std::vector<SweepEvent> E = make_sweep_events(objs, a, b, D.resolution);
+
+        // A sketch's sweep starts at its own first event, like a single-sketch run
+        std::vector<SweepLine> lines;
+        std::vector<bool> started(sketches.size(), false);
+        lines.reserve(sketches.size());
+        for (size_t k = 0; k < sketches.size(); ++k) lines.emplace_back(min_val, max_val, 0.0);
+
+        auto closer = [&](size_t k) {
+            return [&, k](const SweepWindow& w, double y_lo, double y_hi) {
+                if (has_subset_keywords(sketches[k].K, w.current_keywords)) {
+                    V[k].emplace_back(w.x_start, y_lo, w.x_end, y_hi);
+                }
+            };
+        };
+
+        int count = 0;
+        int total = E.size();
         for (const auto& e : E) {
             count++;
-            if (count % 100 == 0) {
-                 std::cout << "\r[FSPM+] Sweep-Line: " << count << "/" << total << " (W size: " << W.size() << ")    " << std::flush;
+            if (opt.verbose && count % 100 == 0) {
+                 std::cout << "\r[FSPM+] Batch Sweep-Line: " << count << "/" << total << " (" << sketches.size() << " sketches)    " << std::flush;
+            }
+            for (size_t k : sketches_of[e.obj->keyword]) {
+                if (!started[k]) {
+                    lines[k] = SweepLine(min_val, max_val, e.y);
+                    started[k] = true;
+                }
+                lines[k].apply(e, closer(k));
             }
+        }
+        if (!E.empty()) {
+            for (size_t k = 0; k < sketches.size(); ++k) lines[k].finish(E.back().y, closer(k));
+        }
+        return V;
+    }
 
-            // 1. Check vertical gap
-            if (y_pre > e.y) {
-                for (const auto& w : W) {
-                    if (has_subset_keywords(S.K, w.current_keywords)) {
-                        V.emplace_back(w.x_start, e.y, w.x_end, y_pre);
-                    }
+    /**
+     * @brief Merge vertically adjacent valid regions
+     * To avoid generating thousands of duplicate instances from sliced horizontal strips,
+     * we merge strips that align vertically (same x_min, x_max, and adjacent y).
+     */
+    // Order of merged regions: x_min, x_max, then descending y_max
+    inline bool region_order(const RectangularRegion& a, const RectangularRegion& b) {
+        if (std::abs(a.x_min - b.x_min) > 1e-9) return a.x_min < b.x_min;
+        if (std::abs(a.x_max - b.x_max) > 1e-9) return a.x_max < b.x_max;
+        return a.y_max > b.y_max; // Descending Y for easier merging bottom-up (or top-down)
+    }
+
+    inline std::vector<RectangularRegion> merge_regions(std::vector<RectangularRegion> V_raw) {
+        if (!V_raw.empty()) {
+            std::sort(V_raw.begin(), V_raw.end(), region_order);
+        }
+
+        std::vector<RectangularRegion> V;
+        if (!V_raw.empty()) {
+            V.push_back(V_raw[0]);
+            for (size_t i = 1; i < V_raw.size(); ++i) {
+                RectangularRegion& last = V.back();
+                const RectangularRegion& curr = V_raw[i];
+
+                // Check alignment
+                bool alignedX = std::abs(last.x_min - curr.x_min) < 1e-9 && std::abs(last.x_max - curr.x_max) < 1e-9;
+                // Check abutment (last.y_min should be approx curr.y_max since we sorted descending Y)
+                bool abutmentY = std::abs(last.y_min - curr.y_max) < 1e-9;
+
+                if (alignedX && abutmentY) {
+                    // Merge; the x range is the bottom window's, whose min corner extraction reads
+                    last.y_min = curr.y_min;
+                    last.x_min = curr.x_min;
+                    last.x_max = curr.x_max;
+                } else {
+                    V.push_back(curr);
                 }
             }
+        }
+        return V;
+    }
 
-            // 2. Update windows
-            std::vector<SweepWindow> next_W;
-            next_W.reserve(W.size() * 2);
+    /**
+     * @brief Extract the instances of one valid region into sink(Instance&&)
+     * The window is anchored at the region's min corner; instances are not deduplicated.
+     * When opt.index serves D, the window's sketch objects come from its cells instead
+     * of a scan of the full-height x-slab.
+     */
+    template <typename Sink>
+    inline void extract_window(const Spatial& D, const RectangularSketch& S, const RectangularRegion& r,
+                               const MiningOptions& opt, Sink&& sink) {
+        double a = S.size.a;
+        double b = S.size.b;
 
-            for (const auto& w : W) {
-                double overlap_start = std::max(w.x_start, e.x_min);
-                double overlap_end = std::min(w.x_end, e.x_max);
+        // One valid region -> One candidate instance
+        // We align the window to the bottom-left of the valid region key area.
+        double x = r.x_min;
+        double y = r.y_min; // For extraction, we just pick one point (e.g. min corner) from the locus
+        
+        // Window coverage: [x, x+a] x [y, y+b]
+        
+        // Find objects in this window (clipped to the query box, if any)
+        double x_lo = opt.query_box ? std::max(x, opt.query_box->x_min) : x;
+        double x_hi = opt.query_box ? std::min(x + a, opt.query_box->x_max) : x + a;
+
+        std::vector<SpatialObject> O_I;
+        std::unordered_map<int, int> K_I;
+        auto take = [&](const SpatialObject& o) {
+            if (o.y >= y && o.y <= y + b && opt.in_box(o.x, o.y) && opt.in_sample(o)) {
+                O_I.push_back(o);
+                K_I[o.keyword]++;
+            }
+        };
 
-                if (overlap_start < overlap_end) {
-                    if (w.x_start < overlap_start) {
-                        next_W.push_back({ w.x_start, overlap_start, w.current_keywords });
-                    }
+        if (opt.index && &opt.index->data() == &D) {
+            // x ascending like the scan below; objects of other keywords never take part
+            if (x_lo <= x_hi) {
+                for (const SpatialObject* o : opt.index->query(RectangularRegion(x_lo, y, x_hi, y + b), &S.K)) take(*o);
+            }
+        } else {
+            auto it_start = std::lower_bound(D.objects.begin(), D.objects.end(), x_lo, [](const SpatialObject& o, double val) {
+                return o.x < val;
+            });
+            auto it_end = std::upper_bound(D.objects.begin(), D.objects.end(), x_hi, [](double val, const SpatialObject& o) {
+                return val < o.x;
+            });
+            for (auto it = it_start; it < it_end; ++it) take(*it);
+        }
 
-                    SweepWindow overlap_win = { overlap_start, overlap_end, w.current_keywords };
-                    if (e.type == "bottom") {
-                         overlap_win.current_keywords[e.obj->keyword]++;
-                    } else {
-                        if (overlap_win.current_keywords.count(e.obj->keyword)) {
-                            overlap_win.current_keywords[e.obj->keyword]--;
-                             if (overlap_win.current_keywords[e.obj->keyword] <= 0) {
-                                 overlap_win.current_keywords.erase(e.obj->keyword);
-                             }
-                        }
+        // Check if keywords sufficient
+        for (auto const& [kw, count] : S.K) {
+            if (K_I[kw] < count) return;
+        }
+
+        // Greedy extraction of instances from this window
+        std::vector<bool> used(O_I.size(), false);
+        while (true) {
+            Instance inst(a, b, x + a/2.0, y + b/2.0); 
+            std::vector<size_t> currentAttemptIndices;
+
+            for (auto const& [kw, count] : S.K) {
+                int foundInRange = 0;
+                for (size_t i = 0; i < O_I.size(); ++i) {
+                    if (!used[i] && O_I[i].keyword == kw) {
+                        // Check if already selected in current attempt (redundant with used check but safe)
+                        bool alreadyIn = false;
+                        for(size_t idx : currentAttemptIndices) if(idx==i) alreadyIn=true;
+                        if(alreadyIn) continue;
+
+                        currentAttemptIndices.push_back(i);
+                        if (++foundInRange == count) break;
                     }
-                    next_W.push_back(overlap_win);
+                }
+                if (foundInRange < count) return; // Cannot extract more instances from this window
+            }
 
-                    if (overlap_end < w.x_end) {
-                        next_W.push_back({ overlap_end, w.x_end, w.current_keywords });
+            // Mark used
+            for (size_t idx : currentAttemptIndices) {
+                used[idx] = true;
+                SpatialObject subObj = O_I[idx];
+                subObj.x -= x; // coordinates relative to window bounds
+                subObj.y -= y;
+                inst.O_P.push_back(subObj);
+            }
+
+            sink(std::move(inst));
+        }
+    }
+
+    /**
+     * @brief Canonical copy of a duplicate instance: the one with the smallest anchor
+     * (x first, then y), independent of the order the copies were extracted in
+     */
+    inline bool anchor_before(const Instance& p, const Instance& q) {
+        if (p.x != q.x) return p.x < q.x;
+        return p.y < q.y;
+    }
+
+    // Candidate order of dedup_candidates: size, object ids as extracted, anchor
+    inline bool candidate_before(const Instance& a, const Instance& b) {
+        if (a.O_P.size() != b.O_P.size()) return a.O_P.size() < b.O_P.size();
+        for (size_t i = 0; i < a.O_P.size(); ++i) {
+            if (a.O_P[i].id != b.O_P[i].id) return a.O_P[i].id < b.O_P[i].id;
+        }
+        return anchor_before(a, b);
+    }
+
+    /**
+     * @brief Deduplicate candidates (Robustness against overlapping regions)
+     * Of the copies of one instance the canonical one (anchor_before) is kept.
+     */
+    inline void dedup_candidates(std::vector<Instance>& C) {
+        if (!C.empty()) {
+            std::sort(C.begin(), C.end(), candidate_before);
+            C.erase(std::unique(C.begin(), C.end(), [](const Instance& a, const Instance& b) {
+                if (a.O_P.size() != b.O_P.size()) return false;
+                for (size_t i = 0; i < a.O_P.size(); ++i) {
+                    if (a.O_P[i].id != b.O_P[i].id) return false;
+                }
+                return true;
+            }), C.end());
+        }
+    }
+
+    /**
+     * @brief Extract candidate instances of S from merged valid regions
+     * With a cancellation token, regions are visited densest first (most sketch objects
+     * in the window itself, counted through a GridIndex), so a run stopped early has
+     * covered the busiest areas. The index is opt.index when it serves D, otherwise one
+     * built here, and it also serves the extraction windows.
+     */
+    inline std::vector<Instance> extract_candidates(const Spatial& D, const RectangularSketch& S, const std::vector<RectangularRegion>& V,
+                                                    const MiningOptions& opt = MiningOptions()) {
+        std::vector<Instance> C;
+
+        // 3. Extract Instances from Regions
+        std::vector<size_t> order(V.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        // Densest-first: instances are kept per region and concatenated in region order
+        // afterwards, so the deduplication below keeps the same copies in any visiting order
+        std::vector<std::vector<Instance>> per_region(V.size());
+        std::unique_ptr<GridIndex> local;
+        MiningOptions inner = opt;
+        if (opt.cancel && V.size() > 1) {
+            if (!opt.index || &opt.index->data() != &D) {
+                local.reset(new GridIndex(D));
+                inner.index = local.get();
+            }
+            // The window extract_window reads, clipped to the query box
+            std::vector<size_t> dense(V.size());
+            for (size_t i = 0; i < V.size(); ++i) {
+                RectangularRegion w(V[i].x_min, V[i].y_min, V[i].x_min + S.size.a, V[i].y_min + S.size.b);
+                if (opt.query_box) {
+                    w.x_min = std::max(w.x_min, opt.query_box->x_min);
+                    w.y_min = std::max(w.y_min, opt.query_box->y_min);
+                    w.x_max = std::min(w.x_max, opt.query_box->x_max);
+                    w.y_max = std::min(w.y_max, opt.query_box->y_max);
+                    if (w.x_min > w.x_max || w.y_min > w.y_max) continue;
+                }
+                dense[i] = inner.index->query(w, &S.K).size();
+            }
+            std::stable_sort(order.begin(), order.end(), [&](size_t p, size_t q) { return dense[p] > dense[q]; });
+        }
+
+        for (size_t n = 0; n < order.size(); ++n) {
+            if (opt.cancelled(n)) {
+                opt.mark_partial("extraction", n, order.size());
+                break;
+            }
+            std::vector<Instance>& out = per_region[order[n]];
+            extract_window(D, S, V[order[n]], inner, [&](Instance&& inst) { out.push_back(std::move(inst)); });
+        }
+        for (auto& found : per_region) {
+            for (auto& inst : found) C.push_back(std::move(inst));
+        }
+
+        dedup_candidates(C);
+        return C;
+    }
+
+    /**
+     * @brief Margin added to a halo so that coordinates tying exactly with its edge are
+     * inside it: one grid step on snapped data (make_sweep_events rounds a and b to the
+     * grid, by up to half a step), a relative epsilon otherwise.
+     */
+    inline double tie_pad(double resolution, double a, double b) {
+        return resolution > 0.0 ? resolution : 1e-9 * (a + b);
+    }
+
+    inline double tie_pad(const Spatial& D, double a, double b) { return tie_pad(D.resolution, a, b); }
+
+    /**
+     * @brief Merged regions of a sweep over the sketch objects near core, exact for the
+     * regions with their min corner in core.
+     * fetch(H, out) puts the sketch objects inside H into out, x ascending. H starts as
+     * core grown by a + pad, b + pad, so the keyword counts of every point within pad of
+     * core are exact, ties at the core edges included, and so is every window there:
+     * the min corner of a merged region only depends on its bottom window and the one
+     * below. A window is a maximal x-run of equal counts, though, and on gridded data an
+     * object leaving exactly where one of the same keyword enters chains runs past
+     * x + a. A merged region with its corner near core that reaches the right edge of H
+     * may end elsewhere in the full sweep, so H grows to the right (doubling) until none
+     * does or H covers D.
+     */
+    template <typename Fetch>
+    inline std::vector<RectangularRegion> core_regions(const Spatial& D, const RectangularSketch& S, const RectangularRegion& core,
+                                                       const MiningOptions& opt, Fetch&& fetch) {
+        double a = S.size.a;
+        double b = S.size.b;
+        const double pad = tie_pad(D, a, b);
+        RectangularRegion H(core.x_min - a - pad, core.y_min - b - pad, core.x_max + a + pad, core.y_max + b + pad);
+        std::vector<const SpatialObject*> objs;
+        while (true) {
+            fetch(H, objs);
+            if (objs.empty()) return {};
+            std::vector<SweepEvent> E = make_sweep_events(objs, a, b, D.resolution);
+            std::vector<RectangularRegion> V = merge_regions(sweep_regions(E, S, objs.front()->x, objs.back()->x + a, opt));
+            bool cut = false;
+            for (const auto& r : V) {
+                bool near = r.x_min >= core.x_min - pad && r.x_min < core.x_max + pad && r.y_min >= core.y_min - pad && r.y_min < core.y_max + pad;
+                if (near && r.x_max >= H.x_max - 1e-9) {
+                    cut = true;
+                    break;
+                }
+            }
+            if (!cut || H.x_max > D.x_max) return V;
+            H.x_max += H.x_max - core.x_max;
+        }
+    }
+
+    /**
+     * @brief Candidate generation over a density-adaptive quadtree (MiningOptions::leaf_capacity)
+     * The sketch objects are split by QuadTreePartition. Every leaf sweeps its core plus
+     * halo (core_regions, which widens the halo where runs of equal counts reach past it)
+     * and keeps the merged regions whose min corner lies in its core (extraction only
+     * reads the window at that corner, which the halo covers), then extracts them from
+     * D. Leaves run on work_stealing_for, so a dense downtown leaf does not stall the
+     * threads holding suburbs. Regions are put back in merge_regions order before
+     * deduplication, so the result equals the single-sweep path, ties included.
+     */
+    inline std::vector<Instance> partitioned_candidates(const Spatial& D, const RectangularSketch& S,
+                                                        const MiningOptions& opt = MiningOptions()) {
+        double a = S.size.a;
+        double b = S.size.b;
+        std::vector<const SpatialObject*> objs;
+        double x_lo, x_hi;
+        if (!sketch_objects(D, S, opt, objs, x_lo, x_hi)) return {};
+        // Halos padded so that objects tying with a halo edge are in it (core_regions)
+        const double pad = tie_pad(D, a, b);
+        QuadTreePartition Q(objs, a + pad, b + pad, opt.leaf_capacity);
+        const auto& leaves = Q.leaves();
+        if (opt.verbose) {
+            size_t largest = 0, halo = 0;
+            for (const auto& leaf : leaves) {
+                largest = std::max(largest, leaf.core_count);
+                halo += leaf.objects.size();
+            }
+            std::cout << "[FSPM+] Quadtree: " << leaves.size() << " leaves over " << objs.size() << " objects (largest core "
+                      << largest << ", " << halo << " with halos)." << std::endl;
+        }
+
+        MiningOptions inner = opt;
+        inner.verbose = false;
+        inner.cancel = nullptr; // polled once per leaf below
+        std::vector<std::vector<std::pair<RectangularRegion, std::vector<Instance>>>> found(leaves.size());
+        std::atomic<size_t> done(0);
+        std::atomic<bool> stopped(false);
+        work_stealing_for(leaves.size(), opt.num_threads, [&](size_t l) {
+            if (stopped.load(std::memory_order_relaxed)) return;
+            if (opt.cancelled()) {
+                if (!stopped.exchange(true)) opt.mark_partial("sweep", done.load(), leaves.size());
+                return;
+            }
+            const auto& leaf = leaves[l];
+            const RectangularRegion& core = leaf.core;
+            // The leaf's own halo first; a grown one is cut from the x-sorted sketch objects
+            auto fetch = [&](const RectangularRegion& H, std::vector<const SpatialObject*>& out) {
+                if (H.x_max <= core.x_max + a + pad) {
+                    out = leaf.objects;
+                    return;
+                }
+                out.clear();
+                auto it = std::lower_bound(objs.begin(), objs.end(), H.x_min, [](const SpatialObject* o, double v) { return o->x < v; });
+                for (; it != objs.end() && (*it)->x <= H.x_max; ++it) {
+                    if ((*it)->y >= H.y_min && (*it)->y <= H.y_max) out.push_back(*it);
+                }
+            };
+            for (const auto& r : core_regions(D, S, core, inner, fetch)) {
+                if (r.x_min < core.x_min || r.x_min >= core.x_max || r.y_min < core.y_min || r.y_min >= core.y_max) continue;
+                std::vector<Instance> inst;
+                extract_window(D, S, r, inner, [&](Instance&& i) { inst.push_back(std::move(i)); });
+                if (!inst.empty()) found[l].push_back({ r, std::move(inst) });
+            }
+            done++;
+        });
+
+        std::vector<std::pair<RectangularRegion, std::vector<Instance>>*> regions;
+        for (auto& per_leaf : found) {
+            for (auto& entry : per_leaf) regions.push_back(&entry);
+        }
+        std::stable_sort(regions.begin(), regions.end(), [](const auto* p, const auto* q) { return region_order(p->first, q->first); });
+        std::vector<Instance> C;
+        for (auto* entry : regions) {
+            for (auto& inst : entry->second) C.push_back(std::move(inst));
+        }
+        dedup_candidates(C);
+        return C;
+    }
+
+    /**
+     * @brief Disjoint boxes covering a set of a x b grid cells (row, col): runs of cells
+     * per row, stacked when aligned. Box edges are multiples of a and b.
+     */
+    inline std::vector<RectangularRegion> cell_boxes(std::vector<std::pair<long long, long long>> cells, double a, double b) {
+        std::sort(cells.begin(), cells.end());
+        cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+        struct Run { long long c0, c1, r0, r1; };
+        std::vector<Run> runs;
+        for (size_t i = 0; i < cells.size(); ++i) {
+            if (i > 0 && cells[i].first == cells[i - 1].first && cells[i].second == cells[i - 1].second + 1) runs.back().c1++;
+            else runs.push_back({ cells[i].second, cells[i].second, cells[i].first, cells[i].first });
+        }
+        std::sort(runs.begin(), runs.end(), [](const Run& p, const Run& q) {
+            return std::tie(p.c0, p.c1, p.r0) < std::tie(q.c0, q.c1, q.r0);
+        });
+        std::vector<RectangularRegion> boxes;
+        for (size_t i = 0; i < runs.size();) {
+            Run box = runs[i++];
+            while (i < runs.size() && runs[i].c0 == box.c0 && runs[i].c1 == box.c1 && runs[i].r0 == box.r1 + 1) box.r1 = runs[i++].r1;
+            boxes.emplace_back(box.c0 * a, box.r0 * b, (box.c1 + 1) * a, (box.r1 + 1) * b);
+        }
+        return boxes;
+    }
+
+    /**
+     * @brief Candidate generation anchored on the sketch's rarest keyword
+     * (MiningOptions::candidate_engine = CandidateEngine::Anchor).
+     * Every window satisfying S.K holds an object p of the keyword k* with the fewest
+     * objects in D (Spatial::keyword_counts), and a region whose windows hold p has its
+     * min corner in [p.x, p.x + a] x [p.y, p.y + b]. Those anchor boxes are snapped to
+     * the a x b grid (cell_boxes); every box is swept over the sketch objects of its
+     * a x b halo only (core_regions, which grows the halo where gridded coordinates
+     * chain windows past it), fetched through a GridIndex (opt.index if it serves D,
+     * else one built here), and keeps the regions whose min corner falls in its cells.
+     * Regions are put back in merge_regions order before deduplication, as in
+     * partitioned_candidates, so the result equals the single-sweep path, snapped or
+     * not, while the work grows with the number of k* objects rather than with all
+     * sketch objects.
+     */
+    inline std::vector<Instance> anchor_candidates(const Spatial& D, const RectangularSketch& S,
+                                                   const MiningOptions& opt = MiningOptions()) {
+        double a = S.size.a;
+        double b = S.size.b;
+        if (D.objects.empty() || S.K.empty()) return {};
+
+        int rare = 0;
+        size_t rare_count = 0;
+        bool first = true;
+        for (const auto& [kw, need] : S.K) {
+            size_t n = D.keywordCount(kw);
+            if (n < (size_t)need) {
+                if (opt.verbose) std::cout << "[FSPM+] Anchor: keyword " << kw << " has " << n << " objects, sketch needs " << need << "." << std::endl;
+                return {};
+            }
+            if (first || n < rare_count || (n == rare_count && kw < rare)) {
+                rare = kw;
+                rare_count = n;
+                first = false;
+            }
+        }
+
+        // Region edges are object coordinates +- a, b, which rounding can move across a cell
+        // edge; pad the anchor boxes (tie_pad) so that an edge lying exactly on one is always
+        // covered. Extra cells only add work.
+        const double pad = tie_pad(D, a, b);
+        std::vector<std::pair<long long, long long>> cells; // (row, col)
+        size_t anchors = 0;
+        for (const auto& p : D.objects) {
+            if (p.keyword != rare || !opt.in_box(p.x, p.y) || !opt.in_sample(p)) continue;
+            anchors++;
+            long long c0 = (long long)std::floor((p.x - pad) / a), c1 = (long long)std::floor((p.x + a + pad) / a);
+            long long r0 = (long long)std::floor((p.y - pad) / b), r1 = (long long)std::floor((p.y + b + pad) / b);
+            for (long long r = r0; r <= r1; ++r) {
+                for (long long c = c0; c <= c1; ++c) cells.push_back({ r, c });
+            }
+        }
+        std::vector<RectangularRegion> boxes = cell_boxes(std::move(cells), a, b);
+        if (opt.verbose) std::cout << "[FSPM+] Anchor: keyword " << rare << " (" << rare_count << " objects), "
+                                   << anchors << " anchors in " << boxes.size() << " boxes." << std::endl;
+        if (boxes.empty()) return {};
+
+        std::unique_ptr<GridIndex> own;
+        const GridIndex* index = opt.index && &opt.index->data() == &D ? opt.index : nullptr;
+        if (!index) {
+            own.reset(new GridIndex(D));
+            index = own.get();
+        }
+
+        MiningOptions inner = opt;
+        inner.verbose = false;
+        inner.cancel = nullptr; // polled once per box below
+        std::vector<std::vector<std::pair<RectangularRegion, std::vector<Instance>>>> found(boxes.size());
+        std::atomic<size_t> done(0);
+        std::atomic<bool> stopped(false);
+        work_stealing_for(boxes.size(), opt.num_threads, [&](size_t k) {
+            if (stopped.load(std::memory_order_relaxed)) return;
+            if (opt.cancelled()) {
+                if (!stopped.exchange(true)) opt.mark_partial("sweep", done.load(), boxes.size());
+                return;
+            }
+            const RectangularRegion& box = boxes[k];
+            auto fetch = [&](RectangularRegion H, std::vector<const SpatialObject*>& out) {
+                if (opt.query_box) {
+                    H.x_min = std::max(H.x_min, opt.query_box->x_min);
+                    H.y_min = std::max(H.y_min, opt.query_box->y_min);
+                    H.x_max = std::min(H.x_max, opt.query_box->x_max);
+                    H.y_max = std::min(H.y_max, opt.query_box->y_max);
+                }
+                out.clear();
+                if (H.x_min <= H.x_max && H.y_min <= H.y_max) out = index->query(H, &S.K);
+                if (opt.sample_rate < 1.0) {
+                    out.erase(std::remove_if(out.begin(), out.end(), [&](const SpatialObject* o) { return !opt.in_sample(*o); }), out.end());
+                }
+            };
+            long long c0 = std::llround(box.x_min / a), c1 = std::llround(box.x_max / a);
+            long long r0 = std::llround(box.y_min / b), r1 = std::llround(box.y_max / b);
+            for (const auto& r : core_regions(D, S, box, inner, fetch)) {
+                long long c = (long long)std::floor(r.x_min / a), row = (long long)std::floor(r.y_min / b);
+                if (c < c0 || c >= c1 || row < r0 || row >= r1) continue;
+                std::vector<Instance> inst;
+                extract_window(D, S, r, inner, [&](Instance&& i) { inst.push_back(std::move(i)); });
+                if (!inst.empty()) found[k].push_back({ r, std::move(inst) });
+            }
+            done++;
+        });
+
+        std::vector<std::pair<RectangularRegion, std::vector<Instance>>*> regions;
+        for (auto& per_box : found) {
+            for (auto& entry : per_box) regions.push_back(&entry);
+        }
+        std::stable_sort(regions.begin(), regions.end(), [](const auto* p, const auto* q) { return region_order(p->first, q->first); });
+        std::vector<Instance> C;
+        for (auto* entry : regions) {
+            for (auto& inst : entry->second) C.push_back(std::move(inst));
+        }
+        dedup_candidates(C);
+        return C;
+    }
+
+    /**
+     * @brief Common Candidate Generation Logic
+     * With opt.candidate_engine = Anchor only the neighbourhoods of the rarest sketch
+     * keyword are swept (anchor_candidates); with opt.leaf_capacity > 0 the sweep and
+     * extraction run per quadtree leaf (partitioned_candidates).
+     */
+    inline std::vector<Instance> generate_candidates(const Spatial& D, const RectangularSketch& S,
+                                                     const MiningOptions& opt = MiningOptions()) {
+        if (opt.candidate_engine == CandidateEngine::Anchor) return anchor_candidates(D, S, opt);
+        if (opt.leaf_capacity > 0) return partitioned_candidates(D, S, opt);
+        // 1. Get Valid Regions (Candidate Loci)
+        // 2. Merge Vertically Adjacent Regions
+        // 3. Extract Instances from Regions
+        return extract_candidates(D, S, merge_regions(spatial_pruning(D, S, opt)), opt);
+    }
+
+    /**
+     * @brief Rectangles whose candidates can change when `points` are added.
+     * The sweep state changes on [p.x, p.x + a] x [p.y, p.y + b] and the windows containing
+     * p are anchored in [p.x - a, p.x] x [p.y - b, p.y], so p dirties itself expanded by
+     * a x b; a further half window on every side covers regions that are cut differently
+     * next to those (their min corner moves). The union is snapped to an a x b grid and
+     * returned as disjoint boxes (cell_boxes).
+     */
+    inline std::vector<RectangularRegion> dirty_boxes(const std::vector<SpatialObject>& points, double a, double b) {
+        std::vector<std::pair<long long, long long>> cells; // (row, col)
+        for (const auto& p : points) {
+            long long c0 = (long long)std::floor((p.x - 1.5 * a) / a), c1 = (long long)std::floor((p.x + 1.5 * a) / a);
+            long long r0 = (long long)std::floor((p.y - 1.5 * b) / b), r1 = (long long)std::floor((p.y + 1.5 * b) / b);
+            for (long long r = r0; r <= r1; ++r) {
+                for (long long c = c0; c <= c1; ++c) cells.push_back({ r, c });
+            }
+        }
+        return cell_boxes(std::move(cells), a, b);
+    }
+
+    /**
+     * @brief Every instance extracted from the regions whose min corner lies in one of
+     * `boxes` (closed), passed to sink(Instance&&) without deduplication.
+     * Each box is swept through core_regions, so its regions are those of the full sweep,
+     * ties included. A change inside a box also cuts the runs of equal counts reaching
+     * into it from the left (on gridded data they chain from arbitrarily far), and with
+     * them the merged regions holding those runs: a box grows left and down to the min
+     * corner of every merged region crossing its left edge, at least a at a time, until
+     * no such region lies outside it. `boxes` is left holding the grown boxes, the
+     * area whose old candidates the caller replaces.
+     * opt.query_box, opt.index and opt.coarse_prefilter are ignored.
+     */
+    template <typename Sink>
+    inline void extract_in(const Spatial& D, const RectangularSketch& S, std::vector<RectangularRegion>& boxes,
+                           const MiningOptions& opt, Sink&& sink) {
+        double a = S.size.a;
+        MiningOptions plain = opt;
+        plain.verbose = false;
+        plain.query_box = nullptr;
+        plain.index = nullptr; // may predate an append
+        auto fetch = [&](const RectangularRegion& H, std::vector<const SpatialObject*>& out) {
+            out.clear();
+            auto it = std::lower_bound(D.objects.begin(), D.objects.end(), H.x_min, [](const SpatialObject& o, double v) { return o.x < v; });
+            for (; it != D.objects.end() && it->x <= H.x_max; ++it) {
+                if (it->y >= H.y_min && it->y <= H.y_max && S.K.count(it->keyword) && opt.in_sample(*it)) out.push_back(&*it);
+            }
+        };
+        for (auto& box : boxes) {
+            const RectangularRegion dirty = box;
+            std::vector<RectangularRegion> V;
+            while (true) {
+                V = core_regions(D, S, box, plain, fetch);
+                double x_min = box.x_min, y_min = box.y_min;
+                for (const auto& r : V) {
+                    if (r.x_min >= box.x_min || r.x_max < dirty.x_min || r.y_min > dirty.y_max || r.y_max < dirty.y_min) continue;
+                    x_min = std::min(x_min, std::min(r.x_min, box.x_min - a));
+                    y_min = std::min(y_min, r.y_min);
+                }
+                if (x_min == box.x_min) break;
+                box = RectangularRegion(x_min, y_min, box.x_max, box.y_max);
+            }
+            for (const auto& r : V) {
+                if (r.x_min < box.x_min || r.x_min > box.x_max || r.y_min < box.y_min || r.y_min > box.y_max) continue;
+                extract_window(D, S, r, plain, sink);
+            }
+        }
+    }
+
+    // Candidates of extract_in, deduplicated like generate_candidates
+    inline std::vector<Instance> generate_candidates_in(const Spatial& D, const RectangularSketch& S, std::vector<RectangularRegion>& boxes,
+                                                        const MiningOptions& opt = MiningOptions()) {
+        std::vector<Instance> C;
+        extract_in(D, S, boxes, opt, [&](Instance&& inst) { C.push_back(std::move(inst)); });
+        dedup_candidates(C);
+        return C;
+    }
+
+    /**
+     * @brief Candidate generation for several same-size sketches with one shared sweep
+     * @return One candidate set per sketch, in input order
+     */
+    inline std::vector<std::vector<Instance>> generate_candidates_batch(const Spatial& D, const std::vector<RectangularSketch>& sketches,
+                                                                        const MiningOptions& opt = MiningOptions()) {
+        std::vector<std::vector<RectangularRegion>> V = spatial_pruning_batch(D, sketches, opt);
+        std::vector<std::vector<Instance>> C(sketches.size());
+        for (size_t k = 0; k < sketches.size(); ++k) {
+            C[k] = extract_candidates(D, sketches[k], merge_regions(std::move(V[k])), opt);
+        }
+        return C;
+    }
+
+    /**
+     * @brief Sweep events from objects pre-sorted by (Y desc, X asc), without a full sort.
+     * "top" events keep the object order and "bottom" events are the same order shifted
+     * by b, so the two lists are merged linearly; only ties created by rounding y + b
+     * need a local fix-up. With resolution > 0 the coordinates are computed on the
+     * integer grid as in make_sweep_events, and ties created by the rounding are fixed
+     * up in both lists.
+     */
+    inline std::vector<SweepEvent> make_sweep_events_sorted(const std::vector<const SpatialObject*>& objs, double a, double b,
+                                                            double resolution = 0.0) {
+        std::vector<SweepEvent> tops, bottoms, E;
+        tops.reserve(objs.size());
+        bottoms.reserve(objs.size());
+        if (resolution > 0.0) {
+            long long A = std::llround(a / resolution), B = std::llround(b / resolution);
+            for (const SpatialObject* obj : objs) {
+                long long X = std::llround(obj->x / resolution), Y = std::llround(obj->y / resolution);
+                bottoms.push_back({ EventType::Bottom, (double)(Y + B) * resolution, (double)X * resolution, (double)(X + A) * resolution, obj });
+                tops.push_back({ EventType::Top, (double)Y * resolution, (double)X * resolution, (double)(X + A) * resolution, obj });
+            }
+        } else {
+            for (const SpatialObject* obj : objs) {
+                bottoms.push_back({ EventType::Bottom, obj->y + b, obj->x, obj->x + a, obj });
+                tops.push_back({ EventType::Top, obj->y, obj->x, obj->x + a, obj });
+            }
+        }
+        auto fix_ties = [](std::vector<SweepEvent>& list) {
+            for (size_t i = 0; i < list.size();) {
+                size_t j = i + 1;
+                while (j < list.size() && list[j].y == list[i].y) j++;
+                if (j - i > 1) std::sort(list.begin() + i, list.begin() + j);
+                i = j;
+            }
+        };
+        fix_ties(bottoms);
+        if (resolution > 0.0) fix_ties(tops);
+        E.reserve(objs.size() * 2);
+        std::merge(bottoms.begin(), bottoms.end(), tops.begin(), tops.end(), std::back_inserter(E));
+        return E;
+    }
+
+    /**
+     * @brief Multi-scale candidate generation: one keyword multiset K at several window sizes.
+     * Work shared between sizes:
+     *  - the keyword-filtered object list and its (Y desc, X asc) order are computed once,
+     *    and every size's events are derived from that order by a linear merge;
+     *  - containment monotonicity: a window of size s anchored at p lies inside the window
+     *    of any larger size L anchored at p, so V_s is a subset of V_L. Sizes are processed
+     *    largest first, and a smaller size only sweeps objects whose R_o touches V_L of the
+     *    smallest processed size containing it. Windows infeasible at L prune their
+     *    sub-windows at s.
+     *
+     * @param opt Only opt.verbose is read (per-size progress lines)
+     * @return One candidate set per size, in input order (equal to generate_candidates per size)
+     */
+    inline std::vector<std::vector<Instance>> generate_candidates_multiscale(const Spatial& D, const std::unordered_map<int, int>& K,
+                                                                             const std::vector<Rectangular>& sizes,
+                                                                             const MiningOptions& opt = MiningOptions()) {
+        std::vector<std::vector<Instance>> C(sizes.size());
+        std::vector<std::vector<RectangularRegion>> V(sizes.size());
+        std::vector<bool> done(sizes.size(), false);
+        MiningOptions progress;
+        progress.verbose = opt.verbose;
+
+        std::vector<const SpatialObject*> base;
+        base.reserve(D.objects.size());
+        for (const auto& obj : D.objects) {
+            if (K.count(obj.keyword)) base.push_back(&obj);
+        }
+        std::sort(base.begin(), base.end(), [](const SpatialObject* o1, const SpatialObject* o2) {
+            if (o1->y != o2->y) return o1->y > o2->y;
+            return o1->x < o2->x;
+        });
+
+        std::vector<size_t> order(sizes.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+            return sizes[i].a * sizes[i].b > sizes[j].a * sizes[j].b;
+        });
+
+        for (size_t idx : order) {
+            RectangularSketch S(sizes[idx], K);
+            double a = S.size.a;
+            double b = S.size.b;
+
+            // Smallest already-swept size containing this one
+            int parent = -1;
+            for (size_t j = 0; j < sizes.size(); ++j) {
+                if (!done[j] || sizes[j].a < a || sizes[j].b < b) continue;
+                if (parent < 0 || sizes[j].a * sizes[j].b < sizes[parent].a * sizes[parent].b) parent = (int)j;
+            }
+
+            std::vector<const SpatialObject*> objs;
+            if (parent < 0) {
+                objs = base;
+            } else {
+                // Bucket V_L on a grid of L-sized cells; a valid region is never larger than
+                // its window, so it spans at most 2x2 cells
+                const auto& VL = V[parent];
+                double ca = std::max(sizes[parent].a, 1e-9);
+                double cb = std::max(sizes[parent].b, 1e-9);
+                std::unordered_map<long long, std::vector<size_t>> grid;
+                auto cell_key = [](long long cx, long long cy) { return cx * 73856093LL ^ cy * 19349663LL; };
+                for (size_t r = 0; r < VL.size(); ++r) {
+                    for (long long cx = (long long)std::floor(VL[r].x_min / ca); cx <= (long long)std::floor(VL[r].x_max / ca); ++cx) {
+                        for (long long cy = (long long)std::floor(VL[r].y_min / cb); cy <= (long long)std::floor(VL[r].y_max / cb); ++cy) {
+                            grid[cell_key(cx, cy)].push_back(r);
+                        }
                     }
-                } else {
-                    next_W.push_back(w);
                 }
-            }
-            
-            // 3. Merge
-            W.clear();
-            if (!next_W.empty()) {
-                W.push_back(next_W[0]);
-                for (size_t i = 1; i < next_W.size(); ++i) {
-                    if (keywords_equal(next_W[i].current_keywords, W.back().current_keywords)) {
-                        W.back().x_end = next_W[i].x_end;
-                    } else {
-                        W.push_back(next_W[i]);
+                const double tol = 1e-9; // closed rectangles: touching counts as intersecting
+                for (const SpatialObject* o : base) {
+                    bool keep = false;
+                    for (long long cx = (long long)std::floor((o->x - tol) / ca); !keep && cx <= (long long)std::floor((o->x + a + tol) / ca); ++cx) {
+                        for (long long cy = (long long)std::floor((o->y - tol) / cb); !keep && cy <= (long long)std::floor((o->y + b + tol) / cb); ++cy) {
+                            auto it = grid.find(cell_key(cx, cy));
+                            if (it == grid.end()) continue;
+                            for (size_t r : it->second) {
+                                const auto& v = VL[r];
+                                if (o->x <= v.x_max + tol && o->x + a >= v.x_min - tol &&
+                                    o->y <= v.y_max + tol && o->y + b >= v.y_min - tol) {
+                                    keep = true;
+                                    break;
+                                }
+                            }
+                        }
                     }
+                    if (keep) objs.push_back(o);
                 }
             }
 
-            y_pre = e.y;
+            if (opt.verbose) std::cout << "\n[Multi-Scale] " << a << " x " << b << ": sweeping " << objs.size() << "/" << base.size() << " objects" << std::endl;
+            double min_val = D.objects.empty() ? 0 : D.x_min;
+            double max_val = D.objects.empty() ? 0 : D.x_max + a;
+            V[idx] = merge_regions(sweep_regions(make_sweep_events_sorted(objs, a, b, D.resolution), S, min_val, max_val, progress));
+            C[idx] = extract_candidates(D, S, V[idx], progress);
+            done[idx] = true;
         }
-
-        return V;
+        return C;
     }
 
     /**
-     * @brief Common Candidate Generation Logic
+     * @brief Candidate sets shared between engines, keyed by (dataset fingerprint, sketch).
+     * Candidate generation does not depend on epsilon or min_freq, so every grouping
+     * engine run on the same dataset and sketch can reuse one sweep + extraction.
+     * The key also holds every option that changes the candidates (query box, sample,
+     * coarse prefilter, engine, leaf capacity); a generation stopped by opt.cancel is
+     * returned but never stored.
+     * Holds at most max_entries sets and evicts the least recently used one; the
+     * fingerprint is cached by Spatial, so a hit costs no pass over the dataset.
      */
-    inline std::vector<Instance> generate_candidates(const Spatial& D, const RectangularSketch& S) {
-        // 1. Get Valid Regions (Candidate Loci)
-        std::vector<RectangularRegion> V_raw = spatial_pruning(D, S);
-        
-        // 2. Merge Vertically Adjacent Regions
-        // To avoid generating thousands of duplicate instances from sliced horizontal strips,
-        // we merge strips that align vertically (same x_min, x_max, and adjacent y).
-        if (!V_raw.empty()) {
-            std::sort(V_raw.begin(), V_raw.end(), [](const RectangularRegion& a, const RectangularRegion& b) {
-                if (std::abs(a.x_min - b.x_min) > 1e-9) return a.x_min < b.x_min;
-                if (std::abs(a.x_max - b.x_max) > 1e-9) return a.x_max < b.x_max;
-                return a.y_max > b.y_max; // Descending Y for easier merging bottom-up (or top-down)
-            });
+    class CandidateCache {
+    public:
+        struct Entry {
+            std::vector<Instance> C;
+            double seconds = 0.0; // time spent generating C
+        };
+
+        explicit CandidateCache(size_t max_entries = 32) : max_entries_(std::max<size_t>(max_entries, 1)) {}
+
+        // Candidates of S on D (restricted to opt.query_box), generated on first use.
+        // The reference stays valid until the next get/put may evict the entry.
+        const Entry& get(const Spatial& D, const RectangularSketch& S, const MiningOptions& opt = MiningOptions()) {
+            std::string key = cache_key(D, S, opt);
+            auto it = entries_.find(key);
+            if (it != entries_.end()) {
+                lru_.splice(lru_.begin(), lru_, it->second.pos);
+                return it->second.entry;
+            }
+
+            // A report of our own tells a stopped generation apart even when opt has none
+            MiningReport report;
+            MiningOptions run = opt;
+            run.report = &report;
+            auto start = std::chrono::high_resolution_clock::now();
+            Entry entry;
+            entry.C = generate_candidates(D, S, run);
+            entry.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            if (!report.complete) {
+                opt.mark_partial(report.stopped_in.c_str(), report.processed, report.total);
+                partial_ = std::move(entry);
+                return partial_;
+            }
+            return insert(key, std::move(entry));
         }
 
-        std::vector<RectangularRegion> V;
-        if (!V_raw.empty()) {
-            V.push_back(V_raw[0]);
-            for (size_t i = 1; i < V_raw.size(); ++i) {
-                RectangularRegion& last = V.back();
-                const RectangularRegion& curr = V_raw[i];
+        // Store candidates generated elsewhere (e.g. by generate_candidates_multiscale).
+        // Ignored when opt.report says that run stopped early or opt.cancel has expired.
+        void put(const Spatial& D, const RectangularSketch& S, std::vector<Instance> C, double seconds,
+                 const MiningOptions& opt = MiningOptions()) {
+            if ((opt.report && !opt.report->complete) || (opt.cancel && opt.cancel->expired())) return;
+            Entry entry;
+            entry.C = std::move(C);
+            entry.seconds = seconds;
+            insert(cache_key(D, S, opt), std::move(entry));
+        }
 
-                // Check alignment
-                bool alignedX = std::abs(last.x_min - curr.x_min) < 1e-9 && std::abs(last.x_max - curr.x_max) < 1e-9;
-                // Check abutment (last.y_min should be approx curr.y_max since we sorted descending Y)
-                bool abutmentY = std::abs(last.y_min - curr.y_max) < 1e-9;
+        void clear() {
+            entries_.clear();
+            lru_.clear();
+        }
+        size_t size() const { return entries_.size(); }
+
+    private:
+        struct Slot {
+            Entry entry;
+            std::list<std::string>::iterator pos;
+        };
+
+        const Entry& insert(const std::string& key, Entry entry) {
+            auto it = entries_.find(key);
+            if (it != entries_.end()) {
+                it->second.entry = std::move(entry);
+                lru_.splice(lru_.begin(), lru_, it->second.pos);
+                return it->second.entry;
+            }
+            while (entries_.size() >= max_entries_) {
+                entries_.erase(lru_.back());
+                lru_.pop_back();
+            }
+            lru_.push_front(key);
+            Slot& slot = entries_[key];
+            slot.entry = std::move(entry);
+            slot.pos = lru_.begin();
+            return slot.entry;
+        }
 
-                if (alignedX && abutmentY) {
-                    // Merge
-                    last.y_min = curr.y_min;
-                } else {
-                    V.push_back(curr);
-                }
+        // Sizes, box and sample rate at full precision, so nearby values never share a key
+        static std::string cache_key(const Spatial& D, const RectangularSketch& S, const MiningOptions& opt) {
+            std::ostringstream key;
+            key << std::hex << D.fingerprint() << std::dec << "|" << std::setprecision(17) << S.size.a << " " << S.size.b;
+            std::vector<std::pair<int, int>> K(S.K.begin(), S.K.end());
+            std::sort(K.begin(), K.end());
+            for (const auto& kv : K) key << " " << kv.first << ":" << kv.second;
+            if (opt.query_box) {
+                const RectangularRegion& r = *opt.query_box;
+                key << "|" << r.x_min << "," << r.y_min << "," << r.x_max << "," << r.y_max;
             }
+            if (opt.sample_rate < 1.0) key << "|sample " << opt.sample_rate << " " << std::hex << opt.sample_seed << std::dec;
+            key << "|engine " << static_cast<int>(opt.candidate_engine) << " leaf " << opt.leaf_capacity
+                << " coarse " << opt.coarse_prefilter;
+            return key.str();
         }
-        
-        std::vector<Instance> C;
 
-        double a = S.size.a;
-        double b = S.size.b;
+        size_t max_entries_;
+        Entry partial_;              // last stopped generation, handed out but not cached
+        std::list<std::string> lru_; // most recently used first
+        std::unordered_map<std::string, Slot> entries_;
+    };
 
-        // 3. Extract Instances from Regions
-        // We assume D.objects is sorted by X (as per dataset convention/fspm requirement)
-        
-        for (const auto& r : V) {
-            // One valid region -> One candidate instance
-            // We align the window to the bottom-left of the valid region key area.
-            double x = r.x_min;
-            double y = r.y_min; // For extraction, we just pick one point (e.g. min corner) from the locus
-            
-            // Window coverage: [x, x+a] x [y, y+b]
-            
-            // Find objects in this window
-            auto it_start = std::lower_bound(D.objects.begin(), D.objects.end(), x, [](const SpatialObject& o, double val) {
-                return o.x < val;
-            });
-            auto it_end = std::upper_bound(D.objects.begin(), D.objects.end(), x + a, [](double val, const SpatialObject& o) {
-                return val < o.x;
-            });
+    // Tier 1 key: keyword sequence of an instance in canonical order
+    using TypeKey = std::vector<int>;
+
+    struct TypeKeyHash {
+        size_t operator()(const TypeKey& key) const {
+            // FNV-1a over the keyword ids
+            uint64_t h = 1469598103934665603ULL;
+            for (int kw : key) {
+                h ^= static_cast<uint32_t>(kw);
+                h *= 1099511628211ULL;
+            }
+            return static_cast<size_t>(h);
+        }
+    };
 
-            std::vector<SpatialObject> O_I;
-            std::unordered_map<int, int> K_I;
+    inline TypeKey type_key(const std::vector<SpatialObject>& objs) {
+        TypeKey key;
+        key.reserve(objs.size());
+        for (const auto& o : objs) key.push_back(o.keyword);
+        return key;
+    }
 
-            for (auto it = it_start; it != it_end; ++it) {
-                if (it->y >= y && it->y <= y + b) {
-                    O_I.push_back(*it);
-                    K_I[it->keyword]++;
-                }
+    /**
+     * @brief Lock-free union-find over candidate indices.
+     * Roots always link under the smaller index, so a component's root is its
+     * smallest member no matter in which order unions happen.
+     */
+    class ConcurrentUnionFind {
+    public:
+        explicit ConcurrentUnionFind(size_t n) : parent_(n) {
+            for (size_t i = 0; i < n; ++i) parent_[i].store(i, std::memory_order_relaxed);
+        }
+
+        size_t find(size_t x) {
+            while (true) {
+                size_t p = parent_[x].load();
+                if (p == x) return x;
+                size_t gp = parent_[p].load();
+                if (p != gp) parent_[x].compare_exchange_weak(p, gp); // path halving
+                x = gp;
             }
+        }
 
-            // Check if keywords sufficient
-            bool sketchMatch = true;
-            for (auto const& [kw, count] : S.K) {
-                if (K_I[kw] < count) {
-                    sketchMatch = false; 
-                    break;
-                }
+        // Returns true if x and y were in different components
+        bool unite(size_t x, size_t y) {
+            while (true) {
+                x = find(x);
+                y = find(y);
+                if (x == y) return false;
+                if (x > y) std::swap(x, y);
+                size_t expected = y;
+                if (parent_[y].compare_exchange_strong(expected, x)) return true;
             }
+        }
 
-            if (sketchMatch) {
-                // Greedy extraction of instances from this window
-                std::vector<bool> used(O_I.size(), false);
-                while (true) {
-                    Instance inst(a, b, x + a/2.0, y + b/2.0); 
-                    std::vector<size_t> currentAttemptIndices;
-                    bool success = true;
+    private:
+        std::vector<std::atomic<size_t>> parent_;
+    };
 
-                    for (auto const& [kw, count] : S.K) {
-                        int foundInRange = 0;
-                        for (size_t i = 0; i < O_I.size(); ++i) {
-                            if (!used[i] && O_I[i].keyword == kw) {
-                                // Check if already selected in current attempt (redundant with used check but safe)
-                                bool alreadyIn = false;
-                                for(size_t idx : currentAttemptIndices) if(idx==i) alreadyIn=true;
-                                if(alreadyIn) continue;
+    // Blocking cell of a candidate: type key shard plus its object centroid on an epsilon grid
+    struct MatchBlock {
+        size_t shard;
+        long long cx, cy;
+        bool operator==(const MatchBlock& o) const { return shard == o.shard && cx == o.cx && cy == o.cy; }
+    };
 
-                                currentAttemptIndices.push_back(i);
-                                if (++foundInRange == count) break;
-                            }
-                        }
-                        if (foundInRange < count) {
-                            success = false;
-                            break;
-                        }
-                    }
+    struct MatchBlockHash {
+        size_t operator()(const MatchBlock& k) const {
+            uint64_t h = k.shard * 0x9E3779B97F4A7C15ULL;
+            h ^= static_cast<uint64_t>(k.cx) + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+            h ^= static_cast<uint64_t>(k.cy) + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+            return static_cast<size_t>(h);
+        }
+    };
 
-                    if (success) {
-                        // Mark used
-                        for (size_t idx : currentAttemptIndices) {
-                            used[idx] = true;
-                            SpatialObject subObj = O_I[idx];
-                            subObj.x -= x; // coordinates relative to window bounds
-                            subObj.y -= y;
-                            inst.O_P.push_back(subObj);
-                        }
+    /**
+     * @brief Order-independent grouping: clusters are the connected components of the
+     * epsilon-matching graph over C.
+     * Matching pairs are searched in parallel inside blocks. Two instances can only
+     * match if they share a keyword multiset and their centroids are within epsilon
+     * on both axes, so only the 3x3 neighbouring centroid cells are probed. Pairs
+     * whose endpoints are already connected are skipped. Each component is represented
+     * by its smallest candidate. Its supports are collected along the spanning forest
+     * of successful unions, by composing the matchings edge by edge.
+     */
+    inline std::vector<RectangularPattern> union_find_grouping(const std::vector<Instance>& C, const RectangularSketch& S,
+                                                               double epsilon, int min_freq, const MiningOptions& opt) {
+        double a = S.size.a;
+        double b = S.size.b;
+        int threads = resolve_threads(opt.num_threads);
+        double cell = std::max(epsilon, 1e-9);
+
+        // 1. Blocking
+        std::unordered_map<TypeKey, size_t, TypeKeyHash> shard_of;
+        std::vector<MatchBlock> block_of(C.size());
+        std::unordered_map<MatchBlock, std::vector<size_t>, MatchBlockHash> blocks;
+        for (size_t i = 0; i < C.size(); ++i) {
+            TypeKey key = type_key(C[i].O_P);
+            std::sort(key.begin(), key.end());
+            size_t shard = shard_of.emplace(key, shard_of.size()).first->second;
+            double cx = 0.0, cy = 0.0;
+            for (const auto& o : C[i].O_P) { cx += o.x; cy += o.y; }
+            if (!C[i].O_P.empty()) { cx /= C[i].O_P.size(); cy /= C[i].O_P.size(); }
+            block_of[i] = { shard, (long long)std::floor(cx / cell), (long long)std::floor(cy / cell) };
+            blocks[block_of[i]].push_back(i); // ascending candidate order within a block
+        }
 
-                        C.push_back(inst);
-                    } else {
-                        break; // Cannot extract more instances from this window
+        // 2. Parallel pair search + concurrent union
+        ConcurrentUnionFind uf(C.size());
+        std::vector<std::vector<size_t>> forest(C.size()); // forest[i]: j > i united through edge (i, j)
+        std::atomic<bool> stopped(false);
+        std::atomic<size_t> searched(0);
+        parallel_for(C.size(), threads, [&](size_t i) {
+            // On cancellation the components are unions of the edges found so far
+            if (stopped.load(std::memory_order_relaxed) || opt.cancelled(i)) {
+                stopped = true;
+                return;
+            }
+            searched++;
+            const MatchBlock& home = block_of[i];
+            std::vector<int> mapping;
+            for (long long dx = -1; dx <= 1; ++dx) {
+                for (long long dy = -1; dy <= 1; ++dy) {
+                    auto it = blocks.find({ home.shard, home.cx + dx, home.cy + dy });
+                    if (it == blocks.end()) continue;
+                    const auto& members = it->second;
+                    for (auto jt = std::upper_bound(members.begin(), members.end(), i); jt != members.end(); ++jt) {
+                        size_t j = *jt;
+                        if (uf.find(i) == uf.find(j)) continue;
+                        if (C[i].getMatching(C[j], epsilon, a / 2.0, b / 2.0, a / 2.0, b / 2.0, mapping) && uf.unite(i, j)) {
+                            forest[i].push_back(j);
+                        }
                     }
                 }
             }
+        });
+
+        if (stopped) opt.mark_partial("grouping", searched, C.size());
+
+        // 3. Components, numbered by their root (= smallest member)
+        std::vector<size_t> roots;
+        std::vector<std::vector<size_t>> adj(C.size()); // undirected forest edges
+        for (size_t i = 0; i < C.size(); ++i) {
+            if (uf.find(i) == i) roots.push_back(i);
+            for (size_t j : forest[i]) {
+                adj[i].push_back(j);
+                adj[j].push_back(i);
+            }
         }
 
-        // Deduplicate candidates (Robustness against overlapping regions)
-        if (!C.empty()) {
-            std::sort(C.begin(), C.end(), [](const Instance& a, const Instance& b) {
-                if (a.O_P.size() != b.O_P.size()) return a.O_P.size() < b.O_P.size();
-                for (size_t i = 0; i < a.O_P.size(); ++i) {
-                    if (a.O_P[i].id != b.O_P[i].id) return a.O_P[i].id < b.O_P[i].id;
-                }
-                return false; 
-            });
-            C.erase(std::unique(C.begin(), C.end(), [](const Instance& a, const Instance& b) {
-                if (a.O_P.size() != b.O_P.size()) return false;
-                for (size_t i = 0; i < a.O_P.size(); ++i) {
-                    if (a.O_P[i].id != b.O_P[i].id) return false;
+        // 4. Supports per component: walk the forest from the root composing matchings
+        auto collect = [&](size_t root, PatternSupport& F_set) {
+            size_t n = C[root].O_P.size();
+
+            // (node, slot_of) where slot_of[s] is the index in C[node].O_P of representative slot s
+            std::vector<std::pair<size_t, std::vector<int>>> stack;
+            std::vector<int> identity(n);
+            for (size_t s = 0; s < n; ++s) identity[s] = (int)s;
+            stack.push_back({ root, identity });
+            std::unordered_set<size_t> visited = { root };
+            std::vector<int> mapping;
+            while (!stack.empty()) {
+                auto [u, slot_of] = std::move(stack.back());
+                stack.pop_back();
+                for (size_t s = 0; s < n; ++s) F_set.insert(s, C[u].O_P[slot_of[s]].id);
+                for (size_t v : adj[u]) {
+                    if (!visited.insert(v).second) continue;
+                    if (!C[u].getMatching(C[v], epsilon, a / 2.0, b / 2.0, a / 2.0, b / 2.0, mapping)) continue;
+                    std::vector<int> next(n);
+                    for (size_t s = 0; s < n; ++s) next[s] = mapping[slot_of[s]];
+                    stack.push_back({ v, std::move(next) });
                 }
-                return true;
-            }), C.end());
+            }
+        };
+        std::vector<int> supports(roots.size(), 0);
+        parallel_for(roots.size(), threads, [&](size_t r) {
+            PatternSupport F_set(C[roots[r]].O_P.size(), opt.report ? 0 : min_freq, opt.support_precision());
+            collect(roots[r], F_set);
+            supports[r] = F_set.min_support();
+        });
+
+        // Approximate mode: recount components whose estimate is too close to the threshold to trust
+        double rel_error = PatternSupport(1, 0, opt.support_precision()).relative_error();
+        std::vector<size_t> recount;
+        for (size_t r = 0; r < roots.size(); ++r) {
+            if (opt.needs_recount(supports[r], min_freq, rel_error)) recount.push_back(r);
         }
+        parallel_for(recount.size(), threads, [&](size_t q) {
+            size_t r = recount[q];
+            PatternSupport exact(C[roots[r]].O_P.size()); // cap 0: the supports are reported
+            collect(roots[r], exact);
+            supports[r] = exact.min_support();
+        });
+        if (opt.verbose && opt.support_mode == SupportMode::Approximate) std::cout << "[FSPM+] Approximate supports: relative error ~"
+                  << rel_error * 100.0 << "%, recounted " << recount.size() << " near-threshold patterns exactly." << std::endl;
 
-        return C;
+        std::vector<RectangularPattern> R;
+        if (opt.report) {
+            opt.report->supports.clear();
+            opt.report->support_error = rel_error;
+            opt.report->recounted = recount.size();
+        }
+        for (size_t r = 0; r < roots.size(); ++r) {
+            if (supports[r] < min_freq) continue;
+            RectangularPattern P(a, b);
+            P.O_P = C[roots[r]].O_P;
+            R.push_back(P);
+            if (opt.report) opt.report->supports.push_back(supports[r]);
+        }
+        if (opt.verbose) std::cout << "[FSPM+] Union-find grouping: " << roots.size() << " clusters." << std::endl;
+        return R;
     }
 
     /**
      * @brief Execute FSPM+ Algorithm
      * Directly extracts patterns from valid regions found by Sweep-Line.
+     * GroupingMode::UnionFind replaces the greedy absorption loop with union_find_grouping.
+     * This overload runs the grouping stage only, on precomputed candidates (see CandidateCache).
      */
-    inline std::vector<RectangularPattern> fspm_plus(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq) {
-        std::vector<Instance> C = generate_candidates(D, S);
+    inline std::vector<RectangularPattern> fspm_plus(const std::vector<Instance>& C, const RectangularSketch& S, double epsilon, int min_freq,
+                                                     const MiningOptions& opt = MiningOptions()) {
+        if (opt.verbose) std::cout << "\n[FSPM+] Found " << C.size() << " candidate instances matching the sketch." << std::endl;
 
-        std::cout << "\n[FSPM+] Found " << C.size() << " candidate instances matching the sketch." << std::endl;
+        if (opt.grouping == GroupingMode::UnionFind) {
+            return union_find_grouping(C, S, epsilon, min_freq, opt);
+        }
 
         // 3. Pattern Grouping and Frequency Counting (Logic from FSPM)
         std::vector<RectangularPattern> R;
+        if (opt.report) {
+            opt.report->supports.clear();
+            opt.report->support_error = 0.0;
+            opt.report->recounted = 0;
+        }
         std::vector<bool> processed(C.size(), false);
         
         double a = S.size.a;
         double b = S.size.b;
         
+        size_t started = 0; // patterns opened, for polling opt.cancel every cancel_interval
         for (size_t i = 0; i < C.size(); ++i) {
             if (processed[i]) continue;
+            // Stop between patterns: every pattern kept so far absorbed all its matches
+            if (opt.cancelled(started++)) {
+                opt.mark_partial("grouping", i, C.size());
+                break;
+            }
 
             const Instance& I_ref = C[i];
             RectangularPattern P(a, b);
             P.O_P = I_ref.O_P; // Use reference instance configuration
 
-            std::vector<std::set<int>> F_set(P.O_P.size());
+            // Exact supports are only needed when reported; otherwise stop counting at min_freq
+            PatternSupport F_set(P.O_P.size(), opt.report ? 0 : min_freq);
             for (size_t j = 0; j < P.O_P.size(); ++j) {
-                F_set[j].insert(P.O_P[j].id);
+                F_set.insert(j, P.O_P[j].id);
             }
 
             // Find matches
@@ -370,28 +1612,27 @@ namespace fspm_plus {
                     processed[k] = true; // Mark as grouped
                     // Collect IDs for frequency count
                     for (size_t j = 0; j < P.O_P.size(); ++j) {
-                        F_set[j].insert(C[k].O_P[mapping[j]].id);
+                        F_set.insert(j, C[k].O_P[mapping[j]].id);
                     }
                 }
             }
 
             // Check min_freq
-            bool isFrequent = true;
-            for (const auto& ids : F_set) {
-                if ((int)ids.size() < min_freq) {
-                    isFrequent = false;
-                    break;
-                }
-            }
-
-            if (isFrequent) {
+            if (F_set.frequent(min_freq)) {
                 R.push_back(P);
+                if (opt.report) opt.report->supports.push_back(F_set.min_support());
             }
         }
 
         return R;
     }
 
+    // Full pipeline: candidate generation followed by the grouping stage above
+    inline std::vector<RectangularPattern> fspm_plus(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq,
+                                                     const MiningOptions& opt = MiningOptions()) {
+        return fspm_plus(generate_candidates(D, S, opt), S, epsilon, min_freq, opt);
+    }
+
     // --- Tier 2: VP-Tree Structures ---
     
     using RDV = std::vector<double>;
@@ -468,100 +1709,194 @@ namespace fspm_plus {
     }
 
 
+    // Canonical object order used by the tree and signature engines: keyword, then Y, then X, then id
+    inline void canonical_sort(std::vector<SpatialObject>& objs) {
+        std::sort(objs.begin(), objs.end(), [](const SpatialObject& a, const SpatialObject& b) {
+            if (a.keyword != b.keyword) return a.keyword < b.keyword;
+            if (std::abs(a.y - b.y) > 1e-9) return a.y < b.y;
+            if (std::abs(a.x - b.x) > 1e-9) return a.x < b.x;
+            return a.id < b.id;
+        });
+    }
+
+    // RDV (Relative Displacement Vector): Y offsets from the first object in canonical order
+    inline RDV make_rdv(const std::vector<SpatialObject>& objs) {
+        RDV rdv;
+        rdv.reserve(objs.size());
+        double y0 = objs.empty() ? 0.0 : objs[0].y;
+        for (const auto& o : objs) rdv.push_back(o.y - y0);
+        return rdv;
+    }
+
+    /**
+     * @brief Tier 2 grouping state of one type key: VP-tree of cluster representatives
+     * plus their support sets. Instances must be added in canonical order.
+     */
+    struct TreeGrouper {
+        double a, b, epsilon;
+        int hll_precision;
+        VPTreeNode* root = nullptr;
+        std::vector<RectangularPattern> R;  // cluster representatives
+        std::vector<PatternSupport> F;      // support sets of each representative
+        std::vector<int> members;           // candidates assigned to each representative
+        bool collect_support = true;        // false: membership counts only (top-k first pass)
+
+        TreeGrouper(double width, double height, double eps, int precision = 0, bool support = true)
+            : a(width), b(height), epsilon(eps), hll_precision(precision), collect_support(support) {}
+        TreeGrouper(const TreeGrouper&) = delete;
+        TreeGrouper& operator=(const TreeGrouper&) = delete;
+        TreeGrouper(TreeGrouper&& other) noexcept
+            : a(other.a), b(other.b), epsilon(other.epsilon), hll_precision(other.hll_precision),
+              root(other.root), R(std::move(other.R)), F(std::move(other.F)),
+              members(std::move(other.members)), collect_support(other.collect_support) {
+            other.root = nullptr;
+        }
+        ~TreeGrouper() { delete root; }
+
+        // Representative within 2*epsilon of the instance, or -1
+        int find(const std::vector<SpatialObject>& objs) const {
+            return vpt_search(root, make_rdv(objs), 2.0 * epsilon);
+        }
+
+        // Add an instance to its matching cluster (or open a new one); returns the cluster index
+        int add(const std::vector<SpatialObject>& objs) {
+            RDV rdv = make_rdv(objs);
+            int match_idx = vpt_search(root, rdv, 2.0 * epsilon);
+            if (match_idx == -1) {
+                match_idx = (int)R.size();
+                RectangularPattern new_pat(a, b);
+                new_pat.O_P = objs; // Use the canonical sorted form as representative
+                R.push_back(new_pat);
+                members.push_back(0);
+                // No cap: supports are needed for ranking
+                if (collect_support) F.emplace_back(objs.size(), 0, hll_precision);
+                vpt_insert(root, rdv, match_idx);
+            }
+            members[match_idx]++;
+            if (collect_support) {
+                for (size_t i = 0; i < objs.size(); ++i) {
+                    F[match_idx].insert(i, objs[i].id);
+                }
+            }
+            return match_idx;
+        }
+    };
+
     /**
      * @brief Tree-optimized FSPM+ Algorithm
      * Replaces linear grouping with Keyword-Grouped VP-Tree Indexing.
+     * Candidates are sharded by hashed type key and every shard is grouped on its own
+     * worker (MiningOptions::num_threads); shards are merged in candidate order, so the
+     * result does not depend on the thread count.
+     * With SupportMode::Approximate the per-slot id sets are replaced by HyperLogLog registers.
      */
-    inline std::vector<RectangularPattern> tree_optimized_fspm(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq) {
-        // 1. Get Candidate Instances
-        std::vector<Instance> C = generate_candidates(D, S);
-        std::cout << "\n[Tree Opt] Found " << C.size() << " candidate instances." << std::endl;
+    inline std::vector<RectangularPattern> tree_optimized_fspm(std::vector<Instance> C, const RectangularSketch& S, double epsilon, int min_freq,
+                                                               const MiningOptions& opt = MiningOptions()) {
+        if (opt.verbose) std::cout << "\n[Tree Opt] Found " << C.size() << " candidate instances." << std::endl;
 
         // --- TREE GROUPING LOGIC ---
-        
-        // Tier 1: Keyword Map -> Tier 2: VP-Tree Root
-        std::map<std::string, VPTreeNode*> tier1_index;
-        
-        // Results
-        std::vector<RectangularPattern> R; // Stores representative patterns
-        // We also need to store the frequency sets for each representative
-        std::vector<std::vector<std::set<int>>> R_freq_sets;
-
+        int threads = resolve_threads(opt.num_threads);
         double a = S.size.a;
         double b = S.size.b;
 
-        for (const auto& inst : C) {
-            // 1. Canonical Sort (on copy, to generate key)
-            Instance P = inst; 
-            std::sort(P.O_P.begin(), P.O_P.end(), [](const SpatialObject& a, const SpatialObject& b) {
-                if (a.keyword != b.keyword) return a.keyword < b.keyword;
-                if (std::abs(a.y - b.y) > 1e-9) return a.y < b.y;
-                if (std::abs(a.x - b.x) > 1e-9) return a.x < b.x;
-                return a.id < b.id;
-            });
-
-            // 2. Extract Type Signature (Tier 1 Key)
-            std::string type_key = "";
-            for (const auto& o : P.O_P) {
-                type_key += std::to_string(o.keyword) + ",";
-            }
+        // Canonical Sort (in place: C is private to this run)
+        parallel_for(C.size(), threads, [&](size_t c) { canonical_sort(C[c].O_P); });
+
+        // Tier 1: shard candidates by type key, shards numbered by first appearance
+        std::unordered_map<TypeKey, size_t, TypeKeyHash> shard_of;
+        std::vector<std::vector<size_t>> shards;
+        std::vector<size_t> shard_idx(C.size());
+        for (size_t c = 0; c < C.size(); ++c) {
+            auto it = shard_of.emplace(type_key(C[c].O_P), shards.size()).first;
+            if (it->second == shards.size()) shards.emplace_back();
+            shards[it->second].push_back(c);
+            shard_idx[c] = it->second;
+        }
 
-            // 3. Extract RDV (Relative Displacement Vector) for Tier 2
-            double y0 = P.O_P[0].y; // Origin is Y of first object in canonical order
-            RDV rdv;
-            rdv.reserve(P.O_P.size());
-            for (const auto& o : P.O_P) {
-                rdv.push_back(o.y - y0);
+        // Tier 2: group every shard independently
+        std::vector<TreeGrouper> groupers;
+        groupers.reserve(shards.size());
+        for (size_t k = 0; k < shards.size(); ++k) groupers.emplace_back(a, b, epsilon, opt.support_precision());
+        // Largest shards first: they hold the most frequent patterns (and balance best).
+        // On cancellation every shard keeps the clusters of the prefix it has grouped,
+        // which are exactly the clusters a full run builds from that prefix.
+        std::vector<size_t> shard_order(shards.size());
+        for (size_t k = 0; k < shard_order.size(); ++k) shard_order[k] = k;
+        std::stable_sort(shard_order.begin(), shard_order.end(), [&](size_t x, size_t y) { return shards[x].size() > shards[y].size(); });
+        std::vector<int> local_assign(C.size(), -1);
+        std::atomic<bool> stopped(false);
+        std::atomic<size_t> grouped(0);
+        parallel_for(shards.size(), threads, [&](size_t s) {
+            size_t k = shard_order[s];
+            size_t done = 0;
+            for (size_t c : shards[k]) {
+                if (stopped.load(std::memory_order_relaxed) || opt.cancelled(done)) {
+                    stopped = true;
+                    break;
+                }
+                local_assign[c] = groupers[k].add(C[c].O_P);
+                done++;
             }
+            grouped += done;
+        });
+        if (stopped) opt.mark_partial("grouping", grouped, C.size());
 
-            // 4. Search in Tier 1
-            int match_idx = -1;
-            if (tier1_index.find(type_key) != tier1_index.end()) {
-                // Search in VP-Tree (Tier 2)
-                match_idx = vpt_search(tier1_index[type_key], rdv, 2.0 * epsilon);
+        // Merge: number clusters by their first candidate, exactly as a single sequential pass would
+        std::vector<RectangularPattern> R; // Stores representative patterns
+        std::vector<PatternSupport> R_freq_sets;
+        std::vector<int> assign(C.size(), -1); // cluster of each candidate (for exact recount)
+        std::vector<std::vector<int>> global_of(shards.size());
+        for (size_t c = 0; c < C.size(); ++c) {
+            size_t k = shard_idx[c];
+            int local = local_assign[c];
+            if (local < 0) continue; // not reached before cancellation
+            if (local == (int)global_of[k].size()) {
+                global_of[k].push_back((int)R.size());
+                R.push_back(std::move(groupers[k].R[local]));
+                R_freq_sets.push_back(std::move(groupers[k].F[local]));
             }
+            assign[c] = global_of[k][local];
+        }
+        groupers.clear();
 
-            // 5. Handle Match or Insert
-            if (match_idx != -1) {
-                auto& F_set = R_freq_sets[match_idx];
-                for (size_t i = 0; i < P.O_P.size(); ++i) {
-                    F_set[i].insert(P.O_P[i].id);
-                }
-            } else {
-                // New Group
-                int new_idx = R.size();
-                RectangularPattern new_pat(a, b);
-                new_pat.O_P = P.O_P; // Use the canonical sorted form as representative
-                R.push_back(new_pat);
-
-                // Init frequency set
-                std::vector<std::set<int>> f_set(P.O_P.size());
-                for (size_t i = 0; i < P.O_P.size(); ++i) {
-                    f_set[i].insert(P.O_P[i].id);
+        // Compute frequencies for sorting
+        std::vector<int> supports(R.size());
+        for (size_t i = 0; i < R.size(); ++i) supports[i] = R_freq_sets[i].min_support();
+
+        // Approximate mode: recount clusters whose estimate is too close to the threshold to trust
+        double rel_error = R_freq_sets.empty() ? 0.0 : R_freq_sets[0].relative_error();
+        size_t recounted = 0;
+        if (opt.support_mode == SupportMode::Approximate && opt.exact_recount) {
+            std::vector<int> recount_slot(R.size(), -1);
+            std::vector<PatternSupport> exact;
+            for (size_t i = 0; i < R.size(); ++i) {
+                if (opt.needs_recount(supports[i], min_freq, rel_error)) {
+                    recount_slot[i] = (int)exact.size();
+                    exact.emplace_back(R[i].O_P.size()); // cap 0: the supports order the output
                 }
-                R_freq_sets.push_back(f_set);
-
-                // Insert into Index
-                vpt_insert(tier1_index[type_key], rdv, new_idx);
             }
+            for (size_t c = 0; c < C.size(); ++c) {
+                if (assign[c] < 0) continue;
+                int slot = recount_slot[assign[c]];
+                if (slot < 0) continue;
+                const auto& objs = C[c].O_P; // already canonical
+                for (size_t i = 0; i < objs.size(); ++i) exact[slot].insert(i, objs[i].id);
+            }
+            for (size_t i = 0; i < R.size(); ++i) {
+                if (recount_slot[i] < 0) continue;
+                supports[i] = exact[recount_slot[i]].min_support();
+                recounted++;
+            }
+            if (opt.verbose) std::cout << "[Tree Opt] Approximate supports: relative error ~" << rel_error * 100.0
+                      << "%, recounted " << recounted << " near-threshold patterns exactly." << std::endl;
         }
 
-        // Cleanup Trees
-        for(auto& pair : tier1_index) {
-            delete pair.second;
-        }
-
-        // Compute frequencies for sorting
         using PatFreq = std::pair<RectangularPattern, int>;
         std::vector<PatFreq> sorted_R;
         
         for (size_t i=0; i<R.size(); ++i) {
-            int min_sup = 1e9;
-            for (const auto& ids : R_freq_sets[i]) {
-                if ((int)ids.size() < min_sup) min_sup = (int)ids.size();
-            }
-            if (min_sup >= min_freq) {
-                sorted_R.push_back({R[i], min_sup});
+            if (supports[i] >= min_freq) {
+                sorted_R.push_back({R[i], supports[i]});
             }
         }
         
@@ -571,7 +1906,8 @@ namespace fspm_plus {
         });
 
         // Output to file
-        std::ofstream out_file("scripts/output_patterns.txt");
+        std::ofstream out_file;
+        if (!opt.output_path.empty()) out_file.open(opt.output_path);
         bool header_written = false;
         
         for (const auto& pf : sorted_R) {
@@ -587,8 +1923,10 @@ namespace fspm_plus {
             // ID X Y KW
             auto str = pf.first.toString();
             
-            std::cout << "Frequency: " << pf.second << std::endl;
-            std::cout << str << std::endl;
+            if (opt.verbose) {
+                std::cout << "Frequency: " << pf.second << std::endl;
+                std::cout << str << std::endl;
+            }
             
             if (out_file.is_open()) {
                 out_file << "Frequency: " << pf.second << "\n";
@@ -601,16 +1939,342 @@ namespace fspm_plus {
         std::vector<RectangularPattern> final_R;
         for(const auto& pf : sorted_R) final_R.push_back(pf.first);
 
+        if (opt.report) {
+            opt.report->supports.clear();
+            for (const auto& pf : sorted_R) opt.report->supports.push_back(pf.second);
+            opt.report->support_error = rel_error;
+            opt.report->recounted = recounted;
+        }
+
+        return final_R;
+    }
+
+    // Full pipeline: candidate generation followed by the grouping stage above
+    inline std::vector<RectangularPattern> tree_optimized_fspm(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq,
+                                                               const MiningOptions& opt = MiningOptions()) {
+        return tree_optimized_fspm(generate_candidates(D, S, opt), S, epsilon, min_freq, opt);
+    }
+
+    /**
+     * @brief Top-k most frequent patterns of tree_optimized_fspm.
+     * Result: the k highest supports (>= min_freq) of the full run, ties broken by the
+     * cluster's first candidate; identical to the first k of tree_optimized_fspm when supports differ.
+     *
+     * Bounds used to skip work against the current k-th best support:
+     *  - type-key bucket: min(#candidates, min over slots of distinct ids in that slot),
+     *    since a cluster's F(o) only draws ids from its bucket. Buckets are visited by
+     *    descending bound and skipped once the bound falls below the k-th best;
+     *  - cluster: its member count. A bucket is grouped with membership counts only, then
+     *    exact supports are computed for its clusters by descending size until the size
+     *    falls below the k-th best.
+     * Every candidate of one sketch has the sketch's keywords, so C built from a single
+     * sketch is a single bucket, and its patterns span the whole map: no region of it can
+     * be bounded on its own. The bound that skips candidate generation works per sketch,
+     * from per-keyword object counts (sketch_support_bound, see the multi-sketch overload).
+     * Supports are always exact here (SupportMode is ignored).
+     */
+    inline std::vector<RectangularPattern> tree_optimized_topk(std::vector<Instance> C, const RectangularSketch& S, double epsilon, size_t k,
+                                                               int min_freq = 1, const MiningOptions& opt = MiningOptions()) {
+        if (opt.verbose) std::cout << "\n[Tree Top-k] Found " << C.size() << " candidate instances, k = " << k << "." << std::endl;
+        int threads = resolve_threads(opt.num_threads);
+        double a = S.size.a;
+        double b = S.size.b;
+        if (opt.report) {
+            opt.report->supports.clear();
+            opt.report->support_error = 0.0;
+            opt.report->recounted = 0;
+        }
+        if (k == 0) return {};
+
+        parallel_for(C.size(), threads, [&](size_t c) { canonical_sort(C[c].O_P); });
+
+        std::unordered_map<TypeKey, size_t, TypeKeyHash> shard_of;
+        std::vector<std::vector<size_t>> shards;
+        for (size_t c = 0; c < C.size(); ++c) {
+            auto it = shard_of.emplace(type_key(C[c].O_P), shards.size()).first;
+            if (it->second == shards.size()) shards.emplace_back();
+            shards[it->second].push_back(c);
+        }
+
+        // Bucket upper bounds
+        std::vector<int> bound(shards.size());
+        parallel_for(shards.size(), threads, [&](size_t s) {
+            const auto& members = shards[s];
+            size_t n = C[members[0]].O_P.size();
+            int ub = (int)members.size();
+            std::vector<int> ids;
+            for (size_t slot = 0; slot < n && ub > 0; ++slot) {
+                ids.clear();
+                for (size_t c : members) ids.push_back(C[c].O_P[slot].id);
+                std::sort(ids.begin(), ids.end());
+                ub = std::min(ub, (int)(std::unique(ids.begin(), ids.end()) - ids.begin()));
+            }
+            bound[s] = ub;
+        });
+        std::vector<size_t> order(shards.size());
+        for (size_t s = 0; s < order.size(); ++s) order[s] = s;
+        std::sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+            return bound[x] != bound[y] ? bound[x] > bound[y] : x < y;
+        });
+
+        // Min-heap on (support, -first candidate): top() is the current k-th best
+        struct Hit {
+            int support;
+            size_t first; // first candidate of the cluster
+            bool operator<(const Hit& o) const {
+                return support != o.support ? support > o.support : first < o.first;
+            }
+        };
+        std::priority_queue<Hit> heap;
+        auto kth = [&]() { return heap.size() < k ? min_freq : std::max(min_freq, heap.top().support); };
+        auto offer = [&](std::priority_queue<Hit>& h, const Hit& hit) {
+            if (h.size() < k) h.push(hit);
+            else if (hit < h.top()) { h.pop(); h.push(hit); }
+        };
+
+        size_t visited = 0, counted = 0;
+        for (size_t pos = 0; pos < order.size();) {
+            // Buckets are already visited by descending bound, so a cancelled run keeps
+            // the best clusters of the buckets grouped so far
+            if (opt.cancelled()) {
+                opt.mark_partial("grouping", visited, shards.size());
+                break;
+            }
+            // One wave of buckets per round, all pruned against the same threshold
+            int threshold = kth();
+            std::vector<size_t> wave;
+            while (pos < order.size() && wave.size() < (size_t)threads && bound[order[pos]] >= threshold) wave.push_back(order[pos++]);
+            if (wave.empty()) break;
+
+            std::vector<std::priority_queue<Hit>> found(wave.size());
+            std::vector<size_t> counted_in(wave.size(), 0);
+            parallel_for(wave.size(), threads, [&](size_t w) {
+                const auto& members = shards[wave[w]];
+                TreeGrouper grouper(a, b, epsilon, 0, false);
+                std::vector<int> assign(members.size());
+                std::vector<size_t> first;
+                for (size_t m = 0; m < members.size(); ++m) {
+                    assign[m] = grouper.add(C[members[m]].O_P);
+                    if (assign[m] == (int)first.size()) first.push_back(members[m]);
+                }
+
+                std::vector<std::vector<size_t>> member_of(first.size());
+                for (size_t m = 0; m < members.size(); ++m) member_of[assign[m]].push_back(members[m]);
+                std::vector<size_t> by_size(first.size());
+                for (size_t r = 0; r < by_size.size(); ++r) by_size[r] = r;
+                std::sort(by_size.begin(), by_size.end(), [&](size_t x, size_t y) {
+                    int mx = grouper.members[x], my = grouper.members[y];
+                    return mx != my ? mx > my : x < y;
+                });
+
+                auto& h = found[w];
+                size_t n = C[first.empty() ? 0 : first[0]].O_P.size();
+                for (size_t r : by_size) {
+                    int local_kth = h.size() < k ? threshold : std::max(threshold, h.top().support);
+                    if (grouper.members[r] < local_kth) break;
+                    PatternSupport F_set(n);
+                    for (size_t c : member_of[r]) {
+                        for (size_t i = 0; i < n; ++i) F_set.insert(i, C[c].O_P[i].id);
+                    }
+                    counted_in[w]++;
+                    int sup = F_set.min_support();
+                    if (sup >= local_kth) offer(h, { sup, first[r] });
+                }
+            });
+            for (size_t w = 0; w < wave.size(); ++w) {
+                visited++;
+                counted += counted_in[w];
+                for (; !found[w].empty(); found[w].pop()) {
+                    if (found[w].top().support >= min_freq) offer(heap, found[w].top());
+                }
+            }
+        }
+
+        std::vector<Hit> top;
+        for (; !heap.empty(); heap.pop()) top.push_back(heap.top());
+        std::sort(top.begin(), top.end()); // support desc, then first candidate
+
+        std::vector<RectangularPattern> R;
+        for (const Hit& hit : top) {
+            RectangularPattern P(a, b);
+            P.O_P = C[hit.first].O_P; // representative = first candidate, canonical form
+            if (opt.verbose) {
+                std::cout << "Frequency: " << hit.support << std::endl;
+                std::cout << P.toString() << std::endl;
+            }
+            R.push_back(P);
+            if (opt.report) opt.report->supports.push_back(hit.support);
+        }
+        if (opt.verbose) std::cout << "[Tree Top-k] Grouped " << visited << "/" << shards.size() << " type buckets, counted "
+                  << counted << " clusters." << std::endl;
+        return R;
+    }
+
+    /**
+     * @brief Upper bound on the support of every pattern of S, without a sweep.
+     * A pattern's support is at most the distinct objects of any one slot, and a slot only
+     * draws objects of its keyword that lie in some valid window. coarse_filter keeps a
+     * superset of those from per-keyword counts in a x b cells, so the bound is the
+     * smallest count of kept objects over S.K (objects as sketch_objects selects them).
+     */
+    inline int sketch_support_bound(const Spatial& D, const RectangularSketch& S, const MiningOptions& opt = MiningOptions()) {
+        MiningOptions select = opt;
+        select.coarse_prefilter = true;
+        select.verbose = false;
+        std::vector<const SpatialObject*> objs;
+        double x_lo, x_hi;
+        if (S.K.empty() || !sketch_objects(D, S, select, objs, x_lo, x_hi)) return 0;
+        std::unordered_map<int, int> kept;
+        for (const SpatialObject* o : objs) kept[o->keyword]++;
+        int bound = std::numeric_limits<int>::max();
+        for (const auto& [kw, count] : S.K) bound = std::min(bound, kept[kw] >= count ? kept[kw] : 0);
+        return bound;
+    }
+
+    /**
+     * @brief Top-k most frequent patterns over several sketches, one type-key bucket each.
+     * Sketches are visited by descending sketch_support_bound, which costs one pass over
+     * their objects; as soon as the next bound falls below the k-th best support found so
+     * far, that sketch and all the remaining ones are skipped without sweeping or
+     * extracting any of their regions. A visited sketch runs generate_candidates and
+     * tree_optimized_topk with the k-th best support as its min_freq.
+     * Result: the k highest supports (>= min_freq) over all sketches, ties broken by
+     * sketch order and then as in tree_optimized_topk; `sketch_of` (if set) receives the
+     * sketch index of every pattern. opt.cancel stops between sketches or inside one, and
+     * the best patterns found so far are returned.
+     */
+    inline std::vector<RectangularPattern> tree_optimized_topk(const Spatial& D, const std::vector<RectangularSketch>& sketches, double epsilon,
+                                                               size_t k, int min_freq = 1, const MiningOptions& opt = MiningOptions(),
+                                                               std::vector<size_t>* sketch_of = nullptr) {
+        if (opt.report) {
+            opt.report->supports.clear();
+            opt.report->support_error = 0.0;
+            opt.report->recounted = 0;
+        }
+        if (sketch_of) sketch_of->clear();
+        if (k == 0 || sketches.empty()) return {};
+
+        std::vector<int> bound(sketches.size());
+        for (size_t s = 0; s < sketches.size(); ++s) bound[s] = sketch_support_bound(D, sketches[s], opt);
+        std::vector<size_t> order(sketches.size());
+        for (size_t s = 0; s < order.size(); ++s) order[s] = s;
+        std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return bound[x] > bound[y]; });
+
+        struct Hit {
+            int support;
+            size_t sketch, rank; // rank: position in the sketch's own top-k
+            RectangularPattern P;
+        };
+        std::vector<Hit> top; // best first, at most k
+        auto kth = [&]() { return top.size() < k ? min_freq : std::max(min_freq, top.back().support); };
+
+        MiningOptions inner = opt;
+        inner.verbose = false;
+        MiningReport sub;
+        inner.report = &sub;
+        size_t visited = 0;
+        for (size_t s : order) {
+            if (opt.cancelled()) {
+                opt.mark_partial("sketches", visited, sketches.size());
+                break;
+            }
+            if (bound[s] < kth()) break; // every later sketch is bounded lower still
+            visited++;
+            sub = MiningReport();
+            std::vector<RectangularPattern> R = tree_optimized_topk(generate_candidates(D, sketches[s], inner), sketches[s], epsilon, k, kth(), inner);
+            for (size_t r = 0; r < R.size(); ++r) top.push_back({ sub.supports[r], s, r, std::move(R[r]) });
+            std::stable_sort(top.begin(), top.end(), [](const Hit& x, const Hit& y) {
+                if (x.support != y.support) return x.support > y.support;
+                return x.sketch != y.sketch ? x.sketch < y.sketch : x.rank < y.rank;
+            });
+            if (top.size() > k) top.resize(k);
+            if (!sub.complete) {
+                opt.mark_partial(sub.stopped_in.c_str(), sub.processed, sub.total);
+                break;
+            }
+        }
+
+        std::vector<RectangularPattern> R;
+        for (auto& hit : top) {
+            if (opt.verbose) {
+                std::cout << "Frequency: " << hit.support << std::endl;
+                std::cout << hit.P.toString() << std::endl;
+            }
+            if (opt.report) opt.report->supports.push_back(hit.support);
+            if (sketch_of) sketch_of->push_back(hit.sketch);
+            R.push_back(std::move(hit.P));
+        }
+        if (opt.verbose) std::cout << "[Tree Top-k] Mined " << visited << "/" << sketches.size() << " sketches, the others bounded below the k-th best support." << std::endl;
+        return R;
+    }
+
+    // Full pipeline: the multi-sketch top-k above with one sketch, so a sketch whose
+    // support bound is below min_freq returns without generating candidates
+    inline std::vector<RectangularPattern> tree_optimized_topk(const Spatial& D, const RectangularSketch& S, double epsilon, size_t k,
+                                                               int min_freq = 1, const MiningOptions& opt = MiningOptions()) {
+        return tree_optimized_topk(D, std::vector<RectangularSketch>{ S }, epsilon, k, min_freq, opt);
+    }
+
+    /**
+     * @brief Shared tail of the signature engines: exact recount of near-threshold
+     * approximate supports, final min_freq filter and report.
+     */
+    inline std::vector<RectangularPattern> finalize_signature_groups(const std::vector<Instance>& C, const RectangularSketch& S,
+                                                                     double epsilon, int min_freq, const MiningOptions& opt,
+                                                                     const std::vector<RectangularPattern>& R, std::vector<int>& supports,
+                                                                     const std::vector<size_t>& R_ref, const std::vector<size_t>& group_of,
+                                                                     double rel_error) {
+        double a = S.size.a;
+        double b = S.size.b;
+        size_t recounted = 0;
+
+        if (opt.support_mode == SupportMode::Approximate && opt.exact_recount) {
+            std::unordered_map<size_t, size_t> recount_of; // reference candidate -> index in R
+            std::vector<PatternSupport> exact;
+            for (size_t r = 0; r < R.size(); ++r) {
+                if (opt.needs_recount(supports[r], min_freq, rel_error)) {
+                    recount_of[R_ref[r]] = r;
+                    exact.emplace_back(R[r].O_P.size()); // cap 0: the supports order the output
+                } else {
+                    exact.emplace_back();
+                }
+            }
+            for (size_t k = 0; k < C.size() && !recount_of.empty(); ++k) {
+                auto it = recount_of.find(group_of[k]);
+                if (it == recount_of.end()) continue;
+                const RectangularPattern& P = R[it->second];
+                std::vector<int> mapping;
+                if (!P.getMatching(C[k], epsilon, a / 2.0, b / 2.0, a / 2.0, b / 2.0, mapping)) continue;
+                for (size_t j = 0; j < P.O_P.size(); ++j) exact[it->second].insert(j, C[k].O_P[mapping[j]].id);
+            }
+            for (const auto& entry : recount_of) {
+                supports[entry.second] = exact[entry.second].min_support();
+                recounted++;
+            }
+            if (opt.verbose) std::cout << "[Signature] Approximate supports: relative error ~" << rel_error * 100.0
+                      << "%, recounted " << recounted << " near-threshold patterns exactly." << std::endl;
+        }
+
+        std::vector<RectangularPattern> final_R;
+        if (opt.report) {
+            opt.report->supports.clear();
+            opt.report->support_error = rel_error;
+            opt.report->recounted = recounted;
+        }
+        for (size_t r = 0; r < R.size(); ++r) {
+            if (supports[r] < min_freq) continue;
+            final_R.push_back(R[r]);
+            if (opt.report) opt.report->supports.push_back(supports[r]);
+        }
         return final_R;
     }
 
     /**
      * @brief Signature-based Sweep-Line Algorithm with Y-axis discretization
      */
-    inline std::vector<RectangularPattern> signature_sweep_line(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq) {
-        // 1. Get Candidate Instances
-        std::vector<Instance> C = generate_candidates(D, S);
-        std::cout << "\n[Signature Sweep-Line] Found " << C.size() << " candidate instances." << std::endl;
+    inline std::vector<RectangularPattern> signature_sweep_line(const std::vector<Instance>& C, const RectangularSketch& S, double epsilon, int min_freq,
+                                                                const MiningOptions& opt = MiningOptions()) {
+        if (opt.verbose) std::cout << "\n[Signature Sweep-Line] Found " << C.size() << " candidate instances." << std::endl;
 
         double a = S.size.a;
         double b = S.size.b;
@@ -642,18 +2306,30 @@ namespace fspm_plus {
         }
 
         std::vector<RectangularPattern> R;
+        std::vector<int> supports;
+        std::vector<size_t> R_ref; // reference candidate of each pattern in R
         std::vector<bool> processed(C.size(), false);
+        std::vector<size_t> group_of(C.size(), (size_t)-1); // reference candidate each candidate was grouped into
+        double rel_error = 0.0;
         
+        size_t started = 0; // patterns opened, for polling opt.cancel every cancel_interval
         for (size_t i = 0; i < C.size(); ++i) {
             if (processed[i]) continue;
+            if (opt.cancelled(started++)) {
+                opt.mark_partial("grouping", i, C.size());
+                break;
+            }
 
             const Instance& I_ref = C[i];
             RectangularPattern P(a, b);
             P.O_P = I_ref.O_P; 
+            group_of[i] = i;
 
-            std::vector<std::set<int>> F_set(P.O_P.size());
+            // Exact supports are only capped at min_freq when nobody asked for their values
+            PatternSupport F_set(P.O_P.size(), opt.report ? 0 : min_freq, opt.support_precision());
+            rel_error = F_set.relative_error();
             for (size_t j = 0; j < P.O_P.size(); ++j) {
-                F_set[j].insert(P.O_P[j].id);
+                F_set.insert(j, P.O_P[j].id);
             }
 
             // Grouping with Signature Pruning
@@ -676,35 +2352,36 @@ namespace fspm_plus {
                 std::vector<int> mapping;
                 if (P.getMatching(C[k], epsilon, a / 2.0, b / 2.0, a / 2.0, b / 2.0, mapping)) {
                     processed[k] = true; 
+                    group_of[k] = i;
                     for (size_t j = 0; j < P.O_P.size(); ++j) {
-                        F_set[j].insert(C[k].O_P[mapping[j]].id);
+                        F_set.insert(j, C[k].O_P[mapping[j]].id);
                     }
                 }
             }
 
-            bool isFrequent = true;
-            for (const auto& ids : F_set) {
-                if ((int)ids.size() < min_freq) {
-                    isFrequent = false;
-                    break;
-                }
-            }
-
-            if (isFrequent) {
+            int sup = F_set.min_support();
+            if (sup >= min_freq || opt.needs_recount(sup, min_freq, rel_error)) {
                 R.push_back(P);
+                supports.push_back(sup);
+                R_ref.push_back(i);
             }
         }
 
-        return R;
+        return finalize_signature_groups(C, S, epsilon, min_freq, opt, R, supports, R_ref, group_of, rel_error);
+    }
+
+    // Full pipeline: candidate generation followed by the grouping stage above
+    inline std::vector<RectangularPattern> signature_sweep_line(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq,
+                                                                const MiningOptions& opt = MiningOptions()) {
+        return signature_sweep_line(generate_candidates(D, S, opt), S, epsilon, min_freq, opt);
     }
 
     /**
      * @brief Signature-based Sweep-Line Algorithm with X-axis discretization
      */
-    inline std::vector<RectangularPattern> signature_sweep_line_x(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq) {
-        // 1. Get Candidate Instances
-        std::vector<Instance> C = generate_candidates(D, S);
-        std::cout << "\n[Signature Sweep-Line X] Found " << C.size() << " candidate instances." << std::endl;
+    inline std::vector<RectangularPattern> signature_sweep_line_x(const std::vector<Instance>& C, const RectangularSketch& S, double epsilon, int min_freq,
+                                                                  const MiningOptions& opt = MiningOptions()) {
+        if (opt.verbose) std::cout << "\n[Signature Sweep-Line X] Found " << C.size() << " candidate instances." << std::endl;
 
         double a = S.size.a;
         double b = S.size.b;
@@ -736,18 +2413,30 @@ namespace fspm_plus {
         }
 
         std::vector<RectangularPattern> R;
+        std::vector<int> supports;
+        std::vector<size_t> R_ref; // reference candidate of each pattern in R
         std::vector<bool> processed(C.size(), false);
+        std::vector<size_t> group_of(C.size(), (size_t)-1); // reference candidate each candidate was grouped into
+        double rel_error = 0.0;
         
+        size_t started = 0; // patterns opened, for polling opt.cancel every cancel_interval
         for (size_t i = 0; i < C.size(); ++i) {
             if (processed[i]) continue;
+            if (opt.cancelled(started++)) {
+                opt.mark_partial("grouping", i, C.size());
+                break;
+            }
 
             const Instance& I_ref = C[i];
             RectangularPattern P(a, b);
             P.O_P = I_ref.O_P; 
+            group_of[i] = i;
 
-            std::vector<std::set<int>> F_set(P.O_P.size());
+            // Exact supports are only capped at min_freq when nobody asked for their values
+            PatternSupport F_set(P.O_P.size(), opt.report ? 0 : min_freq, opt.support_precision());
+            rel_error = F_set.relative_error();
             for (size_t j = 0; j < P.O_P.size(); ++j) {
-                F_set[j].insert(P.O_P[j].id);
+                F_set.insert(j, P.O_P[j].id);
             }
 
             // Grouping with Signature Pruning
@@ -770,26 +2459,28 @@ namespace fspm_plus {
                 std::vector<int> mapping;
                 if (P.getMatching(C[k], epsilon, a / 2.0, b / 2.0, a / 2.0, b / 2.0, mapping)) {
                     processed[k] = true; 
+                    group_of[k] = i;
                     for (size_t j = 0; j < P.O_P.size(); ++j) {
-                        F_set[j].insert(C[k].O_P[mapping[j]].id);
+                        F_set.insert(j, C[k].O_P[mapping[j]].id);
                     }
                 }
             }
 
-            bool isFrequent = true;
-            for (const auto& ids : F_set) {
-                if ((int)ids.size() < min_freq) {
-                    isFrequent = false;
-                    break;
-                }
-            }
-
-            if (isFrequent) {
+            int sup = F_set.min_support();
+            if (sup >= min_freq || opt.needs_recount(sup, min_freq, rel_error)) {
                 R.push_back(P);
+                supports.push_back(sup);
+                R_ref.push_back(i);
             }
         }
 
-        return R;
+        return finalize_signature_groups(C, S, epsilon, min_freq, opt, R, supports, R_ref, group_of, rel_error);
+    }
+
+    // Full pipeline: candidate generation followed by the grouping stage above
+    inline std::vector<RectangularPattern> signature_sweep_line_x(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq,
+                                                                  const MiningOptions& opt = MiningOptions()) {
+        return signature_sweep_line_x(generate_candidates(D, S, opt), S, epsilon, min_freq, opt);
     }
 }
 
@@ -3,11 +3,11 @@
 
 #include <vector>
 #include <unordered_map>
-#include <set>
 #include <iostream>
 #include <algorithm>
 #include "dataset.hpp"
 #include "rectangular.hpp"
+#include "support.hpp"
 
 /**
  * @brief Frequent Spatial Pattern Mining (FSPM) 算法实现
@@ -166,11 +166,12 @@ inline std::vector<RectangularPattern> fspm(
         matchIndices.push_back(i);
 
         // F(o) 用于存储每个模式对象对应的数据库中唯一对象 ID 集合
-        std::vector<std::set<int>> F_set(P.O_P.size());
+        // 只需判断是否频繁，所有 F(o) 达到 min_freq 后即停止记录
+        PatternSupport F_set(P.O_P.size(), min_freq);
         
         // 引用实例自身的映射 (恒等映射)
         for (size_t j = 0; j < P.O_P.size(); ++j) {
-            F_set[j].insert(P.O_P[j].id);
+            F_set.insert(j, P.O_P[j].id);
         }
 
         // 寻找所有匹配 P 的其他实例
@@ -185,21 +186,13 @@ inline std::vector<RectangularPattern> fspm(
                 matchIndices.push_back(k);
                 // 记录映射到的数据库对象 u 的 ID
                 for (size_t j = 0; j < P.O_P.size(); ++j) {
-                    F_set[j].insert(C[k].O_P[mapping[j]].id);
+                    F_set.insert(j, C[k].O_P[mapping[j]].id);
                 }
             }
         }
 
         // 检查支持度：对所有模式对象 o，其对应的数据库对象集合大小需 >= min_freq
-        bool isFrequent = true;
-        for (const auto& ids : F_set) {
-            if ((int)ids.size() < min_freq) {
-                isFrequent = false;
-                break;
-            }
-        }
-
-        if (isFrequent) {
+        if (F_set.frequent(min_freq)) {
             // 将模式中的对象 ID 重置为本地索引 (0, 1, 2...)
             for (size_t j = 0; j < P.O_P.size(); ++j) {
                 P.O_P[j].id = (int)j;
@@ -0,0 +1,161 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include "rectangular.hpp"
+
+class GridIndex;
+
+namespace fspm_plus {
+
+    // How per-slot supports |F(o)| are counted
+    enum class SupportMode {
+        Exact,       // sorted id sets (PatternSupport default)
+        Approximate  // fixed-size HyperLogLog registers per slot
+    };
+
+    // How fspm_plus groups candidate instances into patterns
+    enum class GroupingMode {
+        Greedy,    // sequential: each unprocessed candidate absorbs all later matches
+        UnionFind  // parallel: connected components of the epsilon-matching graph
+    };
+
+    // How candidate instances are generated
+    enum class CandidateEngine {
+        Sweep,  // one sweep line over every sketch object (or per quadtree leaf, see leaf_capacity)
+        Anchor  // local sweeps around the objects of the sketch's rarest keyword only
+    };
+
+    /**
+     * @brief Cooperative stop signal for a mining run: cancel() from any thread, or a
+     * deadline fixed before the run starts. Engines poll expired() in their sweep,
+     * extraction and grouping loops (see MiningOptions::cancel).
+     */
+    class CancellationToken {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        CancellationToken() = default;
+        explicit CancellationToken(double seconds) { set_deadline(seconds); }
+
+        void cancel() { cancelled_ = true; }
+        void set_deadline(double seconds) {
+            deadline_ = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+            has_deadline_ = true;
+        }
+
+        bool expired() const {
+            if (cancelled_.load(std::memory_order_relaxed)) return true;
+            if (has_deadline_ && Clock::now() >= deadline_) {
+                cancelled_ = true;
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        mutable std::atomic<bool> cancelled_{ false };
+        Clock::time_point deadline_;
+        bool has_deadline_ = false;
+    };
+
+    /**
+     * @brief Optional statistics filled by an engine run (pass via MiningOptions::report)
+     */
+    struct MiningReport {
+        std::vector<int> supports;   // support of each returned pattern, same order as the result
+        double support_error = 0.0;  // relative standard error of supports (0 when exact)
+        size_t recounted = 0;        // near-threshold patterns recounted exactly
+        std::vector<double> ci_low, ci_high; // sampling: confidence interval of each support estimate
+
+        // Cancellation: a stopped run returns the patterns confirmed so far. Engines only
+        // ever clear `complete`, so reuse a report only after resetting it.
+        bool complete = true;
+        std::string stopped_in;      // stage that saw the token expire: "sweep", "extraction", "grouping" or "tiles"
+        size_t processed = 0;        // candidates (or sweep events / regions) handled by that stage
+        size_t total = 0;            // ... out of
+    };
+
+    /**
+     * @brief Opt-in knobs shared by the FSPM+ engines.
+     * A default-constructed value reproduces the original exact behaviour.
+     */
+    struct MiningOptions {
+        SupportMode support_mode = SupportMode::Exact;
+        int hll_precision = 10;        // 2^p registers per slot, ~1.04/sqrt(2^p) relative error
+        bool exact_recount = true;     // Approximate: recount patterns whose estimate is near min_freq
+        double recount_sigmas = 3.0;   // "near" = within this many standard errors of min_freq
+
+        GroupingMode grouping = GroupingMode::Greedy;
+        int num_threads = 0;           // workers for parallel stages, 0 = one per hardware thread
+        size_t leaf_capacity = 0;      // > 0: sweep and extract per quadtree leaf of at most this many objects, in parallel
+        CandidateEngine candidate_engine = CandidateEngine::Sweep;
+        bool coarse_prefilter = false; // drop sketch objects whose 2 x 2 neighbourhoods of a x b cells cannot satisfy S.K
+
+        MiningReport* report = nullptr;
+
+        bool verbose = true;                                    // progress lines and pattern dumps on std::cout
+        std::string output_path = "scripts/output_patterns.txt"; // tree engine pattern file, empty = not written
+
+        // Mine only the objects inside query_box (closed), as if the dataset were cut to it.
+        // index (built once on the same dataset) serves the box without scanning or copying.
+        const RectangularRegion* query_box = nullptr;
+        const GridIndex* index = nullptr;
+
+        // Optional deadline / cancellation, polled every `cancel_interval` loop steps
+        const CancellationToken* cancel = nullptr;
+        size_t cancel_interval = 256;
+
+        // Bernoulli object sample: an object takes part iff hash(id, seed) < sample_rate
+        double sample_rate = 1.0;
+        uint64_t sample_seed = 0x5EED;
+
+        bool in_sample(const SpatialObject& o) const {
+            if (sample_rate >= 1.0) return true;
+            uint64_t x = static_cast<uint64_t>(static_cast<uint32_t>(o.id)) ^ sample_seed;
+            x += 0x9E3779B97F4A7C15ULL; // splitmix64
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+            x ^= x >> 31;
+            return (double)(x >> 11) * 0x1.0p-53 < sample_rate;
+        }
+
+        // Poll the token at step `i` of a loop (every cancel_interval steps)
+        bool cancelled(size_t i = 0) const {
+            return cancel && i % cancel_interval == 0 && cancel->expired();
+        }
+
+        // Record that `stage` stopped after `processed` of `total` steps (first stop wins)
+        void mark_partial(const char* stage, size_t processed, size_t total) const {
+            if (!report || !report->complete) return;
+            report->complete = false;
+            report->stopped_in = stage;
+            report->processed = processed;
+            report->total = total;
+        }
+
+        bool in_box(double x, double y) const {
+            return !query_box || (x >= query_box->x_min && x <= query_box->x_max &&
+                                  y >= query_box->y_min && y <= query_box->y_max);
+        }
+
+        int support_precision() const {
+            return support_mode == SupportMode::Approximate ? hll_precision : 0;
+        }
+
+        // Whether an approximate support estimate is close enough to min_freq to be recounted
+        bool needs_recount(int estimate, int min_freq, double rel_error) const {
+            if (support_mode != SupportMode::Approximate || !exact_recount) return false;
+            double margin = recount_sigmas * rel_error * (estimate > min_freq ? estimate : min_freq);
+            if (margin < 1.0) margin = 1.0; // rounding / register collisions on tiny counts
+            return estimate >= min_freq - margin && estimate <= min_freq + margin;
+        }
+    };
+}
+
+#endif // OPTIONS_HPP
@@ -0,0 +1,258 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <deque>
+#include <cstdint>
+#include <utility>
+
+namespace fspm_plus {
+
+    // Resolve a requested worker count: <= 0 means "one per hardware thread"
+    inline int resolve_threads(int requested) {
+        if (requested > 0) return requested;
+        unsigned hc = std::thread::hardware_concurrency();
+        return hc == 0 ? 1 : (int)hc;
+    }
+
+    /**
+     * @brief Run fn(i) for i in [0, n) on up to `threads` workers.
+     * Indices are handed out dynamically one at a time, so uneven task sizes
+     * (e.g. skewed buckets) still balance. Runs inline when one worker suffices.
+     */
+    template <typename Fn>
+    inline void parallel_for(size_t n, int threads, Fn fn) {
+        int workers = (int)std::min<size_t>((size_t)resolve_threads(threads), n);
+        if (workers <= 1) {
+            for (size_t i = 0; i < n; ++i) fn(i);
+            return;
+        }
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> pool;
+        pool.reserve(workers);
+        for (int w = 0; w < workers; ++w) {
+            pool.emplace_back([&]() {
+                for (size_t i = next++; i < n; i = next++) fn(i);
+            });
+        }
+        for (auto& t : pool) t.join();
+    }
+
+    /**
+     * @brief Run fn(i) for i in [0, n) on up to `threads` workers with work stealing.
+     * Worker w starts with the contiguous block [w n / W, (w + 1) n / W) in its own
+     * deque, so neighbouring indices (e.g. adjacent quadtree leaves) run on the same
+     * worker; a worker whose deque is empty steals the back half of the fullest other
+     * deque. For task lists whose costs are skewed but correlated with the index.
+     */
+    template <typename Fn>
+    inline void work_stealing_for(size_t n, int threads, Fn fn) {
+        int workers = (int)std::min<size_t>((size_t)resolve_threads(threads), n);
+        if (workers <= 1) {
+            for (size_t i = 0; i < n; ++i) fn(i);
+            return;
+        }
+        struct Queue {
+            std::mutex mutex;
+            std::deque<size_t> items;
+        };
+        std::vector<Queue> queues(workers);
+        for (int w = 0; w < workers; ++w) {
+            for (size_t i = n * w / workers; i < n * (w + 1) / workers; ++i) queues[w].items.push_back(i);
+        }
+        auto run = [&](int w) {
+            std::vector<size_t> loot;
+            while (true) {
+                size_t i = 0;
+                bool found = false;
+                {
+                    std::lock_guard<std::mutex> lock(queues[w].mutex);
+                    if (!queues[w].items.empty()) {
+                        i = queues[w].items.front();
+                        queues[w].items.pop_front();
+                        found = true;
+                    }
+                }
+                if (found) {
+                    fn(i);
+                    continue;
+                }
+                // No task is ever added, so once every deque is empty the work is done
+                int victim = -1;
+                size_t most = 0;
+                for (int v = 0; v < workers; ++v) {
+                    if (v == w) continue;
+                    std::lock_guard<std::mutex> lock(queues[v].mutex);
+                    if (queues[v].items.size() > most) {
+                        most = queues[v].items.size();
+                        victim = v;
+                    }
+                }
+                if (victim < 0) return;
+                loot.clear();
+                {
+                    std::lock_guard<std::mutex> lock(queues[victim].mutex);
+                    auto& items = queues[victim].items;
+                    size_t take = (items.size() + 1) / 2;
+                    loot.assign(items.end() - take, items.end());
+                    items.erase(items.end() - take, items.end());
+                }
+                std::lock_guard<std::mutex> lock(queues[w].mutex);
+                queues[w].items.insert(queues[w].items.end(), loot.begin(), loot.end());
+            }
+        };
+        std::vector<std::thread> pool;
+        pool.reserve(workers);
+        for (int w = 0; w < workers; ++w) pool.emplace_back(run, w);
+        for (auto& t : pool) t.join();
+    }
+
+    /**
+     * @brief Stable LSD radix sort of `items` by key(item), a uint64_t, 11 bits per pass.
+     * Keys are taken relative to the smallest one, and only the passes up to the highest
+     * set bit of the largest offset run. The (key, index) array is cut into one block per
+     * worker: blocks extract their keys and their min / max in parallel, then every pass
+     * counts digits per block, a prefix sum over (digit, block) gives each block its
+     * output offsets, and blocks scatter in parallel. Items are moved once at the end,
+     * each block gathering its share of the output. T must be default-constructible.
+     */
+    template <typename T, typename KeyFn>
+    inline void radix_sort(std::vector<T>& items, KeyFn key, int threads) {
+        size_t n = items.size();
+        if (n < 2) return;
+        using Pair = std::pair<uint64_t, uint32_t>;
+        std::vector<Pair> src(n), dst(n);
+        // Blocks of at least 64k pairs: below that the scatter is cheaper than a thread
+        size_t blocks = std::min<size_t>((size_t)resolve_threads(threads), (n + 65535) / 65536);
+        auto first = [&](size_t k) { return n * k / blocks; };
+
+        std::vector<uint64_t> block_min(blocks, ~0ULL), block_max(blocks, 0);
+        parallel_for(blocks, (int)blocks, [&](size_t k) {
+            uint64_t lo = ~0ULL, hi = 0;
+            for (size_t i = first(k); i < first(k + 1); ++i) {
+                src[i] = { key(items[i]), (uint32_t)i };
+                lo = std::min(lo, src[i].first);
+                hi = std::max(hi, src[i].first);
+            }
+            block_min[k] = lo;
+            block_max[k] = hi;
+        });
+        uint64_t min_key = *std::min_element(block_min.begin(), block_min.end());
+        uint64_t max_key = *std::max_element(block_max.begin(), block_max.end()) - min_key;
+        // Sort by the offset from the smallest key: only the bits that vary cost a pass
+        if (min_key != 0) {
+            parallel_for(blocks, (int)blocks, [&](size_t k) {
+                for (size_t i = first(k); i < first(k + 1); ++i) src[i].first -= min_key;
+            });
+        }
+        const int digit = 11;
+        const size_t radix = (size_t)1 << digit;
+        int passes = 0;
+        while (passes * digit < 64 && (max_key >> (digit * passes)) != 0) passes++;
+
+        std::vector<size_t> offset(blocks * radix);
+        for (int pass = 0; pass < passes; ++pass) {
+            int shift = digit * pass;
+            std::fill(offset.begin(), offset.end(), 0);
+            parallel_for(blocks, (int)blocks, [&](size_t k) {
+                size_t* count = &offset[k * radix];
+                for (size_t i = first(k); i < first(k + 1); ++i) count[(src[i].first >> shift) & (radix - 1)]++;
+            });
+            // A digit shared by every key leaves the order as it is
+            bool constant = false;
+            for (size_t d = 0; d < radix && !constant; ++d) {
+                size_t total = 0;
+                for (size_t k = 0; k < blocks; ++k) total += offset[k * radix + d];
+                constant = total == n;
+            }
+            if (constant) continue;
+            size_t sum = 0;
+            for (size_t d = 0; d < radix; ++d) {
+                for (size_t k = 0; k < blocks; ++k) {
+                    size_t c = offset[k * radix + d];
+                    offset[k * radix + d] = sum;
+                    sum += c;
+                }
+            }
+            parallel_for(blocks, (int)blocks, [&](size_t k) {
+                size_t* next = &offset[k * radix];
+                for (size_t i = first(k); i < first(k + 1); ++i) dst[next[(src[i].first >> shift) & (radix - 1)]++] = src[i];
+            });
+            src.swap(dst);
+        }
+
+        std::vector<T> sorted(n);
+        parallel_for(blocks, (int)blocks, [&](size_t k) {
+            for (size_t i = first(k); i < first(k + 1); ++i) sorted[i] = std::move(items[src[i].second]);
+        });
+        items.swap(sorted);
+    }
+
+    /**
+     * @brief Fixed set of long-lived workers draining a FIFO task queue.
+     * For independent jobs that arrive over time (e.g. server queries); the
+     * destructor finishes queued tasks before joining.
+     */
+    class ThreadPool {
+    public:
+        explicit ThreadPool(int threads = 0) {
+            int workers = resolve_threads(threads);
+            for (int w = 0; w < workers; ++w) {
+                workers_.emplace_back([this]() { run(); });
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            cv_.notify_all();
+            for (auto& t : workers_) t.join();
+        }
+
+        void submit(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                tasks_.push(std::move(task));
+            }
+            cv_.notify_one();
+        }
+
+        size_t size() const { return workers_.size(); }
+
+    private:
+        void run() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+                    if (tasks_.empty()) return; // stopping and drained
+                    task = std::move(tasks_.front());
+                    tasks_.pop();
+                }
+                task();
+            }
+        }
+
+        std::vector<std::thread> workers_;
+        std::queue<std::function<void()>> tasks_;
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        bool stopping_ = false;
+    };
+}
+
+#endif // PARALLEL_HPP
@@ -6,6 +6,7 @@
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <sstream>
 #include "dataset.hpp"
 
 /**
@@ -60,10 +61,15 @@ struct RectangularSketch {
         return K.empty();
     }
 
+    /**
+     * @brief 规范化字符串：关键字按 ID 升序输出，同一 Sketch 总是得到相同的字符串
+     */
     std::string toString() const {
+        std::vector<std::pair<int, int>> sorted(K.begin(), K.end());
+        std::sort(sorted.begin(), sorted.end());
         std::stringstream ss;
-        ss << size.a << " " << size.b << " " << K.size();
-        for (auto const& [kw, count] : K) {
+        ss << size.a << " " << size.b << " " << sorted.size();
+        for (auto const& [kw, count] : sorted) {
             ss << " " << kw << " " << count;
         }
         return ss.str();
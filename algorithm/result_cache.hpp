@@ -0,0 +1,230 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <vector>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <mutex>
+#include <filesystem>
+#include <cstdint>
+#include <algorithm>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+
+namespace fspm_plus {
+
+    /**
+     * @brief Mined pattern set with the support of every pattern, as stored in ResultCache
+     */
+    struct CachedResult {
+        std::vector<RectangularPattern> patterns;
+        std::vector<int> supports; // same order as patterns (may be empty if the engine did not report)
+    };
+
+    /**
+     * @brief Persistent on-disk cache of mining results with an LRU size limit.
+     *
+     * Key: (dataset fingerprint, canonical sketch string, epsilon, min_freq, algorithm
+     * [, query box]). Callers should fold every option that changes the result (grouping
+     * or support mode, top-k size, ...) into the algorithm string.
+     *
+     * One file per entry, <dir>/<hash>.fpr, in native byte order:
+     *   "FPRC" u32 version | u32 key length, key bytes | u32 pattern count |
+     *   per pattern: f64 a, f64 b, i32 support, u32 n, n x (i32 id, f64 x, f64 y, i32 keyword)
+     * The stored key is compared on load, so hash collisions read as misses. Recency
+     * is the file modification time, so the LRU order survives restarts. Thread-safe.
+     */
+    class ResultCache {
+    public:
+        explicit ResultCache(const std::string& dir, uintmax_t max_bytes = 256ull << 20)
+            : dir_(dir), max_bytes_(max_bytes) {
+            namespace fs = std::filesystem;
+            std::error_code ec;
+            fs::create_directories(dir_, ec);
+            std::vector<std::pair<fs::file_time_type, fs::path>> files;
+            for (const auto& e : fs::directory_iterator(dir_, ec)) {
+                if (e.path().extension() == ".fpr") files.push_back({ fs::last_write_time(e.path(), ec), e.path() });
+            }
+            std::sort(files.begin(), files.end());
+            for (const auto& f : files) {
+                uintmax_t size = fs::file_size(f.second, ec);
+                lru_.push_front(f.second.stem().string());
+                entries_[lru_.front()] = { size, lru_.begin() };
+                bytes_ += size;
+            }
+            evict();
+        }
+
+        static std::string make_key(uint64_t fingerprint, const RectangularSketch& S, double epsilon, int min_freq,
+                                    const std::string& algorithm, const RectangularRegion* box = nullptr) {
+            std::ostringstream key;
+            key << std::hex << fingerprint << std::dec << "|" << S.toString() << "|" << std::setprecision(17)
+                << epsilon << "|" << min_freq << "|" << algorithm;
+            if (box) key << "|" << box_key(*box);
+            return key.str();
+        }
+
+        // Query box at full double precision, so that distinct boxes never share a key
+        static std::string box_key(const RectangularRegion& box) {
+            std::ostringstream key;
+            key << std::setprecision(17) << box.x_min << "," << box.y_min << "," << box.x_max << "," << box.y_max;
+            return key.str();
+        }
+
+        bool get(const std::string& key, CachedResult& out) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::string name = file_name(key);
+            auto it = entries_.find(name);
+            if (it == entries_.end()) return false;
+
+            std::ifstream in(path_of(name), std::ios::binary);
+            if (!in || !read(in, key, out)) {
+                in.close();
+                if (!std::filesystem::exists(path_of(name))) { // removed behind our back
+                    bytes_ -= it->second.size;
+                    lru_.erase(it->second.pos);
+                    entries_.erase(it);
+                }
+                return false;
+            }
+            lru_.splice(lru_.begin(), lru_, it->second.pos);
+            std::error_code ec;
+            std::filesystem::last_write_time(path_of(name), std::filesystem::file_time_type::clock::now(), ec);
+            return true;
+        }
+
+        void put(const std::string& key, const std::vector<RectangularPattern>& patterns, const std::vector<int>& supports) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::string name = file_name(key);
+            std::string path = path_of(name);
+            {
+                std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                if (!out) {
+                    std::cerr << "Error: Could not write cache file " << path << std::endl;
+                    return;
+                }
+                write(out, key, patterns, supports);
+            }
+            std::error_code ec;
+            uintmax_t size = std::filesystem::file_size(path, ec);
+            auto it = entries_.find(name);
+            if (it != entries_.end()) {
+                bytes_ -= it->second.size;
+                lru_.erase(it->second.pos);
+            }
+            lru_.push_front(name);
+            entries_[name] = { size, lru_.begin() };
+            bytes_ += size;
+            evict();
+        }
+
+        size_t size() const { return entries_.size(); }
+        uintmax_t bytes() const { return bytes_; }
+
+    private:
+        struct Entry {
+            uintmax_t size;
+            std::list<std::string>::iterator pos;
+        };
+
+        static std::string file_name(const std::string& key) {
+            uint64_t h = 1469598103934665603ULL; // FNV-1a
+            for (unsigned char c : key) {
+                h ^= c;
+                h *= 1099511628211ULL;
+            }
+            std::ostringstream name;
+            name << std::hex << std::setw(16) << std::setfill('0') << h;
+            return name.str();
+        }
+
+        std::string path_of(const std::string& name) const {
+            return (std::filesystem::path(dir_) / (name + ".fpr")).string();
+        }
+
+        void evict() {
+            std::error_code ec;
+            while (bytes_ > max_bytes_ && lru_.size() > 1) {
+                std::string victim = lru_.back();
+                lru_.pop_back();
+                bytes_ -= entries_[victim].size;
+                entries_.erase(victim);
+                std::filesystem::remove(path_of(victim), ec);
+            }
+        }
+
+        template <typename T>
+        static void put_raw(std::ostream& out, T v) { out.write(reinterpret_cast<const char*>(&v), sizeof(T)); }
+        template <typename T>
+        static bool get_raw(std::istream& in, T& v) { return (bool)in.read(reinterpret_cast<char*>(&v), sizeof(T)); }
+
+        static constexpr uint32_t kVersion = 1;
+
+        static void write(std::ostream& out, const std::string& key, const std::vector<RectangularPattern>& patterns,
+                          const std::vector<int>& supports) {
+            out.write("FPRC", 4);
+            put_raw<uint32_t>(out, kVersion);
+            put_raw<uint32_t>(out, (uint32_t)key.size());
+            out.write(key.data(), key.size());
+            put_raw<uint32_t>(out, (uint32_t)patterns.size());
+            for (size_t i = 0; i < patterns.size(); ++i) {
+                const auto& P = patterns[i];
+                put_raw<double>(out, P.size.a);
+                put_raw<double>(out, P.size.b);
+                put_raw<int32_t>(out, i < supports.size() ? supports[i] : -1);
+                put_raw<uint32_t>(out, (uint32_t)P.O_P.size());
+                for (const auto& o : P.O_P) {
+                    put_raw<int32_t>(out, o.id);
+                    put_raw<double>(out, o.x);
+                    put_raw<double>(out, o.y);
+                    put_raw<int32_t>(out, o.keyword);
+                }
+            }
+        }
+
+        static bool read(std::istream& in, const std::string& key, CachedResult& out) {
+            char magic[4];
+            uint32_t version = 0, key_len = 0, count = 0;
+            if (!in.read(magic, 4) || std::string(magic, 4) != "FPRC") return false;
+            if (!get_raw(in, version) || version != kVersion || !get_raw(in, key_len)) return false;
+            std::string stored(key_len, '\0');
+            if (!in.read(&stored[0], key_len) || stored != key || !get_raw(in, count)) return false;
+
+            CachedResult result;
+            bool has_supports = true;
+            for (uint32_t i = 0; i < count; ++i) {
+                double a, b;
+                int32_t support;
+                uint32_t n;
+                if (!get_raw(in, a) || !get_raw(in, b) || !get_raw(in, support) || !get_raw(in, n)) return false;
+                RectangularPattern P(a, b);
+                P.O_P.resize(n);
+                for (auto& o : P.O_P) {
+                    int32_t id, kw;
+                    if (!get_raw(in, id) || !get_raw(in, o.x) || !get_raw(in, o.y) || !get_raw(in, kw)) return false;
+                    o.id = id;
+                    o.keyword = kw;
+                }
+                result.patterns.push_back(std::move(P));
+                result.supports.push_back(support);
+                has_supports = has_supports && support >= 0;
+            }
+            if (!has_supports) result.supports.clear();
+            out = std::move(result);
+            return true;
+        }
+
+        std::string dir_;
+        uintmax_t max_bytes_;
+        uintmax_t bytes_ = 0;
+        std::list<std::string> lru_; // most recent first
+        std::unordered_map<std::string, Entry> entries_;
+        std::mutex mutex_;
+    };
+}
+
+#endif // RESULT_CACHE_HPP
@@ -0,0 +1,246 @@
+#ifndef SAMPLING_HPP
+#define SAMPLING_HPP
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+#include "support.hpp"
+#include "options.hpp"
+#include "parallel.hpp"
+#include "fspm+.hpp"
+
+namespace fspm_plus {
+
+    /**
+     * @brief Exact supports of tree-engine representatives over the candidates C.
+     * A candidate counts for pattern P when it has P's type key and its RDV lies within
+     * 2 * epsilon of P's (the TreeGrouper criterion); the support is the minimum over
+     * slots of the distinct ids seen there. Patterns must be canonical.
+     * @param multiplicity If set, per pattern: entry j counts the (slot, object) pairs
+     *                     seen in exactly j matching candidates
+     */
+    inline std::vector<int> exact_supports(const std::vector<RectangularPattern>& patterns, std::vector<Instance> C,
+                                           double epsilon, int threads, std::vector<std::vector<int>>* multiplicity = nullptr) {
+        parallel_for(C.size(), threads, [&](size_t c) { canonical_sort(C[c].O_P); });
+        // Buckets by type key, each sorted by the second RDV coordinate for a window scan
+        std::unordered_map<TypeKey, std::vector<std::pair<double, size_t>>, TypeKeyHash> bucket;
+        std::vector<RDV> rdv(C.size());
+        for (size_t c = 0; c < C.size(); ++c) {
+            rdv[c] = make_rdv(C[c].O_P);
+            bucket[type_key(C[c].O_P)].push_back({ rdv[c].size() > 1 ? rdv[c][1] : 0.0, c });
+        }
+        for (auto& kv : bucket) std::sort(kv.second.begin(), kv.second.end());
+
+        double radius = 2.0 * epsilon;
+        std::vector<int> supports(patterns.size(), 0);
+        if (multiplicity) multiplicity->assign(patterns.size(), std::vector<int>());
+        parallel_for(patterns.size(), threads, [&](size_t p) {
+            const auto& objs = patterns[p].O_P;
+            auto it = bucket.find(type_key(objs));
+            if (it == bucket.end()) return;
+            RDV center = make_rdv(objs);
+            double key = center.size() > 1 ? center[1] : 0.0;
+            const auto& list = it->second;
+            auto lo = std::lower_bound(list.begin(), list.end(), std::make_pair(key - radius, (size_t)0));
+            PatternSupport F(objs.size());
+            std::vector<std::unordered_map<int, int>> seen(multiplicity ? objs.size() : 0);
+            for (; lo != list.end() && lo->first <= key + radius; ++lo) {
+                size_t c = lo->second;
+                if (chebyshev_dist(rdv[c], center) > radius) continue;
+                for (size_t i = 0; i < C[c].O_P.size(); ++i) F.insert(i, C[c].O_P[i].id);
+                for (size_t i = 0; i < seen.size(); ++i) seen[i][C[c].O_P[i].id]++;
+            }
+            supports[p] = F.min_support();
+            if (multiplicity) {
+                std::vector<int>& hist = (*multiplicity)[p];
+                for (const auto& slot : seen) {
+                    for (const auto& kv : slot) {
+                        if ((size_t)kv.second >= hist.size()) hist.resize(kv.second + 1, 0);
+                        hist[kv.second]++;
+                    }
+                }
+            }
+        });
+        return supports;
+    }
+
+    // Probability that a slot object of a pattern is seen on the sample, with the range
+    // its likelihood interval allows
+    struct SlotSurvival {
+        double estimate, low, high;
+    };
+
+    /**
+     * @brief Survival of a pattern's distinct slot objects on a Bernoulli sample, fitted
+     * to their multiplicities there.
+     * A support counts distinct objects per slot, and a slot object o is seen iff o is
+     * sampled (rate) and one of the k instances holding it keeps its other n - 1 objects
+     * (p0 = rate^(n-1) each). Survival therefore lies between rate^n (k = 1) and rate
+     * (k large). k is taken geometric on {1, 2, ..}, P(k) = (1 - t) t^(k-1); the number
+     * of sampled instances holding a seen object is then, with u = 1 - p0,
+     * c = 1 - t u and r = t p0 / c, distributed as
+     *     P(j | j >= 1) = (u r^j + p0 r^(j-1)) (1 - t) / c / (1 - P0),   P0 = (1 - t) u / c,
+     * and survival is rate (1 - P0). t is fitted by maximum likelihood to hist (see
+     * exact_supports) on a grid, and [low, high] is the survival over the t whose log
+     * likelihood is within z^2 / 2 of the maximum.
+     */
+    inline SlotSurvival slot_survival(const std::vector<int>& hist, double rate, int n, double z) {
+        double p0 = std::pow(rate, n - 1);
+        double u = 1.0 - p0;
+        auto survival = [&](double t) { return rate * (1.0 - (1.0 - t) * u / (1.0 - t * u)); };
+        auto log_likelihood = [&](double t) {
+            double c = 1.0 - t * u;
+            double r = t * p0 / c;
+            double zero = (1.0 - t) * u / c;
+            double L = 0.0;
+            for (size_t j = 1; j < hist.size(); ++j) {
+                if (!hist[j]) continue;
+                double pj = (u * std::pow(r, (double)j) + p0 * std::pow(r, (double)j - 1.0)) * (1.0 - t) / c / (1.0 - zero);
+                L += hist[j] * std::log(std::max(pj, 1e-300));
+            }
+            return L;
+        };
+        const int steps = 1000;
+        std::vector<double> L(steps);
+        int best = 0;
+        for (int i = 0; i < steps; ++i) {
+            L[i] = log_likelihood((i + 0.5) / steps);
+            if (L[i] > L[best]) best = i;
+        }
+        int lo = best, hi = best;
+        while (lo > 0 && L[lo - 1] >= L[best] - z * z / 2.0) lo--;
+        while (hi + 1 < steps && L[hi + 1] >= L[best] - z * z / 2.0) hi++;
+        return { survival((best + 0.5) / steps), survival((lo + 0.5) / steps), survival((hi + 0.5) / steps) };
+    }
+
+    /**
+     * @brief Approximate mining on a Bernoulli sample of the objects.
+     *
+     * The sample is the mask MiningOptions::in_sample (rate opt.sample_rate), applied
+     * during pruning and extraction, so no data is copied. A support counts distinct
+     * objects per slot, and a slot object survives with a probability between rate^n
+     * (it lies in one instance) and rate (in many), so the support X observed on the
+     * sample is scaled by the survival slot_survival fits to the pattern's slot object
+     * multiplicities in the sample: the estimate is X / s, with the interval
+     * (X - z sqrt(X (1 - s))) / s_high .. (X + z sqrt(X (1 - s))) / s_low (normal
+     * approximation of the seen count, widened by the fit's likelihood interval).
+     *
+     * The sample is mined with the tree engine at the threshold
+     * max(1, q min_freq - z sqrt(q min_freq (1 - q))) with q = rate^n, the lowest
+     * survival, so a pattern at min_freq is only lost to the threshold when its count
+     * falls z standard deviations short under every survival: `z` is the accuracy knob,
+     * a larger z keeps more borderline patterns (recall) at the cost of more work, a
+     * lower rate gives fewer candidates (speed) and wider intervals.
+     *
+     * Without verification the patterns whose interval reaches min_freq are returned with
+     * their scaled estimates. verify = true (opt-in) recounts the surviving patterns
+     * exactly against the full candidate set (exact_supports) and returns only those
+     * with support >= min_freq, so every reported support is exact; patterns missed by
+     * the sample stay missed. Instances of a pattern can lie anywhere in D, not only near
+     * the sampled ones, so this needs the full candidate generation: it costs more than
+     * the candidate stage of an exact run and only saves its grouping.
+     * Results are by support descending; supports and intervals go to opt.report.
+     */
+    inline std::vector<RectangularPattern> sampled_mining(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq,
+                                                          const MiningOptions& opt, double z = 2.0, bool verify = false) {
+        int threads = resolve_threads(opt.num_threads);
+        int n = 0;
+        for (const auto& kv : S.K) n += kv.second;
+        double rate = std::min(std::max(opt.sample_rate, 0.0), 1.0);
+        double q = std::pow(rate, n);
+        if (q <= 0.0) {
+            std::cerr << "Error: sample rate " << opt.sample_rate << " leaves no instances" << std::endl;
+            return {};
+        }
+        double expected = q * min_freq;
+        int threshold = std::max(1, (int)std::floor(expected - z * std::sqrt(expected * (1.0 - q))));
+
+        MiningOptions inner = opt;
+        inner.verbose = false;
+        inner.output_path.clear();
+        MiningReport sample_report;
+        inner.report = &sample_report;
+        std::vector<Instance> C = generate_candidates(D, S, inner);
+        std::vector<RectangularPattern> R = tree_optimized_fspm(C, S, epsilon, threshold, inner);
+
+        std::vector<int> supports(R.size());
+        std::vector<double> ci_low(R.size()), ci_high(R.size());
+        if (rate >= 1.0) {
+            supports = sample_report.supports;
+            ci_low.assign(supports.begin(), supports.end());
+            ci_high.assign(supports.begin(), supports.end());
+        } else if (!verify) {
+            std::vector<std::vector<int>> multiplicity;
+            std::vector<int> seen = exact_supports(R, std::move(C), epsilon, threads, &multiplicity);
+            for (size_t i = 0; i < R.size(); ++i) {
+                SlotSurvival s = slot_survival(multiplicity[i], rate, n, z);
+                double x = seen[i];
+                double spread = z * std::sqrt(x * (1.0 - s.estimate));
+                supports[i] = (int)std::lround(x / s.estimate);
+                ci_low[i] = std::max((x - spread) / s.high, 0.0);
+                ci_high[i] = (x + spread) / s.low;
+            }
+        }
+        if (opt.verbose) {
+            std::cout << "[Sampling] rate " << rate << ", lowest slot survival " << q << ", sample threshold " << threshold
+                      << ": " << R.size() << " candidate patterns." << std::endl;
+        }
+
+        if (verify && !R.empty()) {
+            MiningOptions full = opt;
+            full.sample_rate = 1.0;
+            full.verbose = false;
+            std::vector<int> exact = exact_supports(R, generate_candidates(D, S, full), epsilon, threads);
+            std::vector<size_t> order;
+            for (size_t i = 0; i < R.size(); ++i) {
+                if (exact[i] >= min_freq) order.push_back(i);
+            }
+            std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return exact[x] > exact[y]; });
+            std::vector<RectangularPattern> verified;
+            std::vector<int> verified_supports;
+            for (size_t i : order) {
+                verified.push_back(std::move(R[i]));
+                verified_supports.push_back(exact[i]);
+            }
+            if (opt.verbose) std::cout << "[Sampling] " << verified.size() << "/" << R.size() << " patterns verified on the full dataset." << std::endl;
+            R.swap(verified);
+            supports.swap(verified_supports);
+            ci_low.assign(supports.begin(), supports.end());
+            ci_high.assign(supports.begin(), supports.end());
+        } else {
+            std::vector<size_t> order;
+            for (size_t i = 0; i < R.size(); ++i) {
+                if (ci_high[i] >= min_freq) order.push_back(i);
+            }
+            std::stable_sort(order.begin(), order.end(), [&](size_t x, size_t y) { return supports[x] > supports[y]; });
+            std::vector<RectangularPattern> kept;
+            std::vector<int> kept_supports;
+            std::vector<double> lo, hi;
+            for (size_t i : order) {
+                kept.push_back(std::move(R[i]));
+                kept_supports.push_back(supports[i]);
+                lo.push_back(ci_low[i]);
+                hi.push_back(ci_high[i]);
+            }
+            R.swap(kept);
+            supports.swap(kept_supports);
+            ci_low.swap(lo);
+            ci_high.swap(hi);
+        }
+
+        if (opt.report) {
+            opt.report->supports = supports;
+            opt.report->ci_low = ci_low;
+            opt.report->ci_high = ci_high;
+            opt.report->support_error = sample_report.support_error;
+            opt.report->recounted = sample_report.recounted;
+        }
+        return R;
+    }
+}
+
+#endif // SAMPLING_HPP
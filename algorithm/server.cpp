@@ -0,0 +1,348 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cstring>
+#include <cstdlib>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+#include "fspm+.hpp"
+#include "spatial_index.hpp"
+#include "parallel.hpp"
+#include "result_cache.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FSPM_SERVER_SOCKET 1
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <signal.h>
+#include <thread>
+#endif
+
+using namespace std;
+
+/*
+ * Resident mining server: datasets are loaded (and indexed) once, queries are
+ * answered from memory on a shared thread pool.
+ *
+ *   server [--socket PATH] [--threads N] [--cache DIR [--cache-mb N]] [name=]dataset.csv ...
+ *
+ * With --cache, results persist in a ResultCache and repeated queries skip the engines.
+ * Without --socket the protocol runs over stdin/stdout; engine logs go to stderr.
+ * One request per line:
+ *
+ *   LOAD <name> <path>
+ *   DATASETS
+ *   QUERY <qid> <dataset> <algo> <epsilon> <min_freq> [box=x0,y0,x1,y1] <sketch>
+ *   QUIT
+ *
+ * <algo>: fspm+ | fspm+uf | signature | signaturex | tree | topk:<k>
+ * <sketch>: RectangularSketch::toString() form, e.g. "1 1 3 6 1 327 1 313 1"
+ *
+ * Replies (lines of concurrent queries may interleave, qid tells them apart):
+ *   PATTERN <qid> <support> <a> <b> <n> <id> <x> <y> <kw> ...
+ *   DONE <qid> <patterns> <seconds>
+ *   OK ... | ERR [<qid>] <message>
+ */
+
+// A loaded dataset with its index and the candidates of the sketches mined so far
+struct Dataset {
+    Spatial db;
+    uint64_t fingerprint = 0;
+    unique_ptr<GridIndex> index;
+    mutex cache_mutex;
+    unordered_map<string, shared_ptr<const vector<Instance>>> candidates;
+};
+
+class MiningServer {
+public:
+    explicit MiningServer(int threads, fspm_plus::ResultCache* results = nullptr) : results_(results), pool_(threads) {}
+
+    bool load(const string& name, const string& path, string& message) {
+        auto ds = make_shared<Dataset>();
+        if (!ds->db.load(path)) {
+            message = "cannot load " + path;
+            return false;
+        }
+        ds->fingerprint = ds->db.fingerprint();
+        ds->index.reset(new GridIndex(ds->db));
+        lock_guard<mutex> lock(datasets_mutex_);
+        datasets_[name] = ds;
+        message = "loaded " + name + " " + to_string(ds->db.objects.size()) + " objects";
+        return true;
+    }
+
+    // Handle one request line; replies go through send (thread-safe). Returns false on QUIT.
+    bool handle(const string& line, const shared_ptr<function<void(const string&)>>& send) {
+        istringstream in(line);
+        string cmd;
+        if (!(in >> cmd)) return true;
+
+        if (cmd == "QUIT") return false;
+        if (cmd == "LOAD") {
+            string name, path, message;
+            if (!(in >> name >> path)) {
+                (*send)("ERR usage: LOAD <name> <path>");
+                return true;
+            }
+            bool ok = load(name, path, message);
+            (*send)((ok ? "OK " : "ERR ") + message);
+        } else if (cmd == "DATASETS") {
+            lock_guard<mutex> lock(datasets_mutex_);
+            string reply = "OK";
+            for (const auto& kv : datasets_) reply += " " + kv.first + ":" + to_string(kv.second->db.objects.size());
+            (*send)(reply);
+        } else if (cmd == "QUERY") {
+            query(in, send);
+        } else {
+            (*send)("ERR unknown command " + cmd);
+        }
+        return true;
+    }
+
+private:
+    void query(istringstream& in, const shared_ptr<function<void(const string&)>>& send) {
+        string qid, name, algo;
+        double epsilon = 0.0;
+        int min_freq = 0;
+        if (!(in >> qid >> name >> algo >> epsilon >> min_freq)) {
+            (*send)("ERR usage: QUERY <qid> <dataset> <algo> <epsilon> <min_freq> [box=x0,y0,x1,y1] <sketch>");
+            return;
+        }
+
+        string rest;
+        getline(in, rest);
+        bool has_box = false;
+        RectangularRegion box;
+        istringstream tail(rest);
+        string first;
+        tail >> first;
+        if (first.compare(0, 4, "box=") == 0) {
+            char c1, c2, c3;
+            istringstream b(first.substr(4));
+            if (!(b >> box.x_min >> c1 >> box.y_min >> c2 >> box.x_max >> c3 >> box.y_max)) {
+                (*send)("ERR " + qid + " bad box");
+                return;
+            }
+            has_box = true;
+            getline(tail, rest);
+        }
+        if (algo != "fspm+" && algo != "fspm+uf" && algo != "signature" && algo != "signaturex" && algo != "tree" &&
+            !(algo.compare(0, 5, "topk:") == 0 && atol(algo.c_str() + 5) > 0)) {
+            (*send)("ERR " + qid + " unknown algorithm " + algo);
+            return;
+        }
+        RectangularSketch S = RectangularSketch::fromString(rest);
+        if (S.K.empty()) {
+            (*send)("ERR " + qid + " bad sketch");
+            return;
+        }
+
+        shared_ptr<Dataset> ds;
+        {
+            lock_guard<mutex> lock(datasets_mutex_);
+            auto it = datasets_.find(name);
+            if (it != datasets_.end()) ds = it->second;
+        }
+        if (!ds) {
+            (*send)("ERR " + qid + " unknown dataset " + name);
+            return;
+        }
+
+        pool_.submit([=]() {
+            auto start = chrono::high_resolution_clock::now();
+            auto reply = [&](const vector<RectangularPattern>& R, const vector<int>& supports) {
+                for (size_t i = 0; i < R.size(); ++i) {
+                    ostringstream out;
+                    out << "PATTERN " << qid << " " << (i < supports.size() ? supports[i] : -1)
+                        << " " << R[i].size.a << " " << R[i].size.b << " " << R[i].O_P.size();
+                    for (const auto& o : R[i].O_P) out << " " << o.id << " " << o.x << " " << o.y << " " << o.keyword;
+                    (*send)(out.str());
+                }
+                double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+                (*send)("DONE " + qid + " " + to_string(R.size()) + " " + to_string(seconds));
+            };
+
+            string result_key;
+            if (results_) {
+                result_key = fspm_plus::ResultCache::make_key(ds->fingerprint, S, epsilon, min_freq, algo, has_box ? &box : nullptr);
+                fspm_plus::CachedResult hit;
+                if (results_->get(result_key, hit)) {
+                    reply(hit.patterns, hit.supports);
+                    return;
+                }
+            }
+
+            fspm_plus::MiningReport report;
+            fspm_plus::MiningOptions opt;
+            opt.report = &report;
+            opt.verbose = false;
+            opt.output_path.clear();
+            opt.num_threads = 1; // parallelism comes from concurrent queries
+            opt.index = ds->index.get();
+            if (has_box) opt.query_box = &box;
+
+            // Candidates depend on the sketch and box only: share them between queries
+            string key = S.toString();
+            if (has_box) key += "|" + fspm_plus::ResultCache::box_key(box);
+            shared_ptr<const vector<Instance>> C;
+            {
+                lock_guard<mutex> lock(ds->cache_mutex);
+                auto it = ds->candidates.find(key);
+                if (it != ds->candidates.end()) C = it->second;
+            }
+            if (!C) {
+                C = make_shared<const vector<Instance>>(fspm_plus::generate_candidates(ds->db, S, opt));
+                lock_guard<mutex> lock(ds->cache_mutex);
+                if (ds->candidates.size() >= 256) ds->candidates.clear();
+                ds->candidates[key] = C;
+            }
+
+            vector<RectangularPattern> R;
+            if (algo == "fspm+") {
+                R = fspm_plus::fspm_plus(*C, S, epsilon, min_freq, opt);
+            } else if (algo == "fspm+uf") {
+                opt.grouping = fspm_plus::GroupingMode::UnionFind;
+                R = fspm_plus::fspm_plus(*C, S, epsilon, min_freq, opt);
+            } else if (algo == "signature") {
+                R = fspm_plus::signature_sweep_line(*C, S, epsilon, min_freq, opt);
+            } else if (algo == "signaturex") {
+                R = fspm_plus::signature_sweep_line_x(*C, S, epsilon, min_freq, opt);
+            } else if (algo == "tree") {
+                R = fspm_plus::tree_optimized_fspm(*C, S, epsilon, min_freq, opt);
+            } else { // topk:<k>
+                size_t k = (size_t)atol(algo.c_str() + 5);
+                R = fspm_plus::tree_optimized_topk(*C, S, epsilon, k, min_freq, opt);
+            }
+
+            if (results_) results_->put(result_key, R, report.supports);
+            reply(R, report.supports);
+        });
+    }
+
+    fspm_plus::ResultCache* results_;
+    mutex datasets_mutex_;
+    map<string, shared_ptr<Dataset>> datasets_;
+    fspm_plus::ThreadPool pool_; // last member: joined (after draining) before the rest is destroyed
+};
+
+#ifdef FSPM_SERVER_SOCKET
+// Serve one client connection until QUIT or EOF
+void serve_connection(MiningServer& server, int fd) {
+    // Replies may still be queued after the client leaves: the fd lives as long as the sender
+    auto out_mutex = make_shared<mutex>();
+    auto fd_holder = shared_ptr<int>(new int(fd), [](int* p) { close(*p); delete p; });
+    auto send = make_shared<function<void(const string&)>>([out_mutex, fd_holder](const string& line) {
+        lock_guard<mutex> lock(*out_mutex);
+        string msg = line + "\n";
+        size_t done = 0;
+        while (done < msg.size()) {
+            ssize_t n = write(*fd_holder, msg.data() + done, msg.size() - done);
+            if (n <= 0) return;
+            done += (size_t)n;
+        }
+    });
+
+    string buffer;
+    char chunk[4096];
+    while (true) {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0) return;
+        buffer.append(chunk, (size_t)n);
+        size_t pos;
+        while ((pos = buffer.find('\n')) != string::npos) {
+            string line = buffer.substr(0, pos);
+            buffer.erase(0, pos + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!server.handle(line, send)) return;
+        }
+    }
+}
+
+int serve_socket(MiningServer& server, const string& path) {
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        cerr << "Error: Could not create socket" << endl;
+        return 1;
+    }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        cerr << "Error: Socket path too long " << path << endl;
+        return 1;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+    if (bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, 16) < 0) {
+        cerr << "Error: Could not listen on " << path << endl;
+        return 1;
+    }
+    cerr << "Listening on " << path << endl;
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) continue;
+        thread(serve_connection, ref(server), fd).detach();
+    }
+}
+#endif
+
+int main(int argc, char** argv) {
+    // Protocol owns stdout; everything the engines print goes to stderr
+    ostream proto(cout.rdbuf());
+    cout.rdbuf(cerr.rdbuf());
+    mutex out_mutex; // outlives the server, whose destructor still flushes queued replies
+
+    string socket_path;
+    int threads = 0;
+    string cache_dir;
+    uintmax_t cache_mb = 256;
+    vector<string> datasets;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) socket_path = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (arg == "--cache" && i + 1 < argc) cache_dir = argv[++i];
+        else if (arg == "--cache-mb" && i + 1 < argc) cache_mb = strtoull(argv[++i], nullptr, 10);
+        else datasets.push_back(arg);
+    }
+
+    unique_ptr<fspm_plus::ResultCache> results;
+    if (!cache_dir.empty()) results.reset(new fspm_plus::ResultCache(cache_dir, cache_mb << 20));
+    MiningServer server(threads, results.get());
+    for (const auto& spec : datasets) {
+        size_t eq = spec.find('=');
+        string path = eq == string::npos ? spec : spec.substr(eq + 1);
+        string name = eq == string::npos ? path.substr(path.find_last_of("/\\") + 1) : spec.substr(0, eq);
+        string message;
+        server.load(name, path, message);
+        cerr << message << endl;
+    }
+
+    if (!socket_path.empty()) {
+#ifdef FSPM_SERVER_SOCKET
+        signal(SIGPIPE, SIG_IGN);
+        return serve_socket(server, socket_path);
+#else
+        cerr << "Error: Unix sockets are not supported on this platform, use stdin/stdout" << endl;
+        return 1;
+#endif
+    }
+
+    auto send = make_shared<function<void(const string&)>>([&](const string& line) {
+        lock_guard<mutex> lock(out_mutex);
+        proto << line << "\n" << flush;
+    });
+    string line;
+    while (getline(cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!server.handle(line, send)) break;
+    }
+    return 0; // ~MiningServer drains queued queries before exit
+}
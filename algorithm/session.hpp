@@ -0,0 +1,535 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <iostream>
+#include <cmath>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+#include "support.hpp"
+#include "options.hpp"
+#include "parallel.hpp"
+#include "fspm+.hpp"
+
+namespace fspm_plus {
+
+    /**
+     * @brief Smallest epsilon at which p and q match (bottleneck matching distance),
+     * or -1 if they do not match within `limit`.
+     * Distances are computed exactly as getMatching compares them, so
+     * p.getMatching(q, d, ...) succeeds for every d >= the returned value.
+     */
+    inline double bottleneck_distance(const Instance& p, const Instance& q, double limit) {
+        double cx = p.size.a / 2.0;
+        double cy = p.size.b / 2.0;
+        std::vector<int> mapping;
+        if (!p.getMatching(q, limit, cx, cy, cx, cy, mapping)) return -1.0;
+
+        std::vector<double> cuts;
+        for (const auto& o1 : p.O_P) {
+            for (const auto& o2 : q.O_P) {
+                if (o1.keyword != o2.keyword) continue;
+                double dx = std::abs((o1.x - cx) - (o2.x - cx));
+                double dy = std::abs((o1.y - cy) - (o2.y - cy));
+                double d = std::max(dx, dy);
+                if (d <= limit) cuts.push_back(d);
+            }
+        }
+        std::sort(cuts.begin(), cuts.end());
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+        if (cuts.empty()) return 0.0;
+
+        // The answer is one of the pair distances; feasibility is monotone in epsilon
+        size_t lo = 0, hi = cuts.size() - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (p.getMatching(q, cuts[mid], cx, cy, cx, cy, mapping)) hi = mid;
+            else lo = mid + 1;
+        }
+        return cuts[lo];
+    }
+
+    /**
+     * @brief Keeps candidates and the epsilon-matching graph of one sketch, so that
+     * (epsilon, min_freq) parameter sweeps do not regenerate anything.
+     *
+     * Patterns are the connected components of the epsilon-matching graph (the same
+     * clusters as GroupingMode::UnionFind). Every matching pair within `max_epsilon`
+     * is stored once with its bottleneck distance, sorted by distance, so the graph
+     * at epsilon is a prefix of the edge list:
+     *  - a larger epsilon unions the next edges into the current forest (clusters merge);
+     *  - a smaller epsilon replays the shorter prefix (clusters split);
+     *  - min_freq only filters the cached cluster supports.
+     * Supports are recounted only for clusters whose membership changed. A query above
+     * max_epsilon re-enumerates the edges from the cached candidates.
+     *
+     * append() follows objects added to the dataset: only the candidates anchored in the
+     * dirty boxes are regenerated, and only the clusters they touch are rebuilt.
+     */
+    class MiningSession {
+    public:
+        MiningSession(std::vector<Instance> C, const RectangularSketch& S, double max_epsilon,
+                      const MiningOptions& opt = MiningOptions())
+            : C_(std::move(C)), S_(S), opt_(opt) {
+            build_edges(max_epsilon);
+        }
+
+        MiningSession(const Spatial& D, const RectangularSketch& S, double max_epsilon,
+                      const MiningOptions& opt = MiningOptions())
+            : MiningSession(generate_candidates(D, S, opt), S, max_epsilon, opt) {}
+
+        /**
+         * @brief Patterns frequent at (epsilon, min_freq), ordered by representative
+         * (smallest member candidate). Supports go to opt.report like the engines.
+         */
+        std::vector<RectangularPattern> query(double epsilon, int min_freq) {
+            if (epsilon > edge_limit_) {
+                build_edges(epsilon);
+            } else if (epsilon < epsilon_) {
+                reset_forest();
+            }
+            epsilon_ = epsilon;
+            while (applied_ < edges_.size() && edges_[applied_].dist <= epsilon) {
+                apply(edges_[applied_]);
+                applied_++;
+            }
+            refresh_supports();
+
+            std::vector<RectangularPattern> R;
+            if (opt_.report) {
+                opt_.report->supports.clear();
+                opt_.report->support_error = 0.0;
+                opt_.report->recounted = 0;
+            }
+            for (size_t r : roots_) {
+                if (support_[r] < min_freq) continue;
+                RectangularPattern P(S_.size.a, S_.size.b);
+                P.O_P = C_[r].O_P;
+                R.push_back(P);
+                if (opt_.report) opt_.report->supports.push_back(support_[r]);
+            }
+            return R;
+        }
+
+        /**
+         * @brief Follow objects appended to the dataset (D after Spatial::append, `added` as
+         * returned by it). Candidates anchored in dirty_boxes(added), as grown by
+         * generate_candidates_in, are dropped (found through their anchor cells) and
+         * regenerated, the new ones are matched against their neighbouring blocks only, and
+         * the forest is rebuilt just for the clusters that lost or gained members, from the
+         * edges of those members; every other cluster keeps its support. Of the copies of
+         * one instance the canonical one is kept, as generate_candidates keeps it.
+         * @return Number of regenerated candidates
+         */
+        size_t append(const Spatial& D, const std::vector<SpatialObject>& added) {
+            if (added.empty()) return 0;
+            double a = S_.size.a;
+            double b = S_.size.b;
+            if (!indexed_) {
+                for (size_t i = 0; i < C_.size(); ++i) {
+                    if (!alive_[i]) continue;
+                    ids_.emplace(ids_of(C_[i]), i);
+                    by_cell_[anchor_cell(i)].push_back(i);
+                }
+                indexed_ = true;
+            }
+            std::vector<RectangularRegion> boxes = dirty_boxes(added, a, b);
+            MiningOptions quiet = opt_;
+            quiet.verbose = false;
+            std::vector<Instance> fresh_candidates = generate_candidates_in(D, S_, boxes, quiet); // grows boxes
+
+            // Retire the candidates anchored in the boxes; their clusters are rebuilt
+            std::vector<size_t> stale_roots;
+            size_t retired = 0;
+            auto retire = [&](size_t i) {
+                stale_roots.push_back(find(i));
+                alive_[i] = 0;
+                ids_.erase(ids_of(C_[i]));
+                auto& list = by_cell_[anchor_cell(i)];
+                list.erase(std::find(list.begin(), list.end(), i));
+                if (list.empty()) by_cell_.erase(anchor_cell(i));
+                retired++;
+            };
+            std::vector<size_t> dirty;
+            for (const auto& box : boxes) {
+                CellKey lo = cell_of(box.x_min, box.y_min), hi = cell_of(box.x_max, box.y_max);
+                for (long long cx = lo.first; cx <= hi.first; ++cx) {
+                    for (long long cy = lo.second; cy <= hi.second; ++cy) {
+                        auto it = by_cell_.find({ cx, cy });
+                        if (it == by_cell_.end()) continue;
+                        for (size_t i : it->second) {
+                            double x = C_[i].x - a / 2.0, y = C_[i].y - b / 2.0; // window anchor
+                            if (x >= box.x_min && x <= box.x_max && y >= box.y_min && y <= box.y_max) dirty.push_back(i);
+                        }
+                    }
+                }
+            }
+            std::sort(dirty.begin(), dirty.end());
+            dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+            for (size_t i : dirty) retire(i);
+
+            // Add the regenerated ones. A duplicate of a surviving candidate replaces it
+            // only if it is the canonical copy (anchor_before), as in dedup_candidates
+            size_t first_new = C_.size();
+            for (auto& inst : fresh_candidates) {
+                std::vector<int> ids = ids_of(inst);
+                auto it = ids_.find(ids);
+                if (it != ids_.end()) {
+                    if (!anchor_before(inst, C_[it->second])) continue;
+                    retire(it->second);
+                }
+                ids_.emplace(std::move(ids), C_.size());
+                C_.push_back(std::move(inst));
+                alive_.push_back(1);
+                by_cell_[anchor_cell(C_.size() - 1)].push_back(C_.size() - 1);
+            }
+            size_t n = C_.size();
+            parent_.resize(n);
+            links_.resize(n);
+            adj_.resize(n);
+            support_.resize(n, 0);
+            dirty_.resize(n, 1);
+            tombstones_ += retired;
+
+            // Members of the clusters that lost candidates (along the forest links) and the new ones
+            std::vector<size_t> affected;
+            std::unordered_set<size_t> seen;
+            for (size_t r : stale_roots) {
+                if (!seen.insert(r).second) continue;
+                std::vector<size_t> stack = { r };
+                while (!stack.empty()) {
+                    size_t u = stack.back();
+                    stack.pop_back();
+                    affected.push_back(u);
+                    for (const Link& l : links_[u]) {
+                        if (seen.insert(l.to).second) stack.push_back(l.to);
+                    }
+                }
+            }
+            for (size_t i = first_new; i < n; ++i) affected.push_back(i);
+            for (size_t i : affected) {
+                parent_[i] = i;
+                links_[i].clear();
+                if (!alive_[i]) adj_[i].clear(); // edges to it elsewhere are skipped as dead
+            }
+
+            // Edges of the new candidates
+            std::vector<Edge> fresh = match_new(first_new, edge_limit_);
+            for (const Edge& e : fresh) {
+                adj_[e.u].push_back(e);
+                adj_[e.v].push_back(e);
+            }
+            size_t old_edges = edges_.size();
+            edges_.insert(edges_.end(), fresh.begin(), fresh.end());
+            std::inplace_merge(edges_.begin(), edges_.begin() + old_edges, edges_.end());
+
+            // Forest: replay the applied edges of the affected members, in edge order
+            std::vector<Edge> replay;
+            for (size_t i : affected) {
+                if (!alive_[i]) continue;
+                for (const Edge& e : adj_[i]) {
+                    if (e.dist <= epsilon_ && alive_[e.u] && alive_[e.v]) replay.push_back(e);
+                }
+            }
+            std::sort(replay.begin(), replay.end());
+            replay.erase(std::unique(replay.begin(), replay.end(), [](const Edge& p, const Edge& q) { return p.u == q.u && p.v == q.v; }), replay.end());
+            for (const Edge& e : replay) apply(e);
+            for (size_t i : affected) {
+                if (alive_[i]) dirty_[find(i)] = 1;
+            }
+            applied_ = applied_end();
+            if (opt_.verbose) {
+                std::cout << "[Session] Appended " << added.size() << " objects: " << boxes.size() << " dirty boxes, "
+                          << retired << " candidates retired, " << (n - first_new) << " added, " << fresh.size() << " new pairs." << std::endl;
+            }
+            if (tombstones_ > n - tombstones_) compact();
+            return n - first_new;
+        }
+
+        // Candidates, with the ones retired by append() kept as tombstones until they
+        // outnumber the others; compaction then drops them (indices keep their order)
+        const std::vector<Instance>& candidates() const { return C_; }
+        bool retired(size_t i) const { return i < alive_.size() && !alive_[i]; }
+        size_t edge_count() const { return edges_.size(); }
+        size_t cluster_count() const { return roots_.size(); }
+
+    private:
+        struct Edge {
+            double dist;
+            size_t u, v; // u < v
+            bool operator<(const Edge& o) const {
+                if (dist != o.dist) return dist < o.dist;
+                if (u != o.u) return u < o.u;
+                return v < o.v;
+            }
+        };
+
+        // Forest edge u -> v with the slot mapping C[u].O_P[s] -> C[v].O_P[map[s]]
+        struct Link {
+            size_t to;
+            std::vector<int> map;
+        };
+
+        struct IdsHash {
+            size_t operator()(const std::vector<int>& ids) const {
+                uint64_t h = 1469598103934665603ULL;
+                for (int id : ids) h = (h ^ (uint32_t)id) * 1099511628211ULL;
+                return (size_t)h;
+            }
+        };
+
+        using CellKey = std::pair<long long, long long>;
+        struct CellHash {
+            size_t operator()(const CellKey& c) const { return (size_t)((uint64_t)c.first * 0x9E3779B97F4A7C15ULL ^ (uint64_t)c.second); }
+        };
+
+        CellKey cell_of(double x, double y) const {
+            return { (long long)std::floor(x / S_.size.a), (long long)std::floor(y / S_.size.b) };
+        }
+
+        // a x b cell of a candidate's window anchor
+        CellKey anchor_cell(size_t i) const {
+            return cell_of(C_[i].x - S_.size.a / 2.0, C_[i].y - S_.size.b / 2.0);
+        }
+
+        static std::vector<int> ids_of(const Instance& c) {
+            std::vector<int> ids;
+            for (const auto& o : c.O_P) ids.push_back(o.id);
+            return ids;
+        }
+
+        // Enumerate all matching pairs within limit (blocking as in union_find_grouping)
+        void build_edges(double limit) {
+            edge_limit_ = limit;
+            alive_.resize(C_.size(), 1);
+            edges_ = match_new(0, limit);
+            adj_.assign(C_.size(), {});
+            for (const Edge& e : edges_) {
+                adj_[e.u].push_back(e);
+                adj_[e.v].push_back(e);
+            }
+            if (opt_.verbose) std::cout << "[Session] " << C_.size() << " candidates, " << edges_.size()
+                      << " matching pairs within epsilon " << limit << "." << std::endl;
+            reset_forest();
+        }
+
+        // Index C_[first, end) in the match blocks of cell `limit` (blocking as in union_find_grouping)
+        void index_blocks(size_t first, double limit) {
+            double cell = std::max(limit, 1e-9);
+            if (first == 0) {
+                shard_of_.clear();
+                blocks_.clear();
+            }
+            block_of_.resize(C_.size());
+            for (size_t i = first; i < C_.size(); ++i) {
+                TypeKey key = type_key(C_[i].O_P);
+                std::sort(key.begin(), key.end());
+                size_t shard = shard_of_.emplace(key, shard_of_.size()).first->second;
+                double cx = 0.0, cy = 0.0;
+                for (const auto& o : C_[i].O_P) { cx += o.x; cy += o.y; }
+                if (!C_[i].O_P.empty()) { cx /= C_[i].O_P.size(); cy /= C_[i].O_P.size(); }
+                block_of_[i] = { shard, (long long)std::floor(cx / cell), (long long)std::floor(cy / cell) };
+                if (alive_[i]) blocks_[block_of_[i]].push_back(i);
+            }
+        }
+
+        // Matching pairs within limit with at least one endpoint in C_[first, end), sorted.
+        // Each pair is found from its larger new endpoint; blocks hold ascending indices.
+        std::vector<Edge> match_new(size_t first, double limit) {
+            index_blocks(first, limit);
+            std::vector<std::vector<Edge>> found(C_.size() - first);
+            parallel_for(C_.size() - first, resolve_threads(opt_.num_threads), [&](size_t k) {
+                size_t i = first + k;
+                if (!alive_[i]) return;
+                const MatchBlock& home = block_of_[i];
+                for (long long dx = -1; dx <= 1; ++dx) {
+                    for (long long dy = -1; dy <= 1; ++dy) {
+                        auto it = blocks_.find({ home.shard, home.cx + dx, home.cy + dy });
+                        if (it == blocks_.end()) continue;
+                        for (size_t j : it->second) {
+                            if (j >= i) break;
+                            if (!alive_[j]) continue;
+                            double d = bottleneck_distance(C_[j], C_[i], limit);
+                            if (d >= 0) found[k].push_back({ d, j, i });
+                        }
+                    }
+                }
+            });
+
+            std::vector<Edge> edges;
+            for (auto& list : found) edges.insert(edges.end(), list.begin(), list.end());
+            std::sort(edges.begin(), edges.end());
+            return edges;
+        }
+
+        void reset_forest() {
+            parent_.resize(C_.size());
+            for (size_t i = 0; i < C_.size(); ++i) parent_[i] = i;
+            links_.assign(C_.size(), {});
+            support_.assign(C_.size(), 0);
+            dirty_.assign(C_.size(), 1);
+            applied_ = 0;
+            epsilon_ = -1.0; // nothing applied
+        }
+
+        // End of the edges within epsilon_, all of which are in the forest
+        size_t applied_end() const {
+            return std::partition_point(edges_.begin(), edges_.end(), [&](const Edge& e) { return e.dist <= epsilon_; }) - edges_.begin();
+        }
+
+        // Drop the retired candidates and every edge or index entry naming them. The
+        // renumbering keeps the order, so roots (smallest members) and edge order survive.
+        void compact() {
+            const size_t gone = (size_t)-1;
+            std::vector<size_t> renumber(C_.size(), gone);
+            size_t m = 0;
+            for (size_t i = 0; i < C_.size(); ++i) {
+                if (alive_[i]) renumber[i] = m++;
+            }
+            auto keep_edges = [&](std::vector<Edge>& list) {
+                size_t k = 0;
+                for (const Edge& e : list) {
+                    if (renumber[e.u] == gone || renumber[e.v] == gone) continue;
+                    list[k++] = { e.dist, renumber[e.u], renumber[e.v] };
+                }
+                list.resize(k);
+            };
+            auto keep_ids = [&](std::vector<size_t>& list) {
+                size_t k = 0;
+                for (size_t i : list) {
+                    if (renumber[i] != gone) list[k++] = renumber[i];
+                }
+                list.resize(k);
+            };
+            for (size_t i = 0; i < C_.size(); ++i) {
+                size_t j = renumber[i];
+                if (j == gone) continue;
+                if (j != i) {
+                    C_[j] = std::move(C_[i]);
+                    links_[j] = std::move(links_[i]);
+                    adj_[j] = std::move(adj_[i]);
+                    support_[j] = support_[i];
+                    dirty_[j] = dirty_[i];
+                    block_of_[j] = block_of_[i];
+                }
+                parent_[j] = renumber[parent_[i]];
+                for (Link& l : links_[j]) l.to = renumber[l.to];
+                keep_edges(adj_[j]);
+            }
+            C_.resize(m);
+            parent_.resize(m);
+            links_.resize(m);
+            adj_.resize(m);
+            support_.resize(m);
+            dirty_.resize(m);
+            block_of_.resize(m);
+            alive_.assign(m, 1);
+            keep_edges(edges_);
+            keep_ids(roots_);
+            for (auto it = blocks_.begin(); it != blocks_.end();) {
+                keep_ids(it->second);
+                it = it->second.empty() ? blocks_.erase(it) : std::next(it);
+            }
+            for (auto& kv : ids_) kv.second = renumber[kv.second];
+            for (auto& kv : by_cell_) keep_ids(kv.second);
+            applied_ = applied_end();
+            tombstones_ = 0;
+        }
+
+        size_t find(size_t x) {
+            while (parent_[x] != x) {
+                parent_[x] = parent_[parent_[x]];
+                x = parent_[x];
+            }
+            return x;
+        }
+
+        void apply(const Edge& e) {
+            if (!alive_[e.u] || !alive_[e.v]) return; // retired by append(), awaiting compact()
+            size_t x = find(e.u);
+            size_t y = find(e.v);
+            if (x == y) return;
+            if (x > y) std::swap(x, y);
+            parent_[y] = x; // root stays the smallest member
+            dirty_[x] = 1;
+
+            double cx = S_.size.a / 2.0;
+            double cy = S_.size.b / 2.0;
+            std::vector<int> fwd;
+            C_[e.u].getMatching(C_[e.v], e.dist, cx, cy, cx, cy, fwd);
+            std::vector<int> back(fwd.size());
+            for (size_t s = 0; s < fwd.size(); ++s) back[fwd[s]] = (int)s;
+            links_[e.u].push_back({ e.v, std::move(fwd) });
+            links_[e.v].push_back({ e.u, std::move(back) });
+        }
+
+        // Recount the supports of clusters that changed since the last query
+        void refresh_supports() {
+            roots_.clear();
+            std::vector<size_t> stale;
+            for (size_t i = 0; i < C_.size(); ++i) {
+                if (!alive_[i] || find(i) != i) continue;
+                roots_.push_back(i);
+                if (dirty_[i]) stale.push_back(i);
+            }
+
+            parallel_for(stale.size(), resolve_threads(opt_.num_threads), [&](size_t k) {
+                size_t root = stale[k];
+                size_t n = C_[root].O_P.size();
+                PatternSupport F_set(n);
+
+                // Walk the spanning tree from the root composing slot mappings
+                std::vector<std::pair<size_t, std::vector<int>>> stack;
+                std::vector<int> identity(n);
+                for (size_t s = 0; s < n; ++s) identity[s] = (int)s;
+                stack.push_back({ root, identity });
+                std::unordered_map<size_t, size_t> came_from = { { root, root } };
+                while (!stack.empty()) {
+                    auto [u, slot_of] = std::move(stack.back());
+                    stack.pop_back();
+                    for (size_t s = 0; s < n; ++s) F_set.insert(s, C_[u].O_P[slot_of[s]].id);
+                    for (const Link& l : links_[u]) {
+                        if (!came_from.emplace(l.to, u).second) continue;
+                        std::vector<int> next(n);
+                        for (size_t s = 0; s < n; ++s) next[s] = l.map[slot_of[s]];
+                        stack.push_back({ l.to, std::move(next) });
+                    }
+                }
+                support_[root] = F_set.min_support();
+                dirty_[root] = 0;
+            });
+        }
+
+        std::vector<Instance> C_;
+        RectangularSketch S_;
+        MiningOptions opt_;
+
+        std::vector<Edge> edges_;     // matching pairs within edge_limit_, by distance
+        std::vector<std::vector<Edge>> adj_; // edges_ by endpoint
+        double edge_limit_ = 0.0;
+        size_t applied_ = 0;          // edges_[0, applied_) are in the forest
+        double epsilon_ = -1.0;
+
+        std::vector<size_t> parent_;
+        std::vector<std::vector<Link>> links_;
+        std::vector<size_t> roots_;
+        std::vector<int> support_;    // valid for roots with dirty_ == 0
+        std::vector<char> dirty_;
+
+        std::unordered_map<TypeKey, size_t, TypeKeyHash> shard_of_;
+        std::vector<MatchBlock> block_of_;
+        std::unordered_map<MatchBlock, std::vector<size_t>, MatchBlockHash> blocks_; // cell edge_limit_
+
+        std::vector<char> alive_;     // 0: retired by append()
+        size_t tombstones_ = 0;       // retired candidates still in C_
+        bool indexed_ = false;        // ids_ and by_cell_ are built by the first append()
+        std::unordered_map<std::vector<int>, size_t, IdsHash> ids_; // object ids -> alive candidate
+        std::unordered_map<CellKey, std::vector<size_t>, CellHash> by_cell_; // alive candidates by anchor cell (a x b)
+    };
+}
+
+#endif // SESSION_HPP
@@ -0,0 +1,192 @@
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+
+/**
+ * @brief 数据集上的均匀网格索引 (加载后构建一次，之后只读、可多线程共享)
+ * 每个格子保存落在其中的对象下标 (指向 D.objects)，格内按 (关键字, 下标) 排序，
+ * 因此框查询时可按关键字二分跳过无关对象。查询结果是 D.objects 中对象的指针，
+ * 不复制数据；索引生命周期内 D 不可修改。
+ */
+class GridIndex {
+public:
+    /**
+     * @param D 已加载 (按 x 排序) 的数据集
+     * @param cell 格子边长 (km)，<= 0 时按平均每格约 16 个对象自动选择
+     */
+    explicit GridIndex(const Spatial& D, double cell = 0.0) : D_(&D) {
+        const auto& objs = D.objects;
+        if (objs.empty()) return;
+
+        double w = std::max(D.x_max - D.x_min, 1e-9);
+        double h = std::max(D.y_max - D.y_min, 1e-9);
+        if (cell <= 0.0) cell = std::sqrt(w * h * 16.0 / objs.size());
+        // 限制格子总数，避免极端分布下的超大网格
+        const double max_cells = 4.0 * objs.size() + 16.0;
+        while ((w / cell + 1.0) * (h / cell + 1.0) > max_cells) cell *= 2.0;
+        cell_ = cell;
+        nx_ = (int)(w / cell_) + 1;
+        ny_ = (int)(h / cell_) + 1;
+
+        // CSR 布局：offsets_[c] .. offsets_[c + 1] 为格子 c 的对象
+        offsets_.assign((size_t)nx_ * ny_ + 1, 0);
+        std::vector<uint32_t> cell_of(objs.size());
+        for (size_t i = 0; i < objs.size(); ++i) {
+            cell_of[i] = (uint32_t)cell_id(col(objs[i].x), row(objs[i].y));
+            offsets_[cell_of[i] + 1]++;
+        }
+        for (size_t c = 1; c < offsets_.size(); ++c) offsets_[c] += offsets_[c - 1];
+        items_.resize(objs.size());
+        std::vector<uint32_t> fill(offsets_.begin(), offsets_.end() - 1);
+        for (size_t i = 0; i < objs.size(); ++i) items_[fill[cell_of[i]]++] = (uint32_t)i;
+        for (size_t c = 0; c + 1 < offsets_.size(); ++c) {
+            std::sort(items_.begin() + offsets_[c], items_.begin() + offsets_[c + 1], [&](uint32_t p, uint32_t q) {
+                if (objs[p].keyword != objs[q].keyword) return objs[p].keyword < objs[q].keyword;
+                return p < q;
+            });
+        }
+    }
+
+    /**
+     * @brief 框内 (闭区间) 的对象，K 非空时只返回 K 中的关键字
+     * @return 对象指针，按其在 D.objects 中的顺序 (即 x 升序)
+     */
+    std::vector<const SpatialObject*> query(const RectangularRegion& box, const std::unordered_map<int, int>* K = nullptr) const {
+        std::vector<uint32_t> hit;
+        const auto& objs = D_->objects;
+        if (objs.empty() || box.x_max < D_->x_min || box.x_min > D_->x_max ||
+            box.y_max < D_->y_min || box.y_min > D_->y_max) return {};
+
+        int c0 = col(box.x_min), c1 = col(box.x_max);
+        int r0 = row(box.y_min), r1 = row(box.y_max);
+        std::vector<int> keywords;
+        if (K) {
+            for (const auto& kv : *K) keywords.push_back(kv.first);
+        }
+
+        for (int cx = c0; cx <= c1; ++cx) {
+            for (int cy = r0; cy <= r1; ++cy) {
+                size_t c = cell_id(cx, cy);
+                auto first = items_.begin() + offsets_[c];
+                auto last = items_.begin() + offsets_[c + 1];
+                if (first == last) continue;
+                // 边界格子需要逐个检查坐标
+                bool inner = cx > c0 && cx < c1 && cy > r0 && cy < r1;
+                auto take = [&](std::vector<uint32_t>::const_iterator it, std::vector<uint32_t>::const_iterator end) {
+                    for (; it != end; ++it) {
+                        const SpatialObject& o = objs[*it];
+                        if (inner || (o.x >= box.x_min && o.x <= box.x_max && o.y >= box.y_min && o.y <= box.y_max)) hit.push_back(*it);
+                    }
+                };
+                if (!K) {
+                    take(first, last);
+                    continue;
+                }
+                for (int kw : keywords) {
+                    auto lo = std::lower_bound(first, last, kw, [&](uint32_t i, int k) { return objs[i].keyword < k; });
+                    auto hi = std::upper_bound(lo, last, kw, [&](int k, uint32_t i) { return k < objs[i].keyword; });
+                    take(lo, hi);
+                }
+            }
+        }
+
+        std::sort(hit.begin(), hit.end());
+        std::vector<const SpatialObject*> result;
+        result.reserve(hit.size());
+        for (uint32_t i : hit) result.push_back(&objs[i]);
+        return result;
+    }
+
+    const Spatial& data() const { return *D_; }
+    double cell() const { return cell_; }
+
+private:
+    int col(double x) const { return std::min(std::max((int)std::floor((x - D_->x_min) / cell_), 0), nx_ - 1); }
+    int row(double y) const { return std::min(std::max((int)std::floor((y - D_->y_min) / cell_), 0), ny_ - 1); }
+    size_t cell_id(int cx, int cy) const { return (size_t)cx * ny_ + cy; }
+
+    const Spatial* D_;
+    double cell_ = 1.0;
+    int nx_ = 0, ny_ = 0;
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> items_;
+};
+
+/**
+ * @brief 按密度自适应的四叉树划分 (用于并行剪枝与候选提取)
+ * 对象数超过 leaf_capacity 的节点一分为四，直到叶子核心区内的对象数不超过上限，
+ * 或节点边长小于 2a / 2b (再分时边缘带会超过核心区本身)。叶子的核心区为半开区间
+ * [x_min, x_max) x [y_min, y_max)，外侧边界为无穷，因此所有叶子恰好覆盖整个平面；
+ * 每个叶子另外保存核心区向四周扩展 a x b 边缘带后 (闭区间) 的全部对象。
+ * 叶子按 Z 序 (深度优先) 排列，相邻下标的叶子在空间上也相邻。
+ */
+class QuadTreePartition {
+public:
+    struct Leaf {
+        RectangularRegion core;
+        std::vector<const SpatialObject*> objects; // 核心区 + 边缘带内的对象，x 升序
+        size_t core_count = 0;                     // 核心区内的对象数
+    };
+
+    /**
+     * @param objs 参与划分的对象 (x 升序)
+     * @param a, b 窗口尺寸，即边缘带宽度
+     * @param leaf_capacity 叶子核心区对象数上限
+     */
+    QuadTreePartition(const std::vector<const SpatialObject*>& objs, double a, double b, size_t leaf_capacity)
+        : a_(a), b_(b), capacity_(std::max<size_t>(leaf_capacity, 1)) {
+        if (objs.empty()) return;
+        RectangularRegion box(objs.front()->x, objs.front()->y, objs.front()->x, objs.front()->y);
+        for (const SpatialObject* o : objs) {
+            box.x_min = std::min(box.x_min, o->x);
+            box.x_max = std::max(box.x_max, o->x);
+            box.y_min = std::min(box.y_min, o->y);
+            box.y_max = std::max(box.y_max, o->y);
+        }
+        const double inf = std::numeric_limits<double>::infinity();
+        split(RectangularRegion(-inf, -inf, inf, inf), box, objs, 0);
+    }
+
+    const std::vector<Leaf>& leaves() const { return leaves_; }
+
+private:
+    static bool in_core(const RectangularRegion& core, const SpatialObject* o) {
+        return o->x >= core.x_min && o->x < core.x_max && o->y >= core.y_min && o->y < core.y_max;
+    }
+
+    // core: 节点核心区 (可含无穷边界); box: 用于求中点的有限包围盒; objs: 核心区 + 边缘带内的对象
+    void split(const RectangularRegion& core, const RectangularRegion& box, const std::vector<const SpatialObject*>& objs, int depth) {
+        size_t count = 0;
+        for (const SpatialObject* o : objs) count += in_core(core, o);
+        double w = box.x_max - box.x_min, h = box.y_max - box.y_min;
+        if (count <= capacity_ || w < 2.0 * a_ || h < 2.0 * b_ || depth >= 24) {
+            if (!objs.empty()) leaves_.push_back({ core, objs, count });
+            return;
+        }
+        double xm = box.x_min + w / 2.0, ym = box.y_min + h / 2.0;
+        for (int q = 0; q < 4; ++q) {
+            bool right = q & 2, up = q & 1;
+            RectangularRegion c(right ? xm : core.x_min, up ? ym : core.y_min, right ? core.x_max : xm, up ? core.y_max : ym);
+            RectangularRegion bx(right ? xm : box.x_min, up ? ym : box.y_min, right ? box.x_max : xm, up ? box.y_max : ym);
+            std::vector<const SpatialObject*> sub;
+            for (const SpatialObject* o : objs) {
+                if (o->x >= c.x_min - a_ && o->x <= c.x_max + a_ && o->y >= c.y_min - b_ && o->y <= c.y_max + b_) sub.push_back(o);
+            }
+            split(c, bx, sub, depth + 1);
+        }
+    }
+
+    double a_, b_;
+    size_t capacity_;
+    std::vector<Leaf> leaves_;
+};
+
+#endif // SPATIAL_INDEX_HPP
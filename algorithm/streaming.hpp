@@ -0,0 +1,371 @@
+#ifndef STREAMING_HPP
+#define STREAMING_HPP
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+#include "options.hpp"
+#include "fspm+.hpp"
+
+namespace fspm_plus {
+
+    /**
+     * @brief Frequent patterns of a sliding time window over a check-in stream.
+     *
+     * A venue is an object of the window while at least one of its check-ins has
+     * time in (now - window, now]; check-ins are refcounted per venue, so repeated
+     * visits do not churn the dataset. advance(now) admits the queued check-ins up to
+     * `now`, expires the old ones, and applies only the net change of venues:
+     *  - the window dataset is updated with Spatial::remove / Spatial::append;
+     *  - the windows anchored in dirty_boxes(entered + left venues), as grown by
+     *    extract_in, are extracted again. A candidate is kept with every anchor that
+     *    produces it, so it only vanishes when its last anchor does, wherever the others lie;
+     *  - vanished candidates leave their cluster and new ones join one, so a cluster's
+     *    per-slot id counts (and its support) change by exactly those candidates.
+     * Clusters follow the tree criterion (representative within 2 epsilon, per type
+     * key) in arrival order, new candidates of one update in the order of
+     * generate_candidates. An emptied cluster keeps its representative and revives when
+     * a matching candidate returns, until emptied clusters outnumber the others: then
+     * they are dropped and the representative trees rebuilt, so memory follows the
+     * window. Supports are exact.
+     */
+    class StreamingMiner {
+    public:
+        /**
+         * @param window Window length, in the unit of CheckIn::time (seconds)
+         * @param cos_lat Longitude scale of the projection; <= 0 takes cos of the mean
+         *        latitude of the first admitted batch (then fixed, as in Spatial::append)
+         */
+        StreamingMiner(const RectangularSketch& S, double epsilon, int min_freq, double window,
+                       double cos_lat = 0.0, const MiningOptions& opt = MiningOptions())
+            : S_(S), epsilon_(epsilon), min_freq_(min_freq), window_(window), opt_(opt) {
+            D_.cos_lat = cos_lat;
+        }
+
+        StreamingMiner(const StreamingMiner&) = delete;
+        StreamingMiner& operator=(const StreamingMiner&) = delete;
+        ~StreamingMiner() {
+            for (auto& kv : trees_) delete kv.second;
+        }
+
+        /**
+         * @brief Queue a check-in. Times must not decrease.
+         * @return false (nothing queued) for an out-of-order check-in
+         */
+        bool push(const CheckIn& c) {
+            double last = !pending_.empty() ? pending_.back().time : (!active_.empty() ? active_.back().time : c.time);
+            if (c.time < last || c.time < now_) {
+                std::cerr << "Error: check-in at " << c.time << " arrives after time " << std::max(last, now_) << std::endl;
+                return false;
+            }
+            pending_.push_back(c);
+            return true;
+        }
+
+        /**
+         * @brief Move the window end to `now` (not before the previous one): admit the
+         * queued check-ins with time <= now and expire those with time <= now - window.
+         * @return Number of venues that entered or left the window
+         */
+        size_t advance(double now) {
+            if (now < now_) {
+                std::cerr << "Error: window end " << now << " is before " << now_ << std::endl;
+                return 0;
+            }
+            now_ = now;
+
+            // Refcount check-ins per venue; remember the state of every touched venue
+            std::unordered_map<int, bool> was_active;
+            std::unordered_map<int, CheckIn> latest; // position and keyword of an entering venue
+            size_t admitted = 0;
+            while (admitted < pending_.size() && pending_[admitted].time <= now) {
+                const CheckIn& c = pending_[admitted++];
+                int& n = visits_[c.id];
+                was_active.emplace(c.id, n > 0);
+                n++;
+                latest[c.id] = c;
+                active_.push_back(c);
+            }
+            pending_.erase(pending_.begin(), pending_.begin() + admitted);
+            while (!active_.empty() && active_.front().time <= now - window_) {
+                const CheckIn& c = active_.front();
+                auto it = visits_.find(c.id);
+                was_active.emplace(c.id, true);
+                if (--it->second == 0) visits_.erase(it);
+                active_.pop_front();
+            }
+
+            std::vector<int> left;
+            std::vector<SpatialObject> entered;
+            for (const auto& kv : was_active) {
+                bool now_active = visits_.count(kv.first) > 0;
+                if (kv.second && !now_active) left.push_back(kv.first);
+                if (!kv.second && now_active) {
+                    const CheckIn& c = latest[kv.first];
+                    entered.emplace_back(c.id, c.keyword, c.lat, c.lon);
+                }
+            }
+            if (left.empty() && entered.empty()) return 0;
+
+            if (D_.cos_lat <= 0.0 && !entered.empty()) {
+                double sum = 0.0;
+                for (const auto& o : entered) sum += o.y / 6371.0;
+                D_.cos_lat = std::cos(sum / entered.size());
+            }
+            std::vector<SpatialObject> changed = D_.remove(left);
+            std::vector<SpatialObject> added = D_.append(std::move(entered));
+            changed.insert(changed.end(), added.begin(), added.end());
+            update(changed);
+
+            if (opt_.verbose) {
+                std::cout << "[Stream] t=" << now << ": " << added.size() << " venues entered, " << left.size() << " left, "
+                          << D_.objects.size() << " in window, " << live_ << " candidates, " << frequent_count() << " frequent patterns." << std::endl;
+            }
+            return added.size() + left.size();
+        }
+
+        /**
+         * @brief Patterns frequent in the current window, by descending support (ties by
+         * cluster age). Supports go to opt.report like the engines.
+         */
+        std::vector<RectangularPattern> patterns() const {
+            std::vector<size_t> order;
+            for (size_t k = 0; k < clusters_.size(); ++k) {
+                if (clusters_[k].support >= min_freq_) order.push_back(k);
+            }
+            std::stable_sort(order.begin(), order.end(), [&](size_t p, size_t q) { return clusters_[p].support > clusters_[q].support; });
+            std::vector<RectangularPattern> R;
+            if (opt_.report) {
+                opt_.report->supports.clear();
+                opt_.report->support_error = 0.0;
+                opt_.report->recounted = 0;
+            }
+            for (size_t k : order) {
+                R.push_back(clusters_[k].rep);
+                if (opt_.report) opt_.report->supports.push_back(clusters_[k].support);
+            }
+            return R;
+        }
+
+        const Spatial& window() const { return D_; }
+        double now() const { return now_; }
+        size_t candidate_count() const { return live_; }
+        size_t cluster_count() const { return clusters_.size(); }
+
+        // Object ids of the live candidates (canonical order), unsorted
+        std::vector<std::vector<int>> candidate_ids() const {
+            std::vector<std::vector<int>> ids;
+            for (const auto& kv : entries_) ids.push_back(ids_of(kv.second.objs));
+            return ids;
+        }
+
+    private:
+        struct IdsHash {
+            size_t operator()(const std::vector<int>& ids) const {
+                uint64_t h = 1469598103934665603ULL;
+                for (int id : ids) h = (h ^ (uint32_t)id) * 1099511628211ULL;
+                return (size_t)h;
+            }
+        };
+
+        using Anchor = std::pair<double, double>; // window min corner
+
+        struct Entry {
+            std::vector<SpatialObject> objs; // canonical order
+            std::vector<Anchor> anchors;     // every window producing the candidate
+            int cluster;
+        };
+
+        struct Cluster {
+            RectangularPattern rep;
+            std::vector<std::unordered_map<int, int>> slots; // id -> candidates using it in that slot
+            int support = 0;
+            size_t members = 0;
+        };
+
+        using CellKey = std::pair<long long, long long>;
+        struct CellHash {
+            size_t operator()(const CellKey& c) const { return (size_t)((uint64_t)c.first * 0x9E3779B97F4A7C15ULL ^ (uint64_t)c.second); }
+        };
+
+        CellKey cell_of(double x, double y) const {
+            return { (long long)std::floor(x / S_.size.a), (long long)std::floor(y / S_.size.b) };
+        }
+
+        static std::vector<int> ids_of(const std::vector<SpatialObject>& objs) {
+            std::vector<int> ids;
+            ids.reserve(objs.size());
+            for (const auto& o : objs) ids.push_back(o.id);
+            return ids;
+        }
+
+        size_t frequent_count() const {
+            size_t n = 0;
+            for (const auto& c : clusters_) n += c.support >= min_freq_;
+            return n;
+        }
+
+        void count(Cluster& c, const std::vector<SpatialObject>& objs, int delta) {
+            for (size_t s = 0; s < objs.size(); ++s) {
+                int& n = c.slots[s][objs[s].id];
+                n += delta;
+                if (n == 0) c.slots[s].erase(objs[s].id);
+            }
+            c.support = (int)c.slots[0].size();
+            for (const auto& slot : c.slots) c.support = std::min(c.support, (int)slot.size());
+        }
+
+        // Extract the windows anchored in the dirty boxes of `changed` again and apply the difference
+        void update(const std::vector<SpatialObject>& changed) {
+            double a = S_.size.a;
+            double b = S_.size.b;
+            std::vector<RectangularRegion> boxes = dirty_boxes(changed, a, b);
+            MiningOptions quiet = opt_;
+            quiet.verbose = false;
+            std::vector<Instance> fresh;
+            extract_in(D_, S_, boxes, quiet, [&](Instance&& inst) { fresh.push_back(std::move(inst)); }); // grows boxes
+            auto in_boxes = [&](const Anchor& p) {
+                for (const auto& box : boxes) {
+                    if (p.first >= box.x_min && p.first <= box.x_max && p.second >= box.y_min && p.second <= box.y_max) return true;
+                }
+                return false;
+            };
+
+            // Drop the anchors in the boxes; their candidates are decided below
+            std::vector<std::vector<int>> touched;
+            for (const auto& box : boxes) {
+                CellKey lo = cell_of(box.x_min, box.y_min), hi = cell_of(box.x_max, box.y_max);
+                for (long long cx = lo.first; cx <= hi.first; ++cx) {
+                    for (long long cy = lo.second; cy <= hi.second; ++cy) {
+                        auto it = by_cell_.find({ cx, cy });
+                        if (it == by_cell_.end()) continue;
+                        for (const auto& ids : it->second) touched.push_back(ids);
+                    }
+                }
+            }
+            std::sort(touched.begin(), touched.end());
+            touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+            for (const auto& ids : touched) {
+                Entry& e = entries_.at(ids);
+                std::vector<Anchor> kept;
+                for (const auto& p : e.anchors) {
+                    if (in_boxes(p)) unindex(ids, p);
+                    else kept.push_back(p);
+                }
+                e.anchors.swap(kept);
+            }
+
+            // Re-extracted: known candidates regain their anchors, new ones join a cluster
+            // in generate_candidates order (canonical copy first)
+            std::sort(fresh.begin(), fresh.end(), candidate_before);
+            for (auto& inst : fresh) {
+                std::vector<int> ids = ids_of(inst.O_P);
+                Anchor p(inst.x - a / 2.0, inst.y - b / 2.0);
+                auto it = entries_.find(ids);
+                if (it == entries_.end()) {
+                    insert(ids, inst, a, b);
+                    it = entries_.find(ids);
+                }
+                std::vector<Anchor>& anchors = it->second.anchors;
+                if (std::find(anchors.begin(), anchors.end(), p) != anchors.end()) continue; // on two boxes' shared edge
+                anchors.push_back(p);
+                by_cell_[cell_of(p.first, p.second)].push_back(ids);
+            }
+            for (const auto& ids : touched) {
+                if (entries_.at(ids).anchors.empty()) erase(ids);
+            }
+            compact();
+        }
+
+        void insert(const std::vector<int>& ids, const Instance& inst, double a, double b) {
+            Entry e;
+            e.objs = inst.O_P;
+            canonical_sort(e.objs);
+
+            RDV rdv = make_rdv(e.objs);
+            VPTreeNode*& root = trees_[type_key(e.objs)];
+            int k = vpt_search(root, rdv, 2.0 * epsilon_);
+            bool revived = k >= 0 && clusters_[k].members == 0;
+            if (k < 0) {
+                k = (int)clusters_.size();
+                Cluster c;
+                c.rep = RectangularPattern(a, b);
+                c.rep.O_P = e.objs;
+                c.slots.resize(e.objs.size());
+                clusters_.push_back(std::move(c));
+                vpt_insert(root, rdv, k);
+            }
+            e.cluster = k;
+            count(clusters_[k], e.objs, +1);
+            clusters_[k].members++;
+            if (revived) empty_clusters_--;
+
+            entries_.emplace(ids, std::move(e));
+            live_++;
+        }
+
+        void erase(const std::vector<int>& ids) {
+            auto it = entries_.find(ids);
+            Cluster& c = clusters_[it->second.cluster];
+            count(c, it->second.objs, -1);
+            if (--c.members == 0) empty_clusters_++;
+            entries_.erase(it);
+            live_--;
+        }
+
+        void unindex(const std::vector<int>& ids, const Anchor& p) {
+            CellKey cell = cell_of(p.first, p.second);
+            auto& list = by_cell_[cell];
+            list.erase(std::find(list.begin(), list.end(), ids));
+            if (list.empty()) by_cell_.erase(cell);
+        }
+
+        // Drop the emptied clusters once they outnumber the others; rebuild the trees
+        void compact() {
+            if (empty_clusters_ == 0 || empty_clusters_ <= clusters_.size() - empty_clusters_) return;
+            std::vector<int> renumber(clusters_.size(), -1);
+            std::vector<Cluster> kept;
+            for (size_t k = 0; k < clusters_.size(); ++k) {
+                if (clusters_[k].members == 0) continue;
+                renumber[k] = (int)kept.size();
+                kept.push_back(std::move(clusters_[k]));
+            }
+            clusters_.swap(kept);
+            for (auto& kv : entries_) kv.second.cluster = renumber[kv.second.cluster];
+            for (auto& kv : trees_) delete kv.second;
+            trees_.clear();
+            for (size_t k = 0; k < clusters_.size(); ++k) {
+                const auto& objs = clusters_[k].rep.O_P;
+                vpt_insert(trees_[type_key(objs)], make_rdv(objs), (int)k);
+            }
+            empty_clusters_ = 0;
+        }
+
+        RectangularSketch S_;
+        double epsilon_;
+        int min_freq_;
+        double window_;
+        MiningOptions opt_;
+        double now_ = -INFINITY;
+
+        std::deque<CheckIn> pending_;             // pushed, not yet admitted
+        std::deque<CheckIn> active_;              // check-ins in the window, by time
+        std::unordered_map<int, int> visits_;     // venue id -> check-ins in the window
+        Spatial D_;                               // venues in the window
+
+        std::unordered_map<std::vector<int>, Entry, IdsHash> entries_; // live candidates by object ids
+        std::unordered_map<CellKey, std::vector<std::vector<int>>, CellHash> by_cell_; // ids per anchor, by anchor cell (a x b)
+        std::unordered_map<TypeKey, VPTreeNode*, TypeKeyHash> trees_;  // cluster representatives per type key
+        std::vector<Cluster> clusters_;
+        size_t empty_clusters_ = 0;  // clusters without members
+        size_t live_ = 0;
+    };
+}
+
+#endif // STREAMING_HPP
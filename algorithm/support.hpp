@@ -0,0 +1,203 @@
+#ifndef SUPPORT_HPP
+#define SUPPORT_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+/**
+ * @brief 单个模式对象 o 的支持集合 F(o)
+ * 以排序向量存储数据库对象 ID：插入时直接追加到未排序的尾部，
+ * 尾部长度达到已排序前缀的大小时再排序、归并并去重 (摊还 O(log n))。
+ * 加载后的 ID 是稠密整数，向量比 std::set 的红黑树节点省得多。
+ * 注意：size()/ids() 会触发惰性压缩，同一对象不可被多个线程同时读取。
+ */
+class SupportSet {
+public:
+    void insert(int id) {
+        ids_.push_back(id);
+        if (ids_.size() >= 2 * std::max<size_t>(sorted_, 32)) compact();
+    }
+
+    // 合并另一个支持集合 (用于分片/分块结果的合并)
+    void merge(const SupportSet& other) {
+        const auto& src = other.ids();
+        ids_.insert(ids_.end(), src.begin(), src.end());
+        compact();
+    }
+
+    size_t size() const {
+        compact();
+        return ids_.size();
+    }
+
+    bool empty() const { return ids_.empty(); }
+
+    // 已排序、去重的 ID 列表
+    const std::vector<int>& ids() const {
+        compact();
+        return ids_;
+    }
+
+    void clear() {
+        ids_.clear();
+        sorted_ = 0;
+    }
+
+private:
+    void compact() const {
+        if (sorted_ == ids_.size()) return;
+        auto mid = ids_.begin() + sorted_;
+        std::sort(mid, ids_.end());
+        std::inplace_merge(ids_.begin(), mid, ids_.end());
+        ids_.erase(std::unique(ids_.begin(), ids_.end()), ids_.end());
+        sorted_ = ids_.size();
+    }
+
+    mutable std::vector<int> ids_;
+    mutable size_t sorted_ = 0; // ids_[0, sorted_) 已排序且去重
+};
+
+/**
+ * @brief HyperLogLog 基数估计寄存器 (2^p 个 8 位寄存器)
+ * 用于近似支持度计数：内存与支持集合大小无关，相对标准误差约 1.04 / sqrt(2^p)。
+ */
+class HyperLogLog {
+public:
+    explicit HyperLogLog(int precision = 10)
+        : p_(std::min(std::max(precision, 4), 16)), regs_(size_t(1) << p_, 0) {}
+
+    void insert(int id) {
+        uint64_t h = mix(static_cast<uint64_t>(static_cast<uint32_t>(id)));
+        size_t idx = static_cast<size_t>(h >> (64 - p_));
+        uint64_t w = (h << p_) | (uint64_t(1) << (p_ - 1)); // 哨兵位保证 rank 有界
+        uint8_t rank = static_cast<uint8_t>(leading_zeros(w) + 1);
+        if (rank > regs_[idx]) regs_[idx] = rank;
+    }
+
+    void merge(const HyperLogLog& other) {
+        for (size_t i = 0; i < regs_.size() && i < other.regs_.size(); ++i) {
+            regs_[i] = std::max(regs_[i], other.regs_[i]);
+        }
+    }
+
+    double estimate() const {
+        double m = static_cast<double>(regs_.size());
+        double sum = 0.0;
+        size_t zeros = 0;
+        for (uint8_t r : regs_) {
+            sum += std::ldexp(1.0, -r);
+            if (r == 0) zeros++;
+        }
+        double alpha = 0.7213 / (1.0 + 1.079 / m);
+        double E = alpha * m * m / sum;
+        // 小基数修正 (Linear Counting)
+        if (E <= 2.5 * m && zeros > 0) E = m * std::log(m / static_cast<double>(zeros));
+        return E;
+    }
+
+    // 相对标准误差
+    double relative_error() const { return 1.04 / std::sqrt(static_cast<double>(regs_.size())); }
+
+    int precision() const { return p_; }
+
+private:
+    static uint64_t mix(uint64_t x) {
+        // splitmix64 finalizer
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+
+    static int leading_zeros(uint64_t x) {
+        int n = 0;
+        while (!(x & (uint64_t(1) << 63))) { x <<= 1; n++; }
+        return n;
+    }
+
+    int p_;
+    std::vector<uint8_t> regs_;
+};
+
+/**
+ * @brief 一个模式的全部支持集合 F = {F(o) | o ∈ O_P}
+ * cap > 0 时启用提前退出：所有对象的支持度都达到 cap 后不再记录新的 ID，
+ * 此时 min_support() 只保证 >= cap。只需判断 "是否频繁" 的路径传入 min_freq，
+ * 需要精确支持度 (如按频数排序输出) 的路径保持 cap = 0。
+ * hll_precision > 0 时为近似模式：每个对象只保留固定大小的 HyperLogLog 寄存器，
+ * 支持度为估计值 (见 relative_error())。
+ */
+class PatternSupport {
+public:
+    explicit PatternSupport(size_t slots = 0, int cap = 0, int hll_precision = 0)
+        : slots_(hll_precision > 0 ? 0 : slots), cap_(cap),
+          check_interval_(std::max<size_t>(slots * std::max(cap, 1), 64)) {
+        if (hll_precision > 0) sketches_.assign(slots, HyperLogLog(hll_precision));
+    }
+
+    void insert(size_t slot, int id) {
+        if (!sketches_.empty()) {
+            sketches_[slot].insert(id);
+            return;
+        }
+        if (saturated_) return;
+        slots_[slot].insert(id);
+        if (cap_ > 0 && ++since_check_ >= check_interval_) {
+            since_check_ = 0;
+            saturated_ = frequent(cap_);
+        }
+    }
+
+    // 每个对象的支持度是否都 >= min_freq (遇到第一个不满足的对象立即返回)
+    bool frequent(int min_freq) const {
+        if (slots() == 0) return false;
+        for (size_t i = 0; i < slots(); ++i) {
+            if (count(i) < min_freq) return false;
+        }
+        return true;
+    }
+
+    // 单个对象的支持度 |F(o)| (近似模式下为四舍五入的估计值)
+    int count(size_t slot) const {
+        if (!sketches_.empty()) return static_cast<int>(std::lround(sketches_[slot].estimate()));
+        return static_cast<int>(slots_[slot].size());
+    }
+
+    // 模式支持度：min_o |F(o)|
+    int min_support() const {
+        if (slots() == 0) return 0;
+        int min_sup = count(0);
+        for (size_t i = 1; i < slots(); ++i) min_sup = std::min(min_sup, count(i));
+        return min_sup;
+    }
+
+    void merge(const PatternSupport& other) {
+        for (size_t i = 0; i < slots_.size() && i < other.slots_.size(); ++i) {
+            slots_[i].merge(other.slots_[i]);
+        }
+        for (size_t i = 0; i < sketches_.size() && i < other.sketches_.size(); ++i) {
+            sketches_[i].merge(other.sketches_[i]);
+        }
+    }
+
+    bool approximate() const { return !sketches_.empty(); }
+    // 支持度的相对标准误差 (精确模式为 0)
+    double relative_error() const { return sketches_.empty() ? 0.0 : sketches_[0].relative_error(); }
+
+    bool saturated() const { return saturated_; }
+    size_t slots() const { return sketches_.empty() ? slots_.size() : sketches_.size(); }
+    const SupportSet& operator[](size_t slot) const { return slots_[slot]; }
+
+private:
+    std::vector<SupportSet> slots_;
+    std::vector<HyperLogLog> sketches_;
+    int cap_;
+    size_t check_interval_;
+    size_t since_check_ = 0;
+    bool saturated_ = false;
+};
+
+#endif // SUPPORT_HPP
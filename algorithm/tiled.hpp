@@ -0,0 +1,557 @@
+#ifndef TILED_HPP
+#define TILED_HPP
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+#include "support.hpp"
+#include "options.hpp"
+#include "fspm+.hpp"
+#include "external.hpp"
+
+namespace fspm_plus {
+
+    /**
+     * @brief Knobs of the out-of-core tiled mode (see tiled_mining)
+     */
+    struct TiledOptions {
+        std::string work_dir = "fspm_tiles"; // scratch directory for tile and spill files (*.spill)
+        size_t memory_budget = 256ull << 20; // bytes for the working set of one tile, and the merge's sort runs
+        size_t bytes_per_object = 512;       // working-set estimate per object: events, windows, candidates
+        int histogram = 256;                 // density histogram cells per axis used to size the tiles
+        size_t buffer_objects = 1 << 20;     // objects buffered in memory before tile files are appended
+        double grid_resolution = 0.0;        // > 0: snap projected coordinates to this grid (km), as Spatial::load's gridResolution
+        bool keep_files = false;
+    };
+
+    /**
+     * @brief Uniform kx x ky tiling of the sketch objects' bounding box.
+     * Tile (i, j) owns the valid regions whose min corner p lies in its core. The sweep
+     * state at p depends on the objects in [p.x - a, p.x] x [p.y - b, p.y], and extraction
+     * reads the window [p.x, p.x + a] x [p.y, p.y + b], so a tile reads its core extended
+     * by an a x b halo on every side, padded by tie_pad for objects on the halo edge
+     * (halo). Outer cores are unbounded so that every region has exactly one owner.
+     */
+    struct TileLayout {
+        double x_min = 0, y_min = 0, x_max = 0, y_max = 0;
+        double tile_w = 1, tile_h = 1;
+        double a = 0, b = 0;
+        int kx = 1, ky = 1;
+
+        int col(double x) const { return std::min(std::max((int)std::floor((x - x_min) / tile_w), 0), kx - 1); }
+        int row(double y) const { return std::min(std::max((int)std::floor((y - y_min) / tile_h), 0), ky - 1); }
+        size_t count() const { return (size_t)kx * ky; }
+        size_t id(int i, int j) const { return (size_t)i * ky + j; }
+
+        // Core of tile t grown by a + pad, b + pad: what mine_tile sweeps first (see core_regions)
+        RectangularRegion halo(size_t t, double pad) const {
+            RectangularRegion c = core(t);
+            return RectangularRegion(c.x_min - a - pad, c.y_min - b - pad, c.x_max + a + pad, c.y_max + b + pad);
+        }
+
+        RectangularRegion core(size_t t) const {
+            const double inf = std::numeric_limits<double>::infinity();
+            int i = (int)(t / ky), j = (int)(t % ky);
+            return RectangularRegion(i == 0 ? -inf : x_min + i * tile_w, j == 0 ? -inf : y_min + j * tile_h,
+                                     i == kx - 1 ? inf : x_min + (i + 1) * tile_w, j == ky - 1 ? inf : y_min + (j + 1) * tile_h);
+        }
+    };
+
+    /**
+     * @brief Spill of tile results: the raw candidates of every tile, with their window
+     * anchors and window-relative coordinates as extracted (objects in extraction order;
+     * a round trip through absolute coordinates would round them and move ties), appended
+     * to candidates_<writer>.spill (one writer per process). Tiles may produce the same
+     * instance near their borders; merge() deduplicates and groups them globally.
+     *
+     * Record, native byte order: u32 n, f64 ax, f64 ay, n x (i32 id, f64 x, f64 y, i32 keyword)
+     */
+    class TileSpill {
+    public:
+        TileSpill(const std::string& dir, int writer, size_t buffer_bytes = 16u << 20)
+            : dir_(dir), writer_(writer), buffer_bytes_(buffer_bytes) {}
+
+        ~TileSpill() { flush(); }
+
+        void add(const Instance& inst) {
+            double ax = inst.x - inst.size.a / 2.0, ay = inst.y - inst.size.b / 2.0; // window anchor
+            put_raw<uint32_t>(buf_, (uint32_t)inst.O_P.size());
+            put_raw<double>(buf_, ax);
+            put_raw<double>(buf_, ay);
+            for (const auto& o : inst.O_P) {
+                put_raw<int32_t>(buf_, o.id);
+                put_raw<double>(buf_, o.x);
+                put_raw<double>(buf_, o.y);
+                put_raw<int32_t>(buf_, o.keyword);
+            }
+            if (buf_.size() >= buffer_bytes_) flush();
+        }
+
+        // Append the buffer to the spill file; false (and reported) if it could not be written
+        bool flush() {
+            if (buf_.empty()) return ok_;
+            std::string path = file_of(dir_, writer_);
+            std::ofstream out(path, std::ios::binary | std::ios::app);
+            if (out) out.write(buf_.data(), buf_.size());
+            if (!out) {
+                std::cerr << "Error: Could not write spill file " << path << std::endl;
+                ok_ = false;
+            }
+            buf_.clear();
+            return ok_;
+        }
+
+        static std::string file_of(const std::string& dir, int writer) {
+            return (std::filesystem::path(dir) / ("candidates_" + std::to_string(writer) + ".spill")).string();
+        }
+
+        /**
+         * @brief Group the candidates spilled by `writers` writers exactly as
+         * tree_optimized_fspm groups generate_candidates: the records are sorted into the
+         * candidate order of dedup_candidates (CandidateRuns, RunOrder::Extraction: external
+         * runs of run_bytes, so the candidates never have to fit in memory), duplicates keep
+         * the canonical copy, and one TreeGrouper per type key is fed in that order. Memory
+         * is the run buffer plus the clusters. A missing writer file has no candidates; an
+         * unreadable one aborts the merge with an error and no patterns.
+         * @return Frequent patterns by support descending; supports go to opt.report
+         */
+        static std::vector<RectangularPattern> merge(const std::string& dir, int writers, const RectangularSketch& S,
+                                                     double epsilon, int min_freq, const MiningOptions& opt,
+                                                     size_t run_bytes = 256ull << 20) {
+            double a = S.size.a;
+            double b = S.size.b;
+            if (opt.report) {
+                opt.report->supports.clear();
+                opt.report->support_error = 0.0;
+                opt.report->recounted = 0;
+            }
+
+            CandidateRuns runs(dir, epsilon, run_bytes, 64, RunOrder::Extraction);
+            size_t read = 0;
+            for (int w = 0; w < writers && runs.ok(); ++w) {
+                std::string path = file_of(dir, w);
+                std::ifstream in(path, std::ios::binary);
+                if (!in.is_open()) continue; // nothing spilled
+                CandidateRecord rec;
+                bool bad = false;
+                while (get_record(in, rec, bad)) {
+                    runs.add(std::move(rec));
+                    read++;
+                }
+                if (bad) {
+                    std::cerr << "Error: Could not read spill file " << path << std::endl;
+                    runs.remove_files();
+                    return {};
+                }
+            }
+            runs.finish();
+
+            std::unordered_map<TypeKey, TreeGrouper, TypeKeyHash> groupers;
+            std::vector<std::pair<TreeGrouper*, int>> order; // clusters by first candidate
+            size_t distinct = 0;
+            bool scanned = runs.merge_scan([&](const CandidateRecord& rec) {
+                std::vector<SpatialObject> objs = rec.objs; // window-relative, as generate_candidates leaves them
+                canonical_sort(objs);
+                TreeGrouper& g = groupers.try_emplace(type_key(objs), a, b, epsilon, opt.support_precision()).first->second;
+                int idx = g.add(objs);
+                if (g.members[idx] == 1) order.push_back({ &g, idx });
+            }, &distinct);
+            runs.remove_files();
+            if (!scanned) {
+                std::cerr << "Error: Tile merge aborted, no patterns reported" << std::endl;
+                return {};
+            }
+
+            std::vector<std::pair<RectangularPattern, int>> found;
+            for (const auto& entry : order) {
+                int sup = entry.first->F[entry.second].min_support();
+                if (sup >= min_freq) found.push_back({ std::move(entry.first->R[entry.second]), sup });
+            }
+
+            std::stable_sort(found.begin(), found.end(), [](const auto& x, const auto& y) { return x.second > y.second; });
+            if (opt.verbose) {
+                std::cout << "[Tiled] Merged " << read << " tile candidates (" << distinct << " distinct) into " << order.size()
+                          << " clusters, " << found.size() << " frequent patterns." << std::endl;
+            }
+            std::vector<RectangularPattern> R;
+            for (auto& pf : found) {
+                R.push_back(std::move(pf.first));
+                if (opt.report) opt.report->supports.push_back(pf.second);
+            }
+            return R;
+        }
+
+    private:
+        template <typename T>
+        static void put_raw(std::string& buf, T v) { buf.append(reinterpret_cast<const char*>(&v), sizeof(T)); }
+        template <typename T>
+        static bool get_raw(std::istream& in, T& v) { return (bool)in.read(reinterpret_cast<char*>(&v), sizeof(T)); }
+
+        // false at the end of the file; a truncated record also sets bad
+        static bool get_record(std::istream& in, CandidateRecord& rec, bool& bad) {
+            if (in.peek() == std::char_traits<char>::eof()) {
+                bad = in.bad();
+                return false;
+            }
+            uint32_t n = 0;
+            if (!get_raw(in, n) || !get_raw(in, rec.ax) || !get_raw(in, rec.ay) || n > (1u << 16)) {
+                bad = true;
+                return false;
+            }
+            rec.objs.resize(n);
+            for (auto& o : rec.objs) {
+                int32_t id, kw;
+                if (!get_raw(in, id) || !get_raw(in, o.x) || !get_raw(in, o.y) || !get_raw(in, kw)) {
+                    bad = true;
+                    return false;
+                }
+                o.id = id;
+                o.keyword = kw;
+            }
+            return true;
+        }
+
+        std::string dir_;
+        int writer_;
+        size_t buffer_bytes_;
+        std::string buf_;
+        bool ok_ = true;
+    };
+
+    /**
+     * @brief Mine one tile: the candidates of the regions the tile owns (see TileLayout)
+     * go to the spill unchanged. Every region has one owner, so the tiles together
+     * produce the candidates of generate_candidates; a neighbour may repeat an instance
+     * from another window, which TileSpill::merge deduplicates.
+     *
+     * The regions come from core_regions over the tile, so ties with the halo edges are
+     * exact. A run of equal counts starting in the core may chain past the halo on
+     * gridded data, though; if core_regions needs objects right of `covered`, nothing is
+     * spilled and `needed` tells the caller how far to extend the tile before mining it
+     * again.
+     *
+     * opt.query_box and opt.index are dropped: the caller keeps only the objects inside the
+     * box when it cuts the tiles.
+     *
+     * @param tile Sketch objects of TileLayout::halo(t, tie_pad) extended right to
+     *             covered, sorted by x; tile.resolution is the dataset's
+     * @param covered Right edge up to which the tile holds every object of its rows (+inf: all)
+     * @param needed Set to covered, or to the x the tile must cover when it falls short
+     * @return Number of candidates
+     */
+    inline size_t mine_tile(const Spatial& tile, const RectangularRegion& core, double covered, const RectangularSketch& S,
+                            TileSpill& spill, const MiningOptions& opt, double& needed) {
+        MiningOptions inner = opt;
+        inner.verbose = false;
+        inner.query_box = nullptr;
+        inner.index = nullptr;
+
+        // core_regions reads the grid and the end of the data from D; the tile ends at covered
+        Spatial reach;
+        reach.resolution = tile.resolution;
+        reach.x_max = covered;
+        needed = covered;
+        auto fetch = [&](const RectangularRegion& H, std::vector<const SpatialObject*>& out) {
+            out.clear();
+            if (H.x_max > covered) {
+                needed = H.x_max;
+                return;
+            }
+            auto it = std::lower_bound(tile.objects.begin(), tile.objects.end(), H.x_min,
+                                       [](const SpatialObject& o, double x) { return o.x < x; });
+            for (; it != tile.objects.end() && it->x <= H.x_max; ++it) {
+                if (it->y >= H.y_min && it->y <= H.y_max) out.push_back(&*it);
+            }
+        };
+        std::vector<RectangularRegion> merged = core_regions(reach, S, core, inner, fetch);
+        if (needed > covered) return 0;
+
+        // Extraction only uses a region's min corner, so a region belongs to the tile whose core holds it
+        std::vector<RectangularRegion> V;
+        for (const auto& r : merged) {
+            if (r.x_min >= core.x_min && r.x_min < core.x_max && r.y_min >= core.y_min && r.y_min < core.y_max) V.push_back(r);
+        }
+        std::vector<Instance> C = extract_candidates(tile, S, V, inner);
+        for (const auto& inst : C) spill.add(inst);
+        return C.size();
+    }
+
+    /**
+     * @brief Out-of-core FSPM+ over a CSV that does not fit in memory.
+     *
+     * 1. Scan: average latitude (the projection of Spatial::load) and the bounds of the
+     *    objects whose keyword is in S.K; no other object can be part of an instance.
+     * 2. Project: sketch objects are projected (and snapped to grid_resolution), and those inside opt.query_box (if set;
+     *    the layout bounds are clipped to it) are written to objects.spill and counted in
+     *    a density histogram.
+     * 3. Layout: the smallest k x k tiling whose densest tile plus halo, estimated from
+     *    the histogram, fits memory_budget at bytes_per_object per object.
+     * 4. Distribute: objects are appended to the file of every tile whose core + halo
+     *    contains them (at most nine), through a bounded buffer.
+     * 5. Mine: tiles are loaded one at a time and mined by mine_tile into the spill. A
+     *    tile whose runs of equal counts reach past its halo is extended from the files
+     *    of the columns to its right and mined again.
+     * 6. Merge: TileSpill::merge, a global regroup of the spilled candidates.
+     *
+     * The tiles together produce the candidate set of generate_candidates on the loaded
+     * dataset, and the merge groups it in the tree engine's candidate order, so the
+     * patterns and supports are those of tree_optimized_fspm on Spatial::load of the same
+     * file (gridResolution = grid_resolution), whatever the tiling, ties included. The merge sorts the candidates in external runs of
+     * memory_budget bytes.
+     * opt.cancel stops before the next tile, and what has been spilled is still merged.
+     */
+    inline std::vector<RectangularPattern> tiled_mining(const std::string& csv_path, const RectangularSketch& S, double epsilon, int min_freq,
+                                                        const TiledOptions& tiles = TiledOptions(), const MiningOptions& opt = MiningOptions(),
+                                                        bool has_header = true) {
+        namespace fs = std::filesystem;
+        const double R_earth = 6371.0;
+        std::error_code ec;
+        fs::create_directories(tiles.work_dir, ec);
+        for (const auto& e : fs::directory_iterator(tiles.work_dir, ec)) {
+            if (e.path().extension() == ".spill") fs::remove(e.path(), ec);
+        }
+        auto path_in = [&](const std::string& name) { return (fs::path(tiles.work_dir) / name).string(); };
+        auto cleanup = [&]() {
+            if (tiles.keep_files) return;
+            for (const auto& e : fs::directory_iterator(tiles.work_dir, ec)) {
+                if (e.path().extension() == ".spill") fs::remove(e.path(), ec);
+            }
+        };
+
+        // 1. Scan
+        std::string line;
+        int id, kw;
+        double lat, lon;
+        double sum_lat = 0.0;
+        size_t all = 0, kept = 0;
+        double lat_min = 0, lat_max = 0, lon_min = 0, lon_max = 0;
+        {
+            std::ifstream file(csv_path);
+            if (!file.is_open()) {
+                std::cerr << "Error: Could not open file " << csv_path << std::endl;
+                return {};
+            }
+            if (has_header) std::getline(file, line);
+            while (std::getline(file, line)) {
+                if (!Spatial::parseLine(line, id, kw, lat, lon)) continue;
+                all++;
+                sum_lat += SpatialObject(id, kw, lat, lon).y / R_earth; // as Spatial::load averages it
+                if (!S.K.count(kw)) continue;
+                if (kept++ == 0) { lat_min = lat_max = lat; lon_min = lon_max = lon; }
+                lat_min = std::min(lat_min, lat); lat_max = std::max(lat_max, lat);
+                lon_min = std::min(lon_min, lon); lon_max = std::max(lon_max, lon);
+            }
+        }
+        if (kept == 0) {
+            if (opt.verbose) std::cout << "[Tiled] No object matches the sketch keywords." << std::endl;
+            return {};
+        }
+        double cos_lat = std::cos(sum_lat / all);
+        TileLayout L;
+        L.a = S.size.a;
+        L.b = S.size.b;
+        L.x_min = R_earth * lon_min * M_PI / 180.0 * cos_lat;
+        L.x_max = R_earth * lon_max * M_PI / 180.0 * cos_lat;
+        L.y_min = R_earth * lat_min * M_PI / 180.0;
+        L.y_max = R_earth * lat_max * M_PI / 180.0;
+        if (opt.query_box) {
+            L.x_min = std::max(L.x_min, opt.query_box->x_min);
+            L.x_max = std::min(L.x_max, opt.query_box->x_max);
+            L.y_min = std::max(L.y_min, opt.query_box->y_min);
+            L.y_max = std::min(L.y_max, opt.query_box->y_max);
+            if (L.x_min > L.x_max || L.y_min > L.y_max) {
+                if (opt.verbose) std::cout << "[Tiled] No object matches the sketch keywords in the query box." << std::endl;
+                return {};
+            }
+        }
+
+        // 2. Project + histogram
+        int G = std::max(tiles.histogram, 1);
+        double cw = std::max(L.x_max - L.x_min, 1e-9) / G, ch = std::max(L.y_max - L.y_min, 1e-9) / G;
+        std::vector<size_t> hist((size_t)(G + 1) * (G + 1), 0); // 2D prefix sums, row/col 0 = 0
+        auto cell_x = [&](double x) { return std::min(std::max((int)std::floor((x - L.x_min) / cw), 0), G - 1); };
+        auto cell_y = [&](double y) { return std::min(std::max((int)std::floor((y - L.y_min) / ch), 0), G - 1); };
+        size_t buffer_objects = std::max<size_t>(tiles.buffer_objects, 1);
+        {
+            std::ifstream file(csv_path);
+            std::ofstream out(path_in("objects.spill"), std::ios::binary);
+            if (!out) {
+                std::cerr << "Error: Could not write " << path_in("objects.spill") << std::endl;
+                return {};
+            }
+            std::vector<SpatialObject> buf;
+            kept = 0; // recounted inside opt.query_box
+            if (has_header) std::getline(file, line);
+            while (std::getline(file, line)) {
+                if (!Spatial::parseLine(line, id, kw, lat, lon) || !S.K.count(kw)) continue;
+                SpatialObject o(id, kw, lat, lon);
+                o.x *= cos_lat;
+                if (tiles.grid_resolution > 0.0) Spatial::snapObject(o, tiles.grid_resolution);
+                if (!opt.in_box(o.x, o.y)) continue;
+                kept++;
+                hist[(size_t)(cell_x(o.x) + 1) * (G + 1) + cell_y(o.y) + 1]++;
+                buf.push_back(o);
+                if (buf.size() >= buffer_objects) {
+                    out.write(reinterpret_cast<const char*>(buf.data()), buf.size() * sizeof(SpatialObject));
+                    buf.clear();
+                }
+            }
+            out.write(reinterpret_cast<const char*>(buf.data()), buf.size() * sizeof(SpatialObject));
+        }
+        if (kept == 0) {
+            if (opt.verbose) std::cout << "[Tiled] No object matches the sketch keywords in the query box." << std::endl;
+            cleanup();
+            return {};
+        }
+        for (int i = 1; i <= G; ++i) {
+            for (int j = 1; j <= G; ++j) {
+                hist[(size_t)i * (G + 1) + j] += hist[(size_t)(i - 1) * (G + 1) + j] + hist[(size_t)i * (G + 1) + j - 1] -
+                                                 hist[(size_t)(i - 1) * (G + 1) + j - 1];
+            }
+        }
+        auto count_in = [&](double x0, double y0, double x1, double y1) { // cells touching the rectangle
+            int i0 = cell_x(x0), i1 = cell_x(x1), j0 = cell_y(y0), j1 = cell_y(y1);
+            auto at = [&](int i, int j) { return hist[(size_t)i * (G + 1) + j]; };
+            return at(i1 + 1, j1 + 1) - at(i0, j1 + 1) - at(i1 + 1, j0) + at(i0, j0);
+        };
+
+        // 3. Layout
+        size_t budget_objects = std::max<size_t>(tiles.memory_budget / std::max<size_t>(tiles.bytes_per_object, 1), 1);
+        size_t worst = kept;
+        for (int k = 1;; k *= 2) {
+            L.kx = L.ky = k;
+            L.tile_w = std::max(L.x_max - L.x_min, 1e-9) / k;
+            L.tile_h = std::max(L.y_max - L.y_min, 1e-9) / k;
+            worst = 0;
+            for (int i = 0; i < k; ++i) {
+                for (int j = 0; j < k; ++j) {
+                    double x0 = L.x_min + i * L.tile_w, y0 = L.y_min + j * L.tile_h;
+                    worst = std::max(worst, count_in(x0 - L.a, y0 - L.b, x0 + L.tile_w + L.a, y0 + L.tile_h + L.b));
+                }
+            }
+            if (worst <= budget_objects) break;
+            if (k >= G || L.tile_w < 2 * L.a || L.tile_h < 2 * L.b) {
+                std::cerr << "Warning: densest tile holds ~" << worst << " objects, above the memory budget of "
+                          << budget_objects << std::endl;
+                break;
+            }
+        }
+        if (opt.verbose) {
+            std::cout << "[Tiled] " << kept << "/" << all << " objects match the sketch; " << L.kx << "x" << L.ky
+                      << " tiles, densest ~" << worst << " objects." << std::endl;
+        }
+
+        // 4. Distribute
+        const double pad = tie_pad(tiles.grid_resolution, L.a, L.b);
+        {
+            std::ifstream in(path_in("objects.spill"), std::ios::binary);
+            std::vector<std::vector<SpatialObject>> buf(L.count());
+            size_t buffered = 0;
+            auto flush = [&]() {
+                for (size_t t = 0; t < buf.size(); ++t) {
+                    if (buf[t].empty()) continue;
+                    std::ofstream out(path_in("tile" + std::to_string(t) + ".spill"), std::ios::binary | std::ios::app);
+                    out.write(reinterpret_cast<const char*>(buf[t].data()), buf[t].size() * sizeof(SpatialObject));
+                    buf[t].clear();
+                }
+                buffered = 0;
+            };
+            SpatialObject o;
+            while (in.read(reinterpret_cast<char*>(&o), sizeof(SpatialObject))) {
+                // One column and row of slack around col/row, whose rounding the exact halo test settles
+                int i0 = std::max(L.col(o.x - L.a - pad) - 1, 0), i1 = std::min(L.col(o.x + L.a + pad) + 1, L.kx - 1);
+                int j0 = std::max(L.row(o.y - L.b - pad) - 1, 0), j1 = std::min(L.row(o.y + L.b + pad) + 1, L.ky - 1);
+                for (int i = i0; i <= i1; ++i) {
+                    for (int j = j0; j <= j1; ++j) {
+                        RectangularRegion H = L.halo(L.id(i, j), pad);
+                        if (o.x < H.x_min || o.x > H.x_max || o.y < H.y_min || o.y > H.y_max) continue;
+                        buf[L.id(i, j)].push_back(o);
+                        buffered++;
+                    }
+                }
+                if (buffered >= buffer_objects) flush();
+            }
+            flush();
+        }
+        fs::remove(path_in("objects.spill"), ec);
+
+        // 5. Mine tile by tile
+        size_t candidates = 0, done = 0;
+        {
+            TileSpill spill(tiles.work_dir, 0);
+            for (size_t t = 0; t < L.count(); ++t) {
+                if (opt.cancelled()) {
+                    opt.mark_partial("tiles", done, L.count());
+                    break;
+                }
+                done++;
+                std::string path = path_in("tile" + std::to_string(t) + ".spill");
+                Spatial tile;
+                {
+                    std::ifstream in(path, std::ios::binary);
+                    if (!in) continue; // empty tile
+                    SpatialObject o;
+                    while (in.read(reinterpret_cast<char*>(&o), sizeof(SpatialObject))) tile.objects.push_back(o);
+                }
+                fs::remove(path, ec);
+                if (tile.objects.empty()) continue;
+                // Stable: objects sharing x keep the file order, as in Spatial::load
+                std::stable_sort(tile.objects.begin(), tile.objects.end(), [](const SpatialObject& p, const SpatialObject& q) { return p.x < q.x; });
+                RectangularRegion core = L.core(t);
+                RectangularRegion H = L.halo(t, pad);
+                tile.resolution = tiles.grid_resolution;
+                double covered = H.x_max, needed = H.x_max;
+                while (true) {
+                    tile.x_min = tile.objects.front().x;
+                    tile.x_max = tile.objects.back().x;
+                    tile.y_min = tile.y_max = tile.objects[0].y;
+                    for (const auto& p : tile.objects) {
+                        tile.y_min = std::min(tile.y_min, p.y);
+                        tile.y_max = std::max(tile.y_max, p.y);
+                    }
+                    candidates += mine_tile(tile, core, covered, S, spill, opt, needed);
+                    if (needed <= covered) break;
+                    // A run reaches past the halo: add the objects of the halo rows up to needed
+                    // from the files of the columns to the right (mined later, so still on disk),
+                    // each from the file of its own core
+                    int i_end = L.col(needed);
+                    double upto = i_end == L.kx - 1 ? std::numeric_limits<double>::infinity() : needed;
+                    std::vector<SpatialObject> more;
+                    for (int i = (int)(t / L.ky) + 1; i <= i_end; ++i) {
+                        for (int j = L.row(H.y_min); j <= L.row(H.y_max); ++j) {
+                            std::ifstream next(path_in("tile" + std::to_string(L.id(i, j)) + ".spill"), std::ios::binary);
+                            SpatialObject o;
+                            while (next.read(reinterpret_cast<char*>(&o), sizeof(SpatialObject))) {
+                                if (L.col(o.x) != i || L.row(o.y) != j || o.x <= covered || o.x > upto || o.y < H.y_min || o.y > H.y_max) continue;
+                                more.push_back(o);
+                            }
+                        }
+                    }
+                    std::stable_sort(more.begin(), more.end(), [](const SpatialObject& p, const SpatialObject& q) { return p.x < q.x; });
+                    tile.objects.insert(tile.objects.end(), more.begin(), more.end());
+                    covered = upto;
+                }
+                if (opt.verbose) {
+                    std::cout << "\r[Tiled] Mined tile " << done << "/" << L.count() << " (" << candidates << " candidates)    " << std::flush;
+                }
+            }
+        }
+        if (opt.verbose) std::cout << std::endl;
+
+        // 6. Merge
+        std::vector<RectangularPattern> R = TileSpill::merge(tiles.work_dir, 1, S, epsilon, min_freq, opt, tiles.memory_budget);
+        cleanup();
+        return R;
+    }
+}
+
+#endif // TILED_HPP
@@ -216,6 +216,34 @@ class DatasetManager:
         # Apply standard normalization (reindexing)
         self._normalize_csv(output_path, output_path)
 
+    def normalize_gowalla_checkins(self, input_path, output_path):
+        """
+        Like normalize_gowalla_legacy, but keeps every check-in and its time (for the
+        streaming miner): venueId, venueCategoryId, latitude, longitude, time, where
+        time is Unix seconds and rows are sorted by it.
+        """
+        print(f"Processing Gowalla check-ins from {input_path}...")
+        if not os.path.exists(input_path):
+            print("  Input path not found.")
+            return
+
+        try:
+            df = pd.read_csv(input_path, sep='\t', header=None,
+                             names=['venueCategory', 'time', 'latitude', 'longitude', 'venueId'])
+        except Exception as e:
+            print(f"Error reading file: {e}")
+            return
+
+        df = df[['venueId', 'venueCategory', 'latitude', 'longitude', 'time']]
+        df = df.rename(columns={'venueCategory': 'venueCategoryId'})
+        df['time'] = pd.to_datetime(df['time'], utc=True, errors='coerce')
+        df = df.dropna(subset=['time'])
+        df['time'] = (df['time'].astype('int64') // 10**9).astype(int)
+        df = df.sort_values(by=['time', 'venueId'], kind='stable')
+
+        df.to_csv(output_path, index=False)
+        self._normalize_csv(output_path, output_path)
+
     def normalize_nyc(self, path):
         """
         Combined logic from norm_nyc_tky.py
@@ -252,8 +280,13 @@ if __name__ == "__main__":
                  manager.normalize_dataset_file(sys.argv[2])
              else:
                  print("Usage: python dataset_manager.py norm <file_path>")
+        elif cmd == "checkins":
+             if len(sys.argv) > 3:
+                 manager.normalize_gowalla_checkins(sys.argv[2], sys.argv[3])
+             else:
+                 print("Usage: python dataset_manager.py checkins <gowalla_checkins.txt> <output.csv>")
         else:
-            print("Unknown command. Available: fsq_<n>, fsq_<start>_<end>, fsq_all, norm")
+            print("Unknown command. Available: fsq_<n>, fsq_<start>_<end>, fsq_all, norm, checkins")
     else:
         # Default action as per user request: "Extract 10 parquet and initialize"
         print("No arguments provided. Defaulting to: Extract 10 FSQ parquets.")
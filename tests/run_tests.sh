@@ -0,0 +1,19 @@
+#!/bin/bash
+# Build and run every tests/test_*.cpp against the headers in algorithm/.
+# Usage: tests/run_tests.sh [build dir]   (CXX and CXXFLAGS are honoured)
+cd "$(dirname "$0")" || exit 1
+out="${1:-/tmp/fspm_tests}"
+mkdir -p "$out"
+CXX="${CXX:-g++}"
+CXXFLAGS="${CXXFLAGS:--std=c++17 -O2 -Wall -Wno-sign-compare -pthread}"
+failed=0
+for src in test_*.cpp; do
+    bin="$out/${src%.cpp}"
+    if ! $CXX $CXXFLAGS -I../algorithm "$src" -o "$bin"; then
+        echo "${src%.cpp}: build failed"
+        failed=1
+        continue
+    fi
+    (cd "$out" && "$bin") || failed=1
+done
+exit $failed
@@ -0,0 +1,82 @@
+// CandidateEngine::Anchor against the single-sweep path: on continuous and gridded data,
+// snapped or not, with and without a prebuilt GridIndex, the anchor engine must return exactly the
+// candidates of generate_candidates (same copies of duplicates). After objects are
+// relabelled in place and touch() is called, the keyword counts it picks the rarest
+// keyword from must be current.
+
+#include <tuple>
+#include "spatial_index.hpp"
+#include "fspm+.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+
+// Candidates as (ids in O_P order, anchor), sorted: equal only if the same copies are kept
+static std::vector<std::tuple<std::vector<int>, double, double>> copies(const std::vector<Instance>& C) {
+    std::vector<std::tuple<std::vector<int>, double, double>> out;
+    for (const auto& inst : C) {
+        std::vector<int> ids;
+        for (const auto& o : inst.O_P) ids.push_back(o.id);
+        out.emplace_back(ids, inst.x, inst.y);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+static void compare(const Spatial& D, const RectangularSketch& S) {
+    MiningOptions anchor = quiet_options();
+    anchor.candidate_engine = CandidateEngine::Anchor;
+    auto expected = copies(generate_candidates(D, S, quiet_options()));
+    CHECK(copies(generate_candidates(D, S, anchor)) == expected);
+    GridIndex index(D);
+    anchor.index = &index;
+    CHECK(copies(generate_candidates(D, S, anchor)) == expected);
+}
+
+int main() {
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Spatial D = make_city(seed, 100, 400, 5, 3.0);
+        RectangularSketch S = motif_sketch(0.2, 0.2);
+        CHECK(!generate_candidates(D, S, quiet_options()).empty());
+        compare(D, S);
+        compare(D, motif_sketch(0.3, 0.15, 4));
+
+        Spatial G = make_city(seed, 100, 400, 5, 3.0, 0.05);
+        G.snap(0.05);
+        compare(G, S);
+
+        // Keyword 2 relabelled away and counted, then restored in place: touch() must
+        // recount, or the anchor engine sees no object of keyword 2 and returns nothing
+        Spatial M = D;
+        std::vector<int> relabelled;
+        for (auto& o : M.objects) {
+            if (o.keyword == 2) {
+                o.keyword = 4;
+                relabelled.push_back(o.id);
+            }
+        }
+        std::sort(relabelled.begin(), relabelled.end());
+        M.countKeywords();
+        CHECK(M.keywordCount(2) == 0);
+        for (auto& o : M.objects) {
+            if (std::binary_search(relabelled.begin(), relabelled.end(), o.id)) o.keyword = 2;
+        }
+        M.touch();
+        CHECK(M.keyword_counts == D.keyword_counts);
+        compare(M, S);
+    }
+    // Gridded coordinates tie region edges with anchor boxes and halos, unsnapped (as
+    // check-in venues sharing coordinates) and snapped; seeds where boxes used to drop
+    // or add candidates
+    for (unsigned seed : { 4, 9, 13, 14 }) {
+        for (double grid : { 0.02, 0.05, 0.1 }) {
+            Spatial G = make_city(seed, 150, 600, 5, 3.0, grid);
+            compare(G, motif_sketch(0.2, 0.2));
+            compare(G, motif_sketch(0.3, 0.15, 4));
+            G.snap(grid);
+            compare(G, motif_sketch(0.2, 0.2));
+            compare(G, motif_sketch(0.3, 0.15, 4));
+        }
+    }
+    return test_result("test_anchor");
+}
@@ -0,0 +1,74 @@
+// Bounding-box queries against a cut copy of the dataset: with opt.query_box, with and
+// without a GridIndex, single-sketch and batch candidate generation and sketch discovery
+// must find what they find on a dataset holding only the objects inside the box. An index
+// alone must not change the candidates.
+
+#include <tuple>
+#include "discovery.hpp"
+#include "spatial_index.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+
+// The objects of D inside box (closed), as a dataset of their own
+static Spatial cut(const Spatial& D, const RectangularRegion& box) {
+    Spatial C;
+    C.resolution = D.resolution;
+    for (const auto& o : D.objects) {
+        if (o.x >= box.x_min && o.x <= box.x_max && o.y >= box.y_min && o.y <= box.y_max) C.objects.push_back(o);
+    }
+    finish_dataset(C);
+    return C;
+}
+
+// Discovered sketches as (sketch, patterns, best support), sorted
+static std::vector<std::tuple<std::string, size_t, int>> discovered(const std::vector<DiscoveredSketch>& found) {
+    std::vector<std::tuple<std::string, size_t, int>> out;
+    for (const auto& d : found) out.emplace_back(d.S.toString(), d.patterns, d.best_support);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+int main() {
+    const double eps = 0.03;
+    const int min_freq = 3;
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Spatial D = make_city(seed, 150, 600, 5, 3.0);
+        GridIndex index(D);
+        const RectangularRegion box(0.7, 0.4, 2.2, 1.9);
+        Spatial C = cut(D, box);
+
+        std::vector<RectangularSketch> sketches = { motif_sketch(0.2, 0.2), motif_sketch(0.2, 0.2, 2), motif_sketch(0.2, 0.2, 4) };
+        RectangularSketch pair(0.2, 0.2);
+        pair.addKeyword(1);
+        pair.addKeyword(1);
+        sketches.push_back(pair);
+
+        // Without a box the index only serves the extraction windows
+        MiningOptions indexed = quiet_options();
+        indexed.index = &index;
+        for (const auto& S : sketches) CHECK(id_sets(generate_candidates(D, S, indexed)) == id_sets(generate_candidates(D, S, quiet_options())));
+
+        for (const GridIndex* idx : { (const GridIndex*)nullptr, (const GridIndex*)&index }) {
+            MiningOptions opt = quiet_options();
+            opt.query_box = &box;
+            opt.index = idx;
+
+            auto batch = generate_candidates_batch(D, sketches, opt);
+            auto expected_batch = generate_candidates_batch(C, sketches, quiet_options());
+            for (size_t k = 0; k < sketches.size(); ++k) {
+                auto expected = id_sets(generate_candidates(C, sketches[k], quiet_options()));
+                CHECK(id_sets(generate_candidates(D, sketches[k], opt)) == expected);
+                CHECK(id_sets(batch[k]) == expected);
+                CHECK(id_sets(expected_batch[k]) == expected);
+            }
+            CHECK(!batch[0].empty());
+            CHECK(id_sets(batch[0]) != id_sets(generate_candidates(D, sketches[0], quiet_options())));
+
+            auto found = discover_sketches(D, Rectangular(0.2, 0.2), eps, min_freq, 3, 2, {}, opt);
+            CHECK(!found.empty());
+            CHECK(discovered(found) == discovered(discover_sketches(C, Rectangular(0.2, 0.2), eps, min_freq, 3, 2, {}, quiet_options())));
+        }
+    }
+    return test_result("test_box");
+}
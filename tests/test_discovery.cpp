@@ -0,0 +1,58 @@
+// discover_sketches against brute force: every keyword multiset of 2..3 objects is mined
+// with generate_candidates + tree_optimized_fspm. The co-occurrence bound must not prune
+// any multiset that has a frequent pattern, and the verified counts must agree.
+
+#include <map>
+#include "discovery.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+
+int main() {
+    const double eps = 0.03;
+    const int min_freq = 4;
+    const int keywords = 5;
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Spatial D = make_city(seed, 100, 400, keywords, 3.0);
+        Rectangular size(0.2, 0.2);
+
+        std::vector<DiscoveredSketch> found = discover_sketches(D, size, eps, min_freq, 3, 2, {}, quiet_options());
+        std::map<std::string, const DiscoveredSketch*> by_sketch;
+        for (const auto& d : found) by_sketch[d.S.toString()] = &d;
+
+        std::vector<RectangularSketch> all;
+        for (int k0 = 0; k0 < keywords; ++k0) {
+            for (int k1 = k0; k1 < keywords; ++k1) {
+                RectangularSketch S2(size.a, size.b);
+                S2.addKeyword(k0);
+                S2.addKeyword(k1);
+                all.push_back(S2);
+                for (int k2 = k1; k2 < keywords; ++k2) {
+                    RectangularSketch S3 = S2;
+                    S3.addKeyword(k2);
+                    all.push_back(S3);
+                }
+            }
+        }
+        size_t expected = 0;
+        for (const auto& S : all) {
+            std::vector<int> supports;
+            auto R = mine_tree(D, S, eps, min_freq, &supports);
+            auto it = by_sketch.find(S.toString());
+            if (R.empty()) {
+                CHECK(it == by_sketch.end());
+                continue;
+            }
+            expected++;
+            CHECK(it != by_sketch.end());
+            if (it == by_sketch.end()) continue;
+            CHECK(it->second->patterns == R.size());
+            CHECK(it->second->best_support == supports.front());
+            CHECK(it->second->bound >= supports.front());
+        }
+        CHECK(expected > 0);
+        CHECK(found.size() == expected);
+        CHECK(by_sketch.count(motif_sketch(size.a, size.b).toString()) == 1);
+    }
+    return test_result("test_discovery");
+}
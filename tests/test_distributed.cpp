@@ -0,0 +1,94 @@
+// distributed_mining against the tree engine: with 1, 2 and 4 worker processes and
+// several tile counts the patterns and supports must be those of tree_optimized_fspm
+// on generate_candidates, also inside a query box and on gridded data, and an unusable
+// work directory must fail the run.
+
+#include "distributed.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+namespace fs = std::filesystem;
+
+int main() {
+#ifdef FSPM_DISTRIBUTED
+    const double eps = 0.03;
+    const int min_freq = 4;
+    const fs::path dir = fs::temp_directory_path() / "fspm_test_distributed";
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Spatial D = make_city(seed, 100, 400, 5, 3.0);
+        RectangularSketch S = motif_sketch(0.2, 0.2);
+        std::vector<int> tree_supports;
+        auto T = mine_tree(D, S, eps, min_freq, &tree_supports);
+        CHECK(!T.empty());
+
+        for (int tiles : { 1, 4, 16 }) {
+            for (int workers : { 1, 2, 4 }) {
+                DistributedOptions dist;
+                dist.workers = workers;
+                dist.tiles = tiles;
+                dist.work_dir = (dir / "work").string();
+                MiningReport report;
+                MiningOptions opt = quiet_options();
+                opt.report = &report;
+                auto R = distributed_mining(D, S, eps, min_freq, dist, opt);
+                CHECK(pattern_set(R, report.supports) == pattern_set(T, tree_supports));
+            }
+        }
+
+        // opt.query_box: the tiles only hold the objects inside the box
+        const RectangularRegion box(0.7, 0.4, 2.2, 1.9);
+        MiningReport box_report;
+        MiningOptions box_opt = quiet_options();
+        box_opt.report = &box_report;
+        box_opt.query_box = &box;
+        auto B = tree_optimized_fspm(generate_candidates(D, S, box_opt), S, eps, min_freq, box_opt);
+        std::vector<int> box_supports = box_report.supports;
+        CHECK(!B.empty());
+        CHECK(pattern_set(B, box_supports) != pattern_set(T, tree_supports));
+        for (int workers : { 1, 2 }) {
+            DistributedOptions dist;
+            dist.workers = workers;
+            dist.tiles = 4;
+            dist.work_dir = (dir / "work").string();
+            auto R = distributed_mining(D, S, eps, min_freq, dist, box_opt);
+            CHECK(pattern_set(R, box_report.supports) == pattern_set(B, box_supports));
+        }
+
+        fs::create_directories(dir);
+        fs::path blocker = dir / "not_a_dir";
+        { std::ofstream(blocker.string()) << "x"; }
+        DistributedOptions dist;
+        dist.work_dir = (blocker / "work").string();
+        std::streambuf* err = std::cerr.rdbuf(nullptr);
+        CHECK(distributed_mining(D, S, eps, min_freq, dist, quiet_options()).empty());
+        std::cerr.rdbuf(err);
+        fs::remove(blocker);
+    }
+
+    // Gridded coordinates (seed, grid, snapped): counts tie across tile borders, and in
+    // the last two cases a run of equal counts chains past a halo, so the tile is sent again wider
+    const struct { unsigned seed; double grid; bool snapped; } gridded[] = { { 18, 0.05, false }, { 29, 0.05, false },
+                                                                             { 2, 0.1, false }, { 3, 0.1, true } };
+    for (const auto& g : gridded) {
+        Spatial D = make_city(g.seed, 60, 600, 4, 3.0, g.grid);
+        if (g.snapped) D.snap(g.grid);
+        RectangularSketch S = motif_sketch(0.2, 0.2);
+        std::vector<int> tree_supports;
+        auto T = mine_tree(D, S, eps, min_freq, &tree_supports);
+        CHECK(!T.empty());
+        for (int tiles : { 16, 64 }) {
+            DistributedOptions dist;
+            dist.workers = 2;
+            dist.tiles = tiles;
+            dist.work_dir = (dir / "work").string();
+            MiningReport report;
+            MiningOptions opt = quiet_options();
+            opt.report = &report;
+            auto R = distributed_mining(D, S, eps, min_freq, dist, opt);
+            CHECK(pattern_set(R, report.supports) == pattern_set(T, tree_supports));
+        }
+    }
+    fs::remove_all(dir);
+#endif
+    return test_result("test_distributed");
+}
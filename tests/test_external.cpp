@@ -0,0 +1,129 @@
+// CandidateRuns and external_fspm against the in-memory path. With tiny run buffers and
+// fan-ins of 2 and 3 the merge runs several passes; the merge-scan must still yield
+// exactly generate_candidates (same canonical copies), the patterns must not depend on
+// the run layout, and a missing or truncated run must fail the scan instead of
+// dropping candidates.
+
+#include <tuple>
+#include "external.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+namespace fs = std::filesystem;
+
+using Copies = std::vector<std::tuple<std::vector<int>, double, double>>;
+
+// Candidates as (sorted ids, anchor), sorted
+static Copies copies(const std::vector<Instance>& C) {
+    Copies out;
+    for (const auto& inst : C) {
+        std::vector<int> ids;
+        for (const auto& o : inst.O_P) ids.push_back(o.id);
+        std::sort(ids.begin(), ids.end());
+        out.emplace_back(ids, inst.x - inst.size.a / 2.0, inst.y - inst.size.b / 2.0);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+static bool scan(const CandidateRuns& runs, Copies& out, size_t& distinct) {
+    out.clear();
+    bool ok = runs.merge_scan([&](const CandidateRecord& rec) {
+        std::vector<int> ids;
+        for (const auto& o : rec.objs) ids.push_back(o.id);
+        std::sort(ids.begin(), ids.end());
+        out.emplace_back(ids, rec.ax, rec.ay);
+    }, &distinct);
+    std::sort(out.begin(), out.end());
+    return ok;
+}
+
+int main() {
+    const double eps = 0.03;
+    const int min_freq = 4;
+    const fs::path dir = fs::temp_directory_path() / "fspm_test_external";
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Spatial D = make_city(seed, 100, 400, 5, 3.0);
+        RectangularSketch S = motif_sketch(0.2, 0.2);
+        Copies expected = copies(generate_candidates(D, S, quiet_options()));
+        CHECK(!expected.empty());
+
+        for (size_t fan_in : { 2, 3, 64 }) {
+            CandidateRuns runs(dir.string(), eps, 2048, fan_in);
+            CHECK(generate_candidates_external(D, S, runs, quiet_options()));
+            CHECK(runs.runs() <= fan_in);
+            Copies got;
+            size_t distinct = 0;
+            CHECK(scan(runs, got, distinct));
+            CHECK(distinct == expected.size());
+            CHECK(got == expected);
+            runs.remove_files();
+        }
+
+        // The grouping does not depend on how the runs were cut and merged
+        ExternalOptions ext;
+        ext.work_dir = dir.string();
+        MiningReport report;
+        MiningOptions opt = quiet_options();
+        opt.report = &report;
+        auto one_run = external_fspm(D, S, eps, min_freq, ext, opt);
+        auto one_run_set = pattern_set(one_run, report.supports);
+        CHECK(!one_run.empty());
+        ext.run_bytes = 4096;
+        ext.max_fan_in = 2;
+        auto R = external_fspm(D, S, eps, min_freq, ext, opt);
+        CHECK(pattern_set(R, report.supports) == one_run_set);
+
+        // On a 0.01 km grid with epsilon below the grid step, clusters are the classes of
+        // identical relative layouts whatever the grouping order, so the supports must be
+        // the tree engine's
+        Spatial G = make_city(seed, 100, 400, 5, 3.0, 0.01);
+        const double tiny = 1e-4;
+        std::vector<int> tree_supports;
+        CHECK(!mine_tree(G, S, tiny, 2, &tree_supports).empty());
+        external_fspm(G, S, tiny, 2, ext, opt);
+        CHECK(sorted_supports(report.supports) == sorted_supports(tree_supports));
+
+        // A truncated run fails the scan
+        {
+            CandidateRuns runs(dir.string(), eps, 2048, 64);
+            generate_candidates_external(D, S, runs, quiet_options());
+            CHECK(runs.runs() > 1);
+            for (const auto& e : fs::directory_iterator(dir)) {
+                if (e.path().extension() == ".run") {
+                    fs::resize_file(e.path(), fs::file_size(e.path()) - 5);
+                    break;
+                }
+            }
+            Copies got;
+            size_t distinct = 0;
+            CHECK(!scan(runs, got, distinct));
+            runs.remove_files();
+        }
+
+        // A missing run fails the scan
+        {
+            CandidateRuns runs(dir.string(), eps, 2048, 64);
+            generate_candidates_external(D, S, runs, quiet_options());
+            for (const auto& e : fs::directory_iterator(dir)) {
+                if (e.path().extension() == ".run") {
+                    fs::remove(e.path());
+                    break;
+                }
+            }
+            Copies got;
+            size_t distinct = 0;
+            CHECK(!scan(runs, got, distinct));
+            runs.remove_files();
+        }
+
+        // An unusable work directory fails the whole pipeline
+        fs::path blocker = dir / "not_a_dir";
+        { std::ofstream(blocker.string()) << "x"; }
+        ext.work_dir = (blocker / "runs").string();
+        CHECK(external_fspm(D, S, eps, min_freq, ext, opt).empty());
+        fs::remove(blocker);
+    }
+    fs::remove_all(dir);
+    return test_result("test_external");
+}
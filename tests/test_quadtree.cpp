@@ -0,0 +1,54 @@
+// Quadtree-partitioned candidate generation (MiningOptions::leaf_capacity) against the
+// single-sweep path: on continuous data and on gridded data, snapped or not, every leaf
+// size must give exactly the candidates of generate_candidates (same copies of
+// duplicates). Gridded coordinates tie region edges with leaf cores and halos, and chain
+// windows of equal counts past a leaf's halo.
+
+#include <tuple>
+#include "fspm+.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+
+// Candidates as (ids in O_P order, anchor), sorted: equal only if the same copies are kept
+static std::vector<std::tuple<std::vector<int>, double, double>> copies(const std::vector<Instance>& C) {
+    std::vector<std::tuple<std::vector<int>, double, double>> out;
+    for (const auto& inst : C) {
+        std::vector<int> ids;
+        for (const auto& o : inst.O_P) ids.push_back(o.id);
+        out.emplace_back(ids, inst.x, inst.y);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+static void compare(const Spatial& D, const RectangularSketch& S) {
+    auto expected = copies(generate_candidates(D, S, quiet_options()));
+    CHECK(!expected.empty());
+    for (size_t capacity : { 10, 40 }) {
+        MiningOptions opt = quiet_options();
+        opt.leaf_capacity = capacity;
+        opt.num_threads = 2;
+        CHECK(copies(generate_candidates(D, S, opt)) == expected);
+    }
+}
+
+int main() {
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Spatial D = make_city(seed, 150, 600, 5, 3.0);
+        compare(D, motif_sketch(0.2, 0.2));
+        compare(D, motif_sketch(0.3, 0.15, 4));
+    }
+    // Seeds and grids where leaves used to drop or add candidates
+    for (unsigned seed : { 1, 3, 6, 15 }) {
+        for (double grid : { 0.02, 0.05 }) {
+            Spatial G = make_city(seed, 150, 600, 5, 3.0, grid);
+            compare(G, motif_sketch(0.2, 0.2));
+            compare(G, motif_sketch(0.3, 0.15, 4));
+            G.snap(grid);
+            compare(G, motif_sketch(0.2, 0.2));
+            compare(G, motif_sketch(0.3, 0.15, 4));
+        }
+    }
+    return test_result("test_quadtree");
+}
@@ -0,0 +1,134 @@
+// sampled_mining against the tree engine on the full dataset. At rate 1 the sample is
+// the dataset, so the patterns must be the tree engine's; below 1, verified supports
+// must equal a brute-force recount over the full candidate set, and estimates and
+// their intervals must track it.
+
+#include "sampling.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+
+// Support of P over C by a plain scan (the criterion exact_supports implements)
+static int brute_support(const RectangularPattern& P, std::vector<Instance> C, double epsilon) {
+    RDV center = make_rdv(P.O_P);
+    PatternSupport F(P.O_P.size());
+    for (auto& inst : C) {
+        canonical_sort(inst.O_P);
+        if (type_key(inst.O_P) != type_key(P.O_P) || chebyshev_dist(make_rdv(inst.O_P), center) > 2.0 * epsilon) continue;
+        for (size_t i = 0; i < inst.O_P.size(); ++i) F.insert(i, inst.O_P[i].id);
+    }
+    return F.min_support();
+}
+
+int main() {
+    const double eps = 0.03;
+    const int min_freq = 4;
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Spatial D = make_city(seed, 100, 400, 5, 3.0);
+        RectangularSketch S = motif_sketch(0.2, 0.2);
+        std::vector<int> tree_supports;
+        auto T = mine_tree(D, S, eps, min_freq, &tree_supports);
+        CHECK(!T.empty());
+
+        MiningReport report;
+        MiningOptions opt = quiet_options();
+        opt.report = &report;
+
+        // Rate 1: estimates are exact counts of the full run
+        auto R = sampled_mining(D, S, eps, min_freq, opt);
+        CHECK(pattern_set(R, report.supports) == pattern_set(T, tree_supports));
+
+        // Rate 1, verified: same representatives; a verified support counts every
+        // candidate within 2 epsilon, so it is at least the tree's first-match count
+        R = sampled_mining(D, S, eps, min_freq, opt, 2.0, true);
+        CHECK(R.size() == T.size());
+        std::vector<std::vector<int>> reps, tree_reps;
+        for (const auto& p : pattern_set(R, report.supports)) reps.push_back(p.second);
+        for (const auto& p : pattern_set(T, tree_supports)) tree_reps.push_back(p.second);
+        std::sort(reps.begin(), reps.end());
+        std::sort(tree_reps.begin(), tree_reps.end());
+        CHECK(reps == tree_reps);
+        CHECK(sorted_supports(report.supports).back() >= sorted_supports(tree_supports).back());
+
+        // Rate 0.8: verified supports are exact and frequent, descending
+        opt.sample_rate = 0.8;
+        R = sampled_mining(D, S, eps, min_freq, opt, 2.0, true);
+        CHECK(!R.empty());
+        CHECK(report.supports.size() == R.size());
+        std::vector<Instance> C = generate_candidates(D, S, quiet_options());
+        for (size_t i = 0; i < R.size(); ++i) {
+            CHECK(report.supports[i] >= min_freq);
+            CHECK(report.supports[i] == brute_support(R[i], C, eps));
+            if (i > 0) CHECK(report.supports[i - 1] >= report.supports[i]);
+        }
+
+        // Rate 0.8, estimates only: every interval holds its estimate and reaches min_freq
+        R = sampled_mining(D, S, eps, min_freq, opt);
+        CHECK(report.ci_low.size() == R.size() && report.ci_high.size() == R.size());
+        for (size_t i = 0; i < R.size(); ++i) {
+            CHECK(report.ci_low[i] <= report.supports[i] && report.supports[i] <= report.ci_high[i] + 0.5);
+            CHECK(report.ci_high[i] >= min_freq);
+        }
+    }
+
+    // Estimates against the exact supports: a slot object survives with a probability
+    // between rate^n and rate, so scaling by rate^n alone inflated them. Most intervals
+    // must hold the exact support and the estimates must be close on average.
+    for (double rate : { 0.5, 0.7 }) {
+        size_t frequent = 0, covered = 0;
+        double error = 0.0, bias = 0.0;
+        for (unsigned seed = 1; seed <= 3; ++seed) {
+            Spatial D = make_city(seed, 400, 400, 5, 3.0);
+            RectangularSketch S = motif_sketch(0.2, 0.2);
+            std::vector<Instance> C = generate_candidates(D, S, quiet_options());
+            MiningReport report;
+            MiningOptions opt = quiet_options();
+            opt.report = &report;
+            opt.sample_rate = rate;
+            auto R = sampled_mining(D, S, eps, min_freq, opt);
+            CHECK(!R.empty());
+            std::vector<int> exact_support = exact_supports(R, C, eps, 1);
+            for (size_t i = 0; i < R.size(); ++i) {
+                int exact = exact_support[i];
+                if (exact < min_freq) continue;
+                frequent++;
+                if (report.ci_low[i] <= exact && exact <= report.ci_high[i]) covered++;
+                error += std::abs(report.supports[i] - exact) / (double)exact;
+                bias += (report.supports[i] - exact) / (double)exact;
+            }
+        }
+        CHECK(frequent >= 30);
+        CHECK(covered >= 0.8 * frequent);
+        CHECK(error / frequent <= (rate < 0.6 ? 0.3 : 0.15));
+        CHECK(std::abs(bias) / frequent <= (rate < 0.6 ? 0.2 : 0.1));
+    }
+
+    // The candidate cache keys the sample (and every other candidate option) and
+    // never stores a generation stopped by the token
+    {
+        Spatial D = make_city(1, 100, 400, 5, 3.0);
+        RectangularSketch S = motif_sketch(0.2, 0.2);
+        CandidateCache cache;
+        MiningOptions full = quiet_options(), sampled = quiet_options(), coarse = quiet_options();
+        sampled.sample_rate = 0.5;
+        coarse.coarse_prefilter = true;
+        CHECK(id_sets(cache.get(D, S, full).C) == id_sets(generate_candidates(D, S, full)));
+        CHECK(id_sets(cache.get(D, S, sampled).C) == id_sets(generate_candidates(D, S, sampled)));
+        cache.get(D, S, coarse);
+        CHECK(cache.size() == 3);
+
+        CancellationToken token;
+        token.cancel();
+        MiningReport report;
+        MiningOptions stopped = quiet_options();
+        stopped.leaf_capacity = 64;
+        stopped.cancel = &token;
+        stopped.cancel_interval = 1;
+        stopped.report = &report;
+        cache.get(D, S, stopped);
+        CHECK(!report.complete && cache.size() == 3);
+        cache.put(D, S, {}, 0.0, stopped);
+        CHECK(cache.size() == 3);
+    }
+    return test_result("test_sampling");
+}
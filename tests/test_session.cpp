@@ -0,0 +1,81 @@
+// MiningSession::append against a full re-mine: after objects are appended, the alive
+// candidates must be generate_candidates on the grown dataset, including which copy of
+// a duplicate instance is kept, and every query must match a fresh session (representatives
+// depend on the candidate order, so patterns are compared by their supports). Continuous
+// and gridded data, snapped or not.
+
+#include <tuple>
+#include "session.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+
+// Candidates as (ids in O_P order, anchor), sorted: equal only if the same copies are kept
+static std::vector<std::tuple<std::vector<int>, double, double>> copies(const std::vector<Instance>& C, const MiningSession* session = nullptr) {
+    std::vector<std::tuple<std::vector<int>, double, double>> out;
+    for (size_t i = 0; i < C.size(); ++i) {
+        if (session && session->retired(i)) continue;
+        std::vector<int> ids;
+        for (const auto& o : C[i].O_P) ids.push_back(o.id);
+        out.emplace_back(ids, C[i].x, C[i].y);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+// Hold back every 3rd object of `full`, append it in `batches` parts and compare
+static void check_appends(const Spatial& full, const RectangularSketch& S, size_t batches) {
+    const double eps = 0.03;
+    Spatial D = full;
+    std::vector<int> held;
+    for (const auto& o : full.objects) {
+        if (o.id % 3 == 1) held.push_back(o.id);
+    }
+    std::vector<SpatialObject> batch = D.remove(held);
+    CHECK(!batch.empty());
+
+    MiningReport report, fresh_report;
+    MiningOptions opt = quiet_options();
+    opt.report = &report;
+    MiningSession session(D, S, 2.0 * eps, opt);
+    session.query(eps, 4);
+    for (size_t k = 0; k < batches; ++k) {
+        std::vector<SpatialObject> part(batch.begin() + batch.size() * k / batches, batch.begin() + batch.size() * (k + 1) / batches);
+        std::vector<SpatialObject> added = D.append(part);
+        session.append(D, added);
+        CHECK(copies(session.candidates(), &session) == copies(generate_candidates(D, S, quiet_options())));
+    }
+
+    // Queries in both directions of epsilon after the appends
+    MiningOptions fresh_opt = quiet_options();
+    fresh_opt.report = &fresh_report;
+    MiningSession grown(D, S, 2.0 * eps, fresh_opt);
+    bool mined = false;
+    for (double e : { eps, eps / 2, 2.0 * eps }) {
+        for (int min_freq : { 2, 4 }) {
+            auto R = session.query(e, min_freq);
+            auto T = grown.query(e, min_freq);
+            mined = mined || !T.empty();
+            CHECK(R.size() == T.size());
+            CHECK(sorted_supports(report.supports) == sorted_supports(fresh_report.supports));
+        }
+    }
+    CHECK(mined);
+}
+
+int main() {
+    RectangularSketch S = motif_sketch(0.2, 0.2);
+    for (unsigned seed = 1; seed <= 3; ++seed) check_appends(make_city(seed, 100, 400, 5, 3.0), S, 2);
+    // Gridded data, snapped or not: runs of equal counts chain across the dirty boxes.
+    // Many small batches retire enough candidates to compact the tombstones.
+    for (unsigned seed : { 1, 2, 5, 7 }) {
+        for (double grid : { 0.02, 0.05, 0.1 }) {
+            Spatial G = make_city(seed, 100, 400, 5, 3.0, grid);
+            check_appends(G, S, 3);
+            G.snap(grid);
+            check_appends(G, S, 3);
+        }
+    }
+    check_appends(make_city(2, 100, 400, 5, 3.0, 0.05), S, 20);
+    return test_result("test_session");
+}
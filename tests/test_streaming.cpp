@@ -0,0 +1,71 @@
+// StreamingMiner against generate_candidates on its own window: after every advance the
+// live candidates must be exactly those of a full run over the window, and once every
+// check-in has expired no candidate or cluster may be left. A miner fed the whole stream
+// in one batch must report the tree engine's patterns.
+
+#include <random>
+#include "streaming.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+
+// Check-ins of D (km, projected back with cos_lat = 1), 1..3 visits per venue in [0, 100)
+static std::vector<CheckIn> check_ins(const Spatial& D, unsigned seed) {
+    const double R = 6371.0;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> when(0.0, 100.0);
+    std::uniform_int_distribution<int> visits(1, 3);
+    std::vector<CheckIn> out;
+    for (const auto& o : D.objects) {
+        for (int v = visits(rng); v > 0; --v) out.push_back({ o.id, o.keyword, o.y / R * 180.0 / M_PI, o.x / R * 180.0 / M_PI, when(rng) });
+    }
+    std::stable_sort(out.begin(), out.end(), [](const CheckIn& p, const CheckIn& q) { return p.time < q.time; });
+    return out;
+}
+
+static std::vector<std::vector<int>> sorted_ids(std::vector<std::vector<int>> ids) {
+    for (auto& v : ids) std::sort(v.begin(), v.end());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+int main() {
+    const double eps = 0.03;
+    const int min_freq = 4;
+    const double window = 30.0;
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Spatial city = make_city(seed, 100, 400, 5, 3.0);
+        RectangularSketch S = motif_sketch(0.2, 0.2);
+        std::vector<CheckIn> stream = check_ins(city, seed);
+
+        StreamingMiner miner(S, eps, min_freq, window, 1.0, quiet_options());
+        size_t next = 0;
+        bool mined = false;
+        for (double now = 5.0; now <= 150.0; now += 0.5) {
+            while (next < stream.size() && stream[next].time <= now) miner.push(stream[next++]);
+            miner.advance(now);
+            std::vector<Instance> C = generate_candidates(miner.window(), S, quiet_options());
+            CHECK(sorted_ids(miner.candidate_ids()) == id_sets(C));
+            CHECK(miner.candidate_count() == C.size());
+            mined = mined || !C.empty();
+        }
+        CHECK(mined);
+        CHECK(miner.window().objects.empty());
+        CHECK(miner.candidate_count() == 0);
+        CHECK(miner.cluster_count() == 0);
+
+        // The whole stream in one batch: clusters in generate_candidates order
+        MiningReport report;
+        MiningOptions opt = quiet_options();
+        opt.report = &report;
+        StreamingMiner batch(S, eps, min_freq, 1000.0, 1.0, opt);
+        for (const auto& c : stream) batch.push(c);
+        batch.advance(100.0);
+        auto R = batch.patterns();
+        std::vector<int> tree_supports;
+        auto T = mine_tree(batch.window(), S, eps, min_freq, &tree_supports);
+        CHECK(!T.empty());
+        CHECK(pattern_set(R, report.supports) == pattern_set(T, tree_supports));
+    }
+    return test_result("test_streaming");
+}
@@ -0,0 +1,120 @@
+// SweepLine::apply (incremental window list, one report per window change) against the
+// original sweep that rebuilds the whole window list per event and reports every
+// window at every vertical gap. Both run on the same sorted events; the merged regions
+// and the extracted candidates must be identical. The multi-scale path, which builds its
+// events from a presorted object list, must match as well, and so must a densest-first
+// extraction under a cancellation token.
+
+#include "fspm+.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+
+// The original spatial_pruning loop, verbatim apart from the progress output
+static std::vector<RectangularRegion> reference_sweep(const std::vector<SweepEvent>& E, const RectangularSketch& S,
+                                                      double min_val, double max_val) {
+    std::vector<SweepWindow> W;
+    W.push_back({ min_val, max_val, {} });
+    std::vector<RectangularRegion> V;
+    double y_pre = E.empty() ? 0 : E[0].y;
+    for (const auto& e : E) {
+        if (y_pre > e.y) {
+            for (const auto& w : W) {
+                if (has_subset_keywords(S.K, w.current_keywords)) V.emplace_back(w.x_start, e.y, w.x_end, y_pre);
+            }
+        }
+        std::vector<SweepWindow> next_W;
+        for (const auto& w : W) {
+            double overlap_start = std::max(w.x_start, e.x_min);
+            double overlap_end = std::min(w.x_end, e.x_max);
+            if (overlap_start < overlap_end) {
+                if (w.x_start < overlap_start) next_W.push_back({ w.x_start, overlap_start, w.current_keywords });
+                SweepWindow overlap_win = { overlap_start, overlap_end, w.current_keywords };
+                if (e.type == EventType::Bottom) {
+                    overlap_win.current_keywords[e.obj->keyword]++;
+                } else if (overlap_win.current_keywords.count(e.obj->keyword)) {
+                    if (--overlap_win.current_keywords[e.obj->keyword] <= 0) overlap_win.current_keywords.erase(e.obj->keyword);
+                }
+                next_W.push_back(overlap_win);
+                if (overlap_end < w.x_end) next_W.push_back({ overlap_end, w.x_end, w.current_keywords });
+            } else {
+                next_W.push_back(w);
+            }
+        }
+        W.clear();
+        for (auto& w : next_W) {
+            if (!W.empty() && keywords_equal(w.current_keywords, W.back().current_keywords)) W.back().x_end = w.x_end;
+            else W.push_back(w);
+        }
+        y_pre = e.y;
+    }
+    return V;
+}
+
+static bool same_regions(const std::vector<RectangularRegion>& p, const std::vector<RectangularRegion>& q) {
+    if (p.size() != q.size()) return false;
+    for (size_t i = 0; i < p.size(); ++i) {
+        if (p[i].x_min != q[i].x_min || p[i].x_max != q[i].x_max || p[i].y_min != q[i].y_min || p[i].y_max != q[i].y_max) return false;
+    }
+    return true;
+}
+
+static void compare(const Spatial& D, const RectangularSketch& S) {
+    std::vector<const SpatialObject*> objs;
+    double x_lo, x_hi;
+    MiningOptions opt;
+    opt.verbose = false;
+    CHECK(sketch_objects(D, S, opt, objs, x_lo, x_hi));
+    std::vector<SweepEvent> E = make_sweep_events(objs, S.size.a, S.size.b, D.resolution);
+
+    std::vector<RectangularRegion> base = merge_regions(reference_sweep(E, S, x_lo, x_hi + S.size.a));
+    std::vector<RectangularRegion> now = merge_regions(sweep_regions(E, S, x_lo, x_hi + S.size.a, opt));
+    CHECK(!base.empty());
+    CHECK(same_regions(base, now));
+    CHECK(id_sets(extract_candidates(D, S, base, opt)) == id_sets(generate_candidates(D, S, opt)));
+
+    // A token that never expires: regions are visited densest first, same candidates
+    CancellationToken token(3600.0);
+    MiningOptions ranked = opt;
+    ranked.cancel = &token;
+    CHECK(id_sets(extract_candidates(D, S, base, ranked)) == id_sets(extract_candidates(D, S, base, opt)));
+}
+
+// generate_candidates_multiscale against generate_candidates at every size
+static void compare_multiscale(const Spatial& D, const RectangularSketch& S) {
+    std::vector<Rectangular> sizes = { Rectangular(0.3, 0.3), Rectangular(0.2, 0.2), Rectangular(0.25, 0.15) };
+    MiningOptions opt;
+    opt.verbose = false;
+    auto C = generate_candidates_multiscale(D, S.K, sizes, opt);
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        RectangularSketch at(sizes[i].a, sizes[i].b);
+        at.K = S.K;
+        CHECK(id_sets(C[i]) == id_sets(generate_candidates(D, at, opt)));
+    }
+}
+
+int main() {
+    for (unsigned seed = 1; seed <= 4; ++seed) {
+        // Continuous coordinates
+        Spatial D = make_city(seed, 60, 300);
+        compare(D, motif_sketch(0.2, 0.2));
+        compare(D, motif_sketch(0.35, 0.15));
+
+        // Coordinates on a 0.05 km grid with 0.2 km windows: event edges coincide
+        // exactly, objects share x or y, and some share both
+        Spatial G = make_city(seed, 60, 300, 5, 2.0, 0.05);
+        compare(G, motif_sketch(0.2, 0.2));
+        RectangularSketch twice(0.2, 0.2);
+        twice.addKeyword(0);
+        twice.addKeyword(0);
+        twice.addKeyword(3);
+        compare(G, twice);
+
+        // Same grid, snapped so events are built on the integer grid
+        G.snap(0.05);
+        compare(G, motif_sketch(0.2, 0.2));
+        compare_multiscale(G, motif_sketch(0.2, 0.2));
+        compare_multiscale(D, motif_sketch(0.2, 0.2));
+    }
+    return test_result("test_sweep_line");
+}
@@ -0,0 +1,106 @@
+// tiled_mining against the tree engine: the dataset is written as a CSV, loaded with
+// Spatial::load for tree_optimized_fspm on generate_candidates, and mined out of core
+// with memory budgets from one tile to the finest tiling. Patterns and supports must
+// not depend on the tiling, also inside a query box and on gridded data.
+
+#include <fstream>
+#include <iomanip>
+#include "tiled.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+namespace fs = std::filesystem;
+
+// Write D (km) as id,keyword,lat,lon so that Spatial::load projects it back
+static void write_csv(const Spatial& D, const std::string& path) {
+    const double R = 6371.0;
+    std::ofstream out(path);
+    out << "id,keyword,lat,lon\n" << std::setprecision(17);
+    for (const auto& o : D.objects) {
+        // Lat/lon around 45 degrees so that the longitude scaling is not trivial
+        out << o.id << "," << o.keyword << "," << 45.0 + o.y / R * 180.0 / M_PI << "," << 10.0 + o.x / R * 180.0 / M_PI << "\n";
+    }
+}
+
+int main() {
+    const double eps = 0.03;
+    const int min_freq = 4;
+    const fs::path dir = fs::temp_directory_path() / "fspm_test_tiled";
+    fs::create_directories(dir);
+    const std::string csv = (dir / "city.csv").string();
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        write_csv(make_city(seed, 100, 400, 5, 3.0), csv);
+        Spatial D;
+        std::streambuf* saved = std::cout.rdbuf(nullptr); // load reports on stdout
+        D.load(csv);
+        std::cout.rdbuf(saved);
+        RectangularSketch S = motif_sketch(0.2, 0.2);
+        std::vector<int> tree_supports;
+        auto T = mine_tree(D, S, eps, min_freq, &tree_supports);
+        CHECK(!T.empty());
+
+        // About 550 sketch objects: one tile, then 2x2 up to 8x8
+        for (size_t budget_objects : { 1000000, 400, 150, 40 }) {
+            TiledOptions tiles;
+            tiles.work_dir = (dir / "work").string();
+            tiles.memory_budget = budget_objects * tiles.bytes_per_object;
+            MiningReport report;
+            MiningOptions opt = quiet_options();
+            opt.report = &report;
+            std::streambuf* err = std::cerr.rdbuf(nullptr); // budget warning of the finest tiling
+            auto R = tiled_mining(csv, S, eps, min_freq, tiles, opt);
+            std::cerr.rdbuf(err);
+            CHECK(pattern_set(R, report.supports) == pattern_set(T, tree_supports));
+        }
+
+        // opt.query_box, in the projected coordinates of the loaded dataset
+        const RectangularRegion box(D.x_min + 0.7, D.y_min + 0.4, D.x_min + 2.2, D.y_min + 1.9);
+        MiningReport box_report;
+        MiningOptions box_opt = quiet_options();
+        box_opt.report = &box_report;
+        box_opt.query_box = &box;
+        auto B = tree_optimized_fspm(generate_candidates(D, S, box_opt), S, eps, min_freq, box_opt);
+        std::vector<int> box_supports = box_report.supports;
+        CHECK(!B.empty());
+        CHECK(pattern_set(B, box_supports) != pattern_set(T, tree_supports));
+        for (size_t budget_objects : { 1000000, 40 }) {
+            TiledOptions tiles;
+            tiles.work_dir = (dir / "work").string();
+            tiles.memory_budget = budget_objects * tiles.bytes_per_object;
+            std::streambuf* err = std::cerr.rdbuf(nullptr);
+            auto R = tiled_mining(csv, S, eps, min_freq, tiles, box_opt);
+            std::cerr.rdbuf(err);
+            CHECK(pattern_set(R, box_report.supports) == pattern_set(B, box_supports));
+        }
+    }
+
+    // Gridded coordinates, snapped on load (grid_resolution): counts tie across tile
+    // borders, and at grid 0.1 a run of equal counts chains past a halo, so the tile
+    // is extended from its right neighbours
+    for (double grid : { 0.05, 0.1 }) {
+        write_csv(make_city(1, 60, 600, 4, 3.0, grid), csv);
+        Spatial D;
+        std::streambuf* saved = std::cout.rdbuf(nullptr);
+        D.load(csv, true, grid);
+        std::cout.rdbuf(saved);
+        RectangularSketch S = motif_sketch(0.2, 0.2);
+        std::vector<int> tree_supports;
+        auto T = mine_tree(D, S, eps, min_freq, &tree_supports);
+        CHECK(!T.empty());
+        for (size_t budget_objects : { 400, 150, 40 }) {
+            TiledOptions tiles;
+            tiles.work_dir = (dir / "work").string();
+            tiles.memory_budget = budget_objects * tiles.bytes_per_object;
+            tiles.grid_resolution = grid;
+            MiningReport report;
+            MiningOptions opt = quiet_options();
+            opt.report = &report;
+            std::streambuf* err = std::cerr.rdbuf(nullptr);
+            auto R = tiled_mining(csv, S, eps, min_freq, tiles, opt);
+            std::cerr.rdbuf(err);
+            CHECK(pattern_set(R, report.supports) == pattern_set(T, tree_supports));
+        }
+    }
+    fs::remove_all(dir);
+    return test_result("test_tiled");
+}
@@ -0,0 +1,57 @@
+// tree_optimized_topk against the tree engine: over one sketch and over several, the
+// k best supports must be the k best of tree_optimized_fspm on each sketch, and
+// sketch_support_bound must bound every support of its sketch.
+
+#include "fspm+.hpp"
+#include "test_util.hpp"
+
+using namespace fspm_plus;
+
+int main() {
+    const double eps = 0.03;
+    const int min_freq = 2;
+    for (unsigned seed = 1; seed <= 3; ++seed) {
+        Spatial D = make_city(seed, 150, 600, 6, 3.0);
+        // Motif keywords, noise keywords only, and a keyword that does not occur
+        RectangularSketch rare(0.2, 0.2);
+        rare.addKeyword(3);
+        rare.addKeyword(4);
+        RectangularSketch missing(0.2, 0.2);
+        missing.addKeyword(0);
+        missing.addKeyword(99);
+        std::vector<RectangularSketch> sketches = { rare, motif_sketch(0.2, 0.2), missing, motif_sketch(0.2, 0.2, 2) };
+
+        std::vector<int> all; // supports of every sketch's full run
+        for (const auto& S : sketches) {
+            std::vector<int> supports;
+            mine_tree(D, S, eps, min_freq, &supports);
+            int bound = sketch_support_bound(D, S);
+            for (int sup : supports) CHECK(sup <= bound);
+            all.insert(all.end(), supports.begin(), supports.end());
+        }
+        CHECK(sketch_support_bound(D, missing) == 0);
+        std::sort(all.rbegin(), all.rend());
+
+        for (size_t k : { 1, 5, 20 }) {
+            MiningReport report;
+            MiningOptions opt = quiet_options();
+            opt.report = &report;
+            std::vector<size_t> sketch_of;
+            auto R = tree_optimized_topk(D, sketches, eps, k, min_freq, opt, &sketch_of);
+            std::vector<int> expected(all.begin(), all.begin() + std::min(k, all.size()));
+            CHECK(report.supports == expected);
+            CHECK(R.size() == expected.size() && sketch_of.size() == R.size());
+            for (size_t s : sketch_of) CHECK(s != 2);
+
+            // One sketch: the same as the top-k stage on its candidates
+            MiningReport one, staged;
+            MiningOptions one_opt = quiet_options(), staged_opt = quiet_options();
+            one_opt.report = &one;
+            staged_opt.report = &staged;
+            auto A = tree_optimized_topk(D, sketches[1], eps, k, min_freq, one_opt);
+            auto B = tree_optimized_topk(generate_candidates(D, sketches[1], staged_opt), sketches[1], eps, k, min_freq, staged_opt);
+            CHECK(pattern_set(A, one.supports) == pattern_set(B, staged.supports));
+        }
+    }
+    return test_result("test_topk");
+}
@@ -0,0 +1,146 @@
+#ifndef TEST_UTIL_HPP
+#define TEST_UTIL_HPP
+
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include "dataset.hpp"
+#include "rectangular.hpp"
+#include "options.hpp"
+#include "fspm+.hpp"
+
+/**
+ * @brief Shared helpers of the behavioural tests: a CHECK macro that counts failures
+ * and seeded synthetic datasets small enough to mine exactly in a few milliseconds.
+ */
+
+static int test_failures = 0;
+
+#define CHECK(cond)                                                                        \
+    do {                                                                                   \
+        if (!(cond)) {                                                                     \
+            test_failures++;                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+        }                                                                                  \
+    } while (0)
+
+inline int test_result(const char* name) {
+    if (test_failures) std::cerr << name << ": " << test_failures << " check(s) failed" << std::endl;
+    else std::cout << name << ": OK" << std::endl;
+    return test_failures ? 1 : 0;
+}
+
+// Sort by x, compute the bounds and the keyword counts, as Spatial::load leaves a dataset
+inline void finish_dataset(Spatial& D) {
+    std::stable_sort(D.objects.begin(), D.objects.end(), [](const SpatialObject& p, const SpatialObject& q) { return p.x < q.x; });
+    D.countKeywords();
+    D.touch();
+    if (D.objects.empty()) return;
+    D.x_min = D.objects.front().x;
+    D.x_max = D.objects.back().x;
+    D.y_min = D.y_max = D.objects[0].y;
+    for (const auto& o : D.objects) {
+        D.y_min = std::min(D.y_min, o.y);
+        D.y_max = std::max(D.y_max, o.y);
+    }
+}
+
+/**
+ * @brief Seeded synthetic city in km: `motifs` copies of the motif keywords 0, 1, 2 at
+ * offsets (0, 0), (0.10, 0.05), (0.05, 0.12) around random centres, with jitter, plus
+ * `noise` objects of keywords 0 .. keywords - 1 spread over extent x extent.
+ * With grid > 0 every coordinate is a multiple of grid, so event edges tie exactly.
+ */
+inline Spatial make_city(unsigned seed, size_t motifs, size_t noise, int keywords = 5, double extent = 4.0, double grid = 0.0) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> pos(0.0, extent), jitter(-0.01, 0.01);
+    std::uniform_int_distribution<int> kw(0, keywords - 1);
+    auto on_grid = [grid](double v) { return grid > 0.0 ? std::round(v / grid) * grid : v; };
+
+    Spatial D;
+    int id = 0;
+    auto add = [&](int k, double x, double y) {
+        SpatialObject o;
+        o.id = id++;
+        o.keyword = k;
+        o.x = on_grid(x);
+        o.y = on_grid(y);
+        D.objects.push_back(o);
+    };
+    const double dx[3] = { 0.0, 0.10, 0.05 }, dy[3] = { 0.0, 0.05, 0.12 };
+    for (size_t m = 0; m < motifs; ++m) {
+        double cx = pos(rng), cy = pos(rng);
+        for (int k = 0; k < 3; ++k) add(k, cx + dx[k] + jitter(rng), cy + dy[k] + jitter(rng));
+    }
+    for (size_t i = 0; i < noise; ++i) {
+        double x = pos(rng), y = pos(rng);
+        add(kw(rng), x, y);
+    }
+    finish_dataset(D);
+    return D;
+}
+
+// Sketch a x b over keywords 0 .. n - 1, once each
+inline RectangularSketch motif_sketch(double a, double b, int n = 3) {
+    RectangularSketch S(a, b);
+    for (int k = 0; k < n; ++k) S.addKeyword(k);
+    return S;
+}
+
+// Candidates as sorted object id sets, sorted: equal for equal candidate sets
+inline std::vector<std::vector<int>> id_sets(const std::vector<Instance>& C) {
+    std::vector<std::vector<int>> sets;
+    for (const auto& inst : C) {
+        std::vector<int> ids;
+        for (const auto& o : inst.O_P) ids.push_back(o.id);
+        std::sort(ids.begin(), ids.end());
+        sets.push_back(ids);
+    }
+    std::sort(sets.begin(), sets.end());
+    return sets;
+}
+
+// Options of a silent run: no progress output, no pattern file
+inline fspm_plus::MiningOptions quiet_options() {
+    fspm_plus::MiningOptions opt;
+    opt.verbose = false;
+    opt.output_path.clear();
+    return opt;
+}
+
+/**
+ * @brief A mined pattern set in comparable form: (support, sorted id set of the
+ * representative) per pattern, sorted.
+ */
+inline std::vector<std::pair<int, std::vector<int>>> pattern_set(const std::vector<RectangularPattern>& R, const std::vector<int>& supports) {
+    std::vector<std::pair<int, std::vector<int>>> out;
+    for (size_t i = 0; i < R.size(); ++i) {
+        std::vector<int> ids;
+        for (const auto& o : R[i].O_P) ids.push_back(o.id);
+        std::sort(ids.begin(), ids.end());
+        out.push_back({ i < supports.size() ? supports[i] : -1, ids });
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+// Sorted pattern supports: equal for clusterings that agree up to representative choice
+inline std::vector<int> sorted_supports(std::vector<int> supports) {
+    std::sort(supports.begin(), supports.end());
+    return supports;
+}
+
+// tree_optimized_fspm on generate_candidates, with the supports in `supports`
+inline std::vector<RectangularPattern> mine_tree(const Spatial& D, const RectangularSketch& S, double epsilon, int min_freq,
+                                                 std::vector<int>* supports = nullptr) {
+    fspm_plus::MiningReport report;
+    fspm_plus::MiningOptions opt = quiet_options();
+    opt.report = &report;
+    auto R = fspm_plus::tree_optimized_fspm(fspm_plus::generate_candidates(D, S, opt), S, epsilon, min_freq, opt);
+    if (supports) *supports = report.supports;
+    return R;
+}
+
+#endif // TEST_UTIL_HPP